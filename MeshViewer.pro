@@ -33,7 +33,26 @@ SOURCES += \
     src/light.cpp \
     src/submesh.cpp \
     src/gameobject.cpp \
-    src/makaidebug.cpp
+    src/makaidebug.cpp \
+    src/framescheduler.cpp \
+    src/threadpool.cpp \
+    src/lightclusters.cpp \
+    src/gbuffer.cpp \
+    src/shaderpermutations.cpp \
+    src/shaderreloader.cpp \
+    src/blockcompression.cpp \
+    src/texturecache.cpp \
+    src/texturestreamer.cpp \
+    src/mipchain.cpp \
+    src/profiler.cpp \
+    src/renderer.cpp \
+    src/tracer.cpp \
+    src/memorytracker.cpp \
+    src/renderstats.cpp \
+    src/framecapture.cpp \
+    src/bvh.cpp \
+    src/picking.cpp \
+    src/scenegraph.cpp
 
 HEADERS  += headers/mainwindow.h \
     headers/openglwidget.h \
@@ -44,7 +63,27 @@ HEADERS  += headers/mainwindow.h \
     headers/mesh.h \
     headers/submesh.h \
     headers/gameobject.h \
-    headers/makaidebug.h
+    headers/makaidebug.h \
+    headers/uniform.h \
+    headers/framescheduler.h \
+    headers/threadpool.h \
+    headers/lightclusters.h \
+    headers/gbuffer.h \
+    headers/shaderpermutations.h \
+    headers/shaderreloader.h \
+    headers/blockcompression.h \
+    headers/texturecache.h \
+    headers/texturestreamer.h \
+    headers/mipchain.h \
+    headers/profiler.h \
+    headers/renderer.h \
+    headers/tracer.h \
+    headers/memorytracker.h \
+    headers/renderstats.h \
+    headers/framecapture.h \
+    headers/bvh.h \
+    headers/picking.h \
+    headers/scenegraph.h
 
 FORMS    += mainwindow.ui
 
@@ -64,4 +103,12 @@ DISTFILES += \
     shaders/gourandshader.frag \
     shaders/shader.frag \
     shaders/gourandshader.vert \
-    shaders/shader.vert
+    shaders/shader.vert \
+    shaders/shader.geom \
+    shaders/gourandshader.geom \
+    shaders/depth.vert \
+    shaders/depth.frag \
+    shaders/gbuffer.frag \
+    shaders/deferred.vert \
+    shaders/deferred.frag \
+    shaders/lighting.glsl
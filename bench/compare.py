@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""Compares two benchmark results and flags the slowdowns.
+
+Reads either kind of result the bench directory produces:
+  * meshviewer-microbench --benchmark_out=file.json (Google Benchmark's format), compared on
+    the median over repetitions when there are several, else on the single run;
+  * meshviewer-bench --output file.json, compared on load times and on the p50 and p99
+    CPU and GPU frame times of every shading/display/texture run.
+
+    python bench/compare.py before.json after.json [--threshold 5]
+
+Exits with 1 if anything got slower by more than the threshold, in percent.
+"""
+
+import argparse
+import json
+import sys
+
+
+def microbench_metrics(report):
+    benchmarks = report["benchmarks"]
+    medians = [b for b in benchmarks if b.get("aggregate_name") == "median"]
+    metrics = {}
+    for benchmark in medians or [b for b in benchmarks if b.get("run_type", "iteration") == "iteration"]:
+        name = benchmark.get("run_name", benchmark["name"])
+        metrics[name + " time"] = benchmark["real_time"]
+        metrics[name + " cpu"] = benchmark["cpu_time"]
+    return metrics, "ns"
+
+
+def frame_bench_metrics(report):
+    metrics = {
+        "import": report["import_ms"],
+        "upload": report["upload_ms"],
+    }
+    for run in report["runs"]:
+        name = "%s/%s" % (run["shading"], run["display"])
+        if "texture" in run:
+            name += "/" + run["texture"]
+        for clock in ("cpu", "gpu"):
+            times = run.get(clock + "_ms", {})
+            for percentile in ("p50", "p99"):
+                if percentile in times:
+                    metrics["%s %s %s" % (name, clock, percentile)] = times[percentile]
+    return metrics, "ms"
+
+
+def load(file_name):
+    with open(file_name) as f:
+        report = json.load(f)
+    if "benchmarks" in report:
+        return microbench_metrics(report)
+    if "runs" in report:
+        return frame_bench_metrics(report)
+    sys.exit("%s: not a meshviewer-bench or meshviewer-microbench result" % file_name)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline")
+    parser.add_argument("contender")
+    parser.add_argument("--threshold", type=float, default=5.0,
+                        help="percent slower that counts as a regression (default 5)")
+    args = parser.parse_args()
+
+    baseline, unit = load(args.baseline)
+    contender, contender_unit = load(args.contender)
+    if unit != contender_unit:
+        sys.exit("the two files come from different benchmarks")
+
+    width = max([len(name) for name in baseline] + [9])
+    print("%-*s %14s %14s %9s" % (width, "Benchmark", "Old (%s)" % unit, "New (%s)" % unit, "Change"))
+    regressions = 0
+    for name, old in baseline.items():
+        if name not in contender:
+            print("%-*s %14.3f %14s" % (width, name, old, "missing"))
+            continue
+        new = contender[name]
+        change = (new - old) / old * 100.0 if old > 0 else 0.0
+        flag = ""
+        if change > args.threshold:
+            flag = "  slower"
+            regressions += 1
+        elif change < -args.threshold:
+            flag = "  faster"
+        print("%-*s %14.3f %14.3f %+8.1f%%%s" % (width, name, old, new, change, flag))
+    for name in contender:
+        if name not in baseline:
+            print("%-*s %14s %14.3f" % (width, name, "new", contender[name]))
+
+    if regressions:
+        print("\n%d of %d measurements slower by more than %g%%" % (regressions, len(baseline), args.threshold))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
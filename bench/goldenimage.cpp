@@ -0,0 +1,103 @@
+#include "goldenimage.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace makai;
+using namespace makai::bench;
+
+namespace
+{
+    struct Lab
+    {
+        double l, a, b;
+    };
+
+    double srgbToLinear(double c)
+    {
+        return c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+    }
+
+    double labCurve(double t)
+    {
+        const double delta = 6.0 / 29.0;
+        return t > delta * delta * delta ? std::cbrt(t) : t / (3.0 * delta * delta) + 4.0 / 29.0;
+    }
+
+    // sRGB to CIELAB under D65, the white point of sRGB
+    Lab toLab(QRgb color, const std::vector<double> &linear)
+    {
+        double r = linear[qRed(color)];
+        double g = linear[qGreen(color)];
+        double b = linear[qBlue(color)];
+        double x = (0.4124 * r + 0.3576 * g + 0.1805 * b) / 0.95047;
+        double y = 0.2126 * r + 0.7152 * g + 0.0722 * b;
+        double z = (0.0193 * r + 0.1192 * g + 0.9505 * b) / 1.08883;
+        double fx = labCurve(x), fy = labCurve(y), fz = labCurve(z);
+        return { 116.0 * fy - 16.0, 500.0 * (fx - fy), 200.0 * (fy - fz) };
+    }
+}
+
+ImageDifference bench::compare(const QImage &golden, const QImage &image, double deltaEThreshold)
+{
+    ImageDifference difference;
+    if (golden.size() != image.size() || golden.isNull())
+        return difference;
+    difference.comparable = true;
+
+    std::vector<double> linear(256);
+    for (int i = 0; i < 256; i++)
+        linear[i] = srgbToLinear(i / 255.0);
+
+    const QImage expected = golden.convertToFormat(QImage::Format_RGB32);
+    const QImage actual = image.convertToFormat(QImage::Format_RGB32);
+    difference.diff = QImage(actual.width(), actual.height(), QImage::Format_RGB32);
+
+    double sum = 0.0;
+    size_t different = 0;
+    for (int y = 0; y < actual.height(); y++)
+    {
+        const QRgb* expectedRow = reinterpret_cast<const QRgb*>(expected.constScanLine(y));
+        const QRgb* actualRow = reinterpret_cast<const QRgb*>(actual.constScanLine(y));
+        QRgb* diffRow = reinterpret_cast<QRgb*>(difference.diff.scanLine(y));
+        for (int x = 0; x < actual.width(); x++)
+        {
+            double deltaE = 0.0;
+            if (expectedRow[x] != actualRow[x])
+            {
+                Lab e = toLab(expectedRow[x], linear);
+                Lab a = toLab(actualRow[x], linear);
+                deltaE = std::sqrt((e.l - a.l) * (e.l - a.l) + (e.a - a.a) * (e.a - a.a) + (e.b - a.b) * (e.b - a.b));
+            }
+            sum += deltaE;
+            difference.maxDeltaE = std::max(difference.maxDeltaE, deltaE);
+            if (deltaE > deltaEThreshold)
+            {
+                different++;
+                diffRow[x] = qRgb(255, 0, 0);
+            }
+            else
+            {
+                int gray = qGray(actualRow[x]) / 4 + 160;
+                diffRow[x] = qRgb(gray, gray, gray);
+            }
+        }
+    }
+
+    const double pixels = (double)actual.width() * actual.height();
+    difference.meanDeltaE = pixels > 0.0 ? sum / pixels : 0.0;
+    difference.differentFraction = pixels > 0.0 ? different / pixels : 0.0;
+    return difference;
+}
+
+QImage bench::readFramebuffer(GLuint framebuffer, int width, int height)
+{
+    QImage image(width, height, QImage::Format_RGBA8888);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, image.bits());
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    //GL rows go bottom up; alpha is whatever the passes left behind, it isn't part of the picture
+    return image.mirrored().convertToFormat(QImage::Format_RGB32);
+}
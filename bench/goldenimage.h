@@ -0,0 +1,34 @@
+#ifndef GOLDENIMAGE_H
+#define GOLDENIMAGE_H
+
+#include <GL/glew.h>
+
+#include <QImage>
+
+namespace makai
+{
+    namespace bench
+    {
+        // How far a rendered image is from its golden, per pixel as the CIE76 color difference (ΔE*ab)
+        // between the two colors in CIELAB. A ΔE around 2.3 is the smallest difference people notice,
+        // so a tolerance in ΔE ignores rounding and dithering noise but not a wrong shade or a missing map.
+        struct ImageDifference
+        {
+            // false if the sizes differ, nothing else is filled in then
+            bool comparable = false;
+            double maxDeltaE = 0.0;
+            double meanDeltaE = 0.0;
+            // pixels whose ΔE is over the threshold compare() was given
+            double differentFraction = 0.0;
+            // the differing pixels in red over a faded copy of the image, for looking at failures
+            QImage diff;
+        };
+
+        ImageDifference compare(const QImage &golden, const QImage &image, double deltaEThreshold);
+
+        // The color attachment of the framebuffer, top row first, opaque.
+        QImage readFramebuffer(GLuint framebuffer, int width, int height);
+    }
+}
+
+#endif // GOLDENIMAGE_H
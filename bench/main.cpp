@@ -0,0 +1,500 @@
+#include "renderer.h"
+#include "texturecache.h"
+#include "shaderprogram.h"
+#include "renderstats.h"
+#include "goldenimage.h"
+
+#include <QGuiApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QSurfaceFormat>
+#include <QStringList>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+// Renders a model, or with --builtin only the built-in cubes, offscreen along a scripted camera orbit
+// in every shading, display and texture mode, and writes import and upload times, per-frame CPU and
+// GPU times and the RenderStats counters as JSON.
+//
+//   meshviewer-bench <model>|--builtin [--frames N] [--width W] [--height H] [--output file.json]
+//                    [--cache-dir dir] [--untextured]
+//                    [--golden-dir dir [--update-goldens] [--max-delta-e E] [--max-diff-fraction F]]
+//                    [--baseline file.json [--threshold percent]]
+//
+// As a regression test, see bench/regression.py: with --golden-dir the first frame of every run is
+// compared to the golden image of that run, and with --baseline the load times and median frame times
+// to an earlier result of the same machine. The exit code is 1 if an image or a time is off.
+//
+// Shaders are read from shaders/ under the working directory, so run it from the repository root.
+// It needs no window system: QT_QPA_PLATFORM=offscreen, and Mesa's llvmpipe where there is no GPU.
+
+using namespace makai;
+
+namespace
+{
+    struct Options
+    {
+        QString model;
+        //the built-in cubes only, no model loaded
+        bool builtin = false;
+        int frames = 200;
+        int width = 1280;
+        int height = 720;
+        QString output;
+        QString cacheDir;
+        bool textured = true;
+
+        QString goldenDir;
+        //writes the images as the new goldens instead of comparing
+        bool updateGoldens = false;
+        //per pixel, CIE76 ΔE; about the smallest difference people notice
+        double maxDeltaE = 2.3;
+        //pixels over maxDeltaE an image may have, rasterizers differ along edges
+        double maxDiffFraction = 0.001;
+
+        QString baseline;
+        //percent slower that fails the run
+        double threshold = 10.0;
+    };
+
+    // frames before each measured run, so shader variants compile and streamed textures settle
+    const int WARMUP_FRAMES = 10;
+    const int MAX_WARMUP_FRAMES = 1000;
+
+    void usage()
+    {
+        std::fprintf(stderr, "usage: meshviewer-bench <model>|--builtin [--frames N] [--width W] [--height H]"
+                             " [--output file.json] [--cache-dir dir] [--untextured]"
+                             " [--golden-dir dir [--update-goldens] [--max-delta-e E] [--max-diff-fraction F]]"
+                             " [--baseline file.json [--threshold percent]]\n");
+    }
+
+    bool parseArguments(const QStringList &arguments, Options &options)
+    {
+        for (int i = 1; i < arguments.size(); i++)
+        {
+            const QString argument = arguments.at(i);
+            const bool hasValue = i + 1 < arguments.size();
+            bool ok = true;
+            if (argument == "--frames" && hasValue)
+                options.frames = arguments.at(++i).toInt(&ok);
+            else if (argument == "--width" && hasValue)
+                options.width = arguments.at(++i).toInt(&ok);
+            else if (argument == "--height" && hasValue)
+                options.height = arguments.at(++i).toInt(&ok);
+            else if (argument == "--output" && hasValue)
+                options.output = arguments.at(++i);
+            else if (argument == "--cache-dir" && hasValue)
+                options.cacheDir = arguments.at(++i);
+            else if (argument == "--untextured")
+                options.textured = false;
+            else if (argument == "--builtin")
+                options.builtin = true;
+            else if (argument == "--golden-dir" && hasValue)
+                options.goldenDir = arguments.at(++i);
+            else if (argument == "--update-goldens")
+                options.updateGoldens = true;
+            else if (argument == "--max-delta-e" && hasValue)
+                options.maxDeltaE = arguments.at(++i).toDouble(&ok);
+            else if (argument == "--max-diff-fraction" && hasValue)
+                options.maxDiffFraction = arguments.at(++i).toDouble(&ok);
+            else if (argument == "--baseline" && hasValue)
+                options.baseline = arguments.at(++i);
+            else if (argument == "--threshold" && hasValue)
+                options.threshold = arguments.at(++i).toDouble(&ok);
+            else if (!argument.startsWith("-") && options.model.isEmpty())
+                options.model = argument;
+            else
+                ok = false;
+            if (!ok)
+                return false;
+        }
+        return options.model.isEmpty() == options.builtin && options.frames > 0
+                && options.width > 0 && options.height > 0 && (!options.updateGoldens || !options.goldenDir.isEmpty());
+    }
+
+    // nearest-rank percentiles of one run, in milliseconds
+    QJsonObject summarize(std::vector<double> samples)
+    {
+        QJsonObject summary;
+        if (samples.empty())
+            return summary;
+        std::sort(samples.begin(), samples.end());
+        auto percentile = [&](double p) {
+            return samples[(size_t)std::ceil(p * samples.size()) - 1];
+        };
+        double sum = 0.0;
+        for (double sample : samples)
+            sum += sample;
+        summary["mean"] = sum / samples.size();
+        summary["p50"] = percentile(0.50);
+        summary["p90"] = percentile(0.90);
+        summary["p99"] = percentile(0.99);
+        summary["max"] = samples.back();
+        return summary;
+    }
+
+    // puts the camera on a circle around the model, a little above it, looking at its center
+    void orbit(Camera &camera, const glm::vec3 &center, float distance, float angle)
+    {
+        const float degrees = 180.0f / 3.14159265f;
+        camera.position = center + distance * glm::vec3(std::cos(angle), 0.3f, std::sin(angle));
+        glm::vec3 direction = glm::normalize(center - camera.position);
+        camera.yaw = std::atan2(direction.z, direction.x) * degrees;
+        camera.pitch = std::asin(direction.y) * degrees;
+        camera.rotate(0.0f, 0.0f);
+    }
+
+    // a sphere around everything drawn, the model and the built-in cubes, for the orbit to circle
+    void sceneBounds(const Renderer &renderer, glm::vec3 &center, float &radius)
+    {
+        glm::vec3 lower(std::numeric_limits<float>::max());
+        glm::vec3 upper(-std::numeric_limits<float>::max());
+        for (const GameObject* object : renderer.objects())
+        {
+            const Mesh* mesh = object->mesh();
+            if (mesh == nullptr || mesh->boundingRadius() <= 0.0f)
+                continue;
+            glm::mat4 model = object->modelMatrix();
+            glm::vec3 objectCenter = glm::vec3(model * glm::vec4(mesh->boundingCenter(), 1.0f));
+            float scale = std::max(glm::length(glm::vec3(model[0])),
+                                   std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+            glm::vec3 extent(mesh->boundingRadius() * scale);
+            lower = glm::min(lower, objectCenter - extent);
+            upper = glm::max(upper, objectCenter + extent);
+        }
+        if (lower.x > upper.x) {
+            center = glm::vec3(0.0f);
+            radius = 1.0f;
+            return;
+        }
+        center = (lower + upper) * 0.5f;
+        radius = glm::length(upper - lower) * 0.5f;
+    }
+
+    struct Mode
+    {
+        const char* name;
+        int value;
+    };
+
+    const Mode SHADING_MODES[] = {
+        { "gouraud", Renderer::GOURAUD },
+        { "phong", Renderer::PHONG },
+        { "deferred", Renderer::DEFERRED }
+    };
+
+    const Mode DISPLAY_MODES[] = {
+        { "fill", Renderer::FILL },
+        { "filllines", Renderer::FILLLINES },
+        { "wireframe", Renderer::WIREFRAME }
+    };
+
+    const Mode TEXTURE_MODES[] = {
+        { "texture", Renderer::TEXTURE },
+        { "color", Renderer::COLOR }
+    };
+
+    // one orbit in the renderer's current modes; CPU time is what render() takes to issue the frame,
+    // GPU time comes from a GL_TIME_ELAPSED query per frame, read once the run is done.
+    // The model is circled, or everything drawn with --builtin. The image of the first position,
+    // once warmed up, goes to capture if there is one.
+    QJsonObject measure(Renderer &renderer, GLuint framebuffer, const Options &options, QImage *capture)
+    {
+        glm::vec3 center = renderer.model().boundingCenter();
+        float radius = renderer.model().boundingRadius();
+        if (options.builtin)
+            sceneBounds(renderer, center, radius);
+        const float distance = std::max(radius, 0.01f) * 2.5f;
+
+        orbit(renderer.camera, center, distance, 0.0f);
+        for (int i = 0; i < WARMUP_FRAMES || (renderer.isStreamingTextures() && i < MAX_WARMUP_FRAMES); i++)
+            renderer.render(framebuffer, options.width, options.height);
+        glFinish();
+        if (capture)
+            *capture = bench::readFramebuffer(framebuffer, options.width, options.height);
+
+        std::vector<GLuint> queries(options.frames);
+        glGenQueries(options.frames, queries.data());
+        std::vector<double> cpu, gpu;
+        cpu.reserve(options.frames);
+        RenderStats::Counters total;
+        for (int frame = 0; frame < options.frames; frame++)
+        {
+            orbit(renderer.camera, center, distance, 6.2831853f * frame / options.frames);
+            auto start = std::chrono::steady_clock::now();
+            glBeginQuery(GL_TIME_ELAPSED, queries[frame]);
+            renderer.render(framebuffer, options.width, options.height);
+            glEndQuery(GL_TIME_ELAPSED);
+            cpu.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+            const RenderStats::Counters& frameStats = RenderStats::instance().lastFrame();
+            total.drawCalls += frameStats.drawCalls;
+            total.triangles += frameStats.triangles;
+            total.vertices += frameStats.vertices;
+            total.programBinds += frameStats.programBinds;
+            total.textureBinds += frameStats.textureBinds;
+            total.vaoBinds += frameStats.vaoBinds;
+            total.uniformCalls += frameStats.uniformCalls;
+        }
+
+        gpu.reserve(options.frames);
+        for (GLuint query : queries)
+        {
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+            gpu.push_back(nanoseconds / 1.0e6);
+        }
+        glDeleteQueries(options.frames, queries.data());
+
+        QJsonObject run;
+        run["cpu_ms"] = summarize(cpu);
+        run["gpu_ms"] = summarize(gpu);
+
+        //per frame, averaged over the orbit
+        QJsonObject stats;
+        stats["draw_calls"] = (double)total.drawCalls / options.frames;
+        stats["triangles"] = (double)total.triangles / options.frames;
+        stats["vertices"] = (double)total.vertices / options.frames;
+        stats["program_binds"] = (double)total.programBinds / options.frames;
+        stats["texture_binds"] = (double)total.textureBinds / options.frames;
+        stats["vao_binds"] = (double)total.vaoBinds / options.frames;
+        stats["uniform_calls"] = (double)total.uniformCalls / options.frames;
+        run["stats"] = stats;
+        return run;
+    }
+
+    // Compares the image of a run with its golden, or makes it the golden. False if it's off,
+    // then the image and the differing pixels are saved next to the golden to look at.
+    bool checkGolden(const QImage &image, const QString &name, const Options &options, QJsonObject &run)
+    {
+        const QString goldenFile = options.goldenDir + "/" + name + ".png";
+        if (options.updateGoldens) {
+            if (!QDir().mkpath(options.goldenDir) || !image.save(goldenFile)) {
+                std::fprintf(stderr, "meshviewer-bench: can't write %s\n", goldenFile.toLocal8Bit().constData());
+                return false;
+            }
+            return true;
+        }
+
+        QImage golden(goldenFile);
+        if (golden.isNull()) {
+            std::fprintf(stderr, "meshviewer-bench: no golden %s, make it with --update-goldens\n",
+                         goldenFile.toLocal8Bit().constData());
+            return false;
+        }
+        bench::ImageDifference difference = bench::compare(golden, image, options.maxDeltaE);
+        QJsonObject result;
+        result["max_delta_e"] = difference.maxDeltaE;
+        result["mean_delta_e"] = difference.meanDeltaE;
+        result["diff_fraction"] = difference.differentFraction;
+        run["image"] = result;
+
+        bool passed = difference.comparable && difference.differentFraction <= options.maxDiffFraction;
+        if (!passed) {
+            if (difference.comparable)
+                std::fprintf(stderr, "%s: image differs, %.3f%% of pixels over dE %.1f, max dE %.1f\n",
+                             name.toLocal8Bit().constData(), difference.differentFraction * 100.0,
+                             options.maxDeltaE, difference.maxDeltaE);
+            else
+                std::fprintf(stderr, "%s: image is %dx%d, the golden %dx%d\n", name.toLocal8Bit().constData(),
+                             image.width(), image.height(), golden.width(), golden.height());
+            image.save(options.goldenDir + "/" + name + ".actual.png");
+            if (!difference.diff.isNull())
+                difference.diff.save(options.goldenDir + "/" + name + ".diff.png");
+        }
+        return passed;
+    }
+
+    // true if new is slower than old by more than the threshold; reports it
+    bool slower(const QString &metric, double old, double now, double threshold)
+    {
+        if (old <= 0.0 || now <= old * (1.0 + threshold / 100.0))
+            return false;
+        std::fprintf(stderr, "%s: %.3f ms, was %.3f ms (%+.1f%%)\n", metric.toLocal8Bit().constData(),
+                     now, old, (now - old) / old * 100.0);
+        return true;
+    }
+
+    // Load times and the median CPU and GPU frame times of every run against an earlier report,
+    // meant to be from the same machine. Returns the number of regressions, -1 if the baseline can't be read.
+    int compareWithBaseline(const QJsonObject &report, const Options &options)
+    {
+        QFile file(options.baseline);
+        if (!file.open(QIODevice::ReadOnly)) {
+            std::fprintf(stderr, "meshviewer-bench: can't read %s\n", options.baseline.toLocal8Bit().constData());
+            return -1;
+        }
+        const QJsonObject baseline = QJsonDocument::fromJson(file.readAll()).object();
+        if (baseline["renderer"].toString() != report["renderer"].toString())
+            std::fprintf(stderr, "meshviewer-bench: the baseline was measured on %s\n",
+                         baseline["renderer"].toString().toLocal8Bit().constData());
+
+        int regressions = 0;
+        regressions += slower("import", baseline["import_ms"].toDouble(), report["import_ms"].toDouble(),
+                              options.threshold);
+        regressions += slower("upload", baseline["upload_ms"].toDouble(), report["upload_ms"].toDouble(),
+                              options.threshold);
+        auto runName = [](const QJsonObject &run) {
+            return run["shading"].toString() + "/" + run["display"].toString() + "/" + run["texture"].toString();
+        };
+        const QJsonArray baselineRuns = baseline["runs"].toArray();
+        for (const QJsonValue& value : report["runs"].toArray())
+        {
+            const QJsonObject run = value.toObject();
+            for (const QJsonValue& baselineValue : baselineRuns)
+            {
+                const QJsonObject baselineRun = baselineValue.toObject();
+                if (runName(baselineRun) != runName(run))
+                    continue;
+                for (const char* clock : { "cpu_ms", "gpu_ms" })
+                    regressions += slower(runName(run) + " " + clock + " p50",
+                                          baselineRun[clock].toObject()["p50"].toDouble(),
+                                          run[clock].toObject()["p50"].toDouble(), options.threshold);
+            }
+        }
+        return regressions;
+    }
+
+    QString glString(GLenum name)
+    {
+        const GLubyte* value = glGetString(name);
+        return value ? QString(reinterpret_cast<const char*>(value)) : QString();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QGuiApplication a(argc, argv);
+
+    Options options;
+    if (!parseArguments(a.arguments(), options)) {
+        usage();
+        return 2;
+    }
+
+    // without --cache-dir every run encodes textures and links shaders from scratch, the cold case
+    if (!options.cacheDir.isEmpty()) {
+        if (QDir().mkpath(options.cacheDir + "/shaders"))
+            ShaderProgram::setBinaryCacheDirectory((options.cacheDir + "/shaders").toStdString());
+        if (QDir().mkpath(options.cacheDir + "/textures"))
+            TextureCache::setDirectory((options.cacheDir + "/textures").toStdString());
+    }
+
+    QSurfaceFormat format;
+    format.setVersion(3, 3);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    format.setDepthBufferSize(24);
+
+    QOpenGLContext context;
+    context.setFormat(format);
+    QOffscreenSurface surface;
+    surface.setFormat(format);
+    surface.create();
+    if (!context.create() || !context.makeCurrent(&surface)) {
+        std::fprintf(stderr, "meshviewer-bench: can't create an OpenGL 3.3 core context\n");
+        return 1;
+    }
+
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK) {
+        std::fprintf(stderr, "meshviewer-bench: glewInit failed\n");
+        return 1;
+    }
+    //glewInit leaves GL_INVALID_ENUM behind on core profiles
+    glGetError();
+    GLDebug::setEnabled(false);
+    GLDebug::initialize();
+
+    QJsonObject report;
+    //images off their goldens and times over the baseline
+    int failures = 0;
+    {
+        QOpenGLFramebufferObject framebuffer(options.width, options.height, QOpenGLFramebufferObject::Depth);
+        Renderer renderer;
+        renderer.initialize();
+
+        Renderer::LoadTimes times = { 0.0, 0.0 };
+        if (!options.builtin && !renderer.loadModel(options.model.toStdString(), &times)) {
+            std::fprintf(stderr, "meshviewer-bench: can't load %s\n", options.model.toLocal8Bit().constData());
+            renderer.destroy();
+            return 1;
+        }
+
+        report["model"] = options.builtin ? QString("builtin") : options.model;
+        report["renderer"] = glString(GL_RENDERER);
+        report["version"] = glString(GL_VERSION);
+        report["width"] = options.width;
+        report["height"] = options.height;
+        report["frames"] = options.frames;
+        report["textured"] = options.textured;
+        report["import_ms"] = times.importMilliseconds;
+        report["upload_ms"] = times.uploadMilliseconds;
+
+        QJsonArray runs;
+        for (const Mode& texture : TEXTURE_MODES)
+        {
+            if (!options.textured && texture.value == Renderer::TEXTURE)
+                continue;
+            for (const Mode& shading : SHADING_MODES)
+            {
+                for (const Mode& display : DISPLAY_MODES)
+                {
+                    renderer.textureMode = (Renderer::TEXTUREMODE)texture.value;
+                    renderer.shadingMode = (Renderer::SHADINGMODE)shading.value;
+                    renderer.displayMode = (Renderer::DISPLAYMODE)display.value;
+                    QImage image;
+                    QJsonObject run = measure(renderer, framebuffer.handle(), options,
+                                              options.goldenDir.isEmpty() ? nullptr : &image);
+                    run["shading"] = shading.name;
+                    run["display"] = display.name;
+                    run["texture"] = texture.name;
+                    if (!options.goldenDir.isEmpty()) {
+                        QString name = QString("%1-%2-%3").arg(shading.name).arg(display.name).arg(texture.name);
+                        if (!checkGolden(image, name, options, run))
+                            failures++;
+                    }
+                    runs.append(run);
+                }
+            }
+        }
+        report["runs"] = runs;
+
+        renderer.destroy();
+    }
+    context.doneCurrent();
+
+    const QByteArray json = QJsonDocument(report).toJson();
+    if (options.output.isEmpty()) {
+        std::fwrite(json.constData(), 1, json.size(), stdout);
+    } else {
+        QFile file(options.output);
+        if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+            std::fprintf(stderr, "meshviewer-bench: can't write %s\n", options.output.toLocal8Bit().constData());
+            return 1;
+        }
+    }
+
+    if (!options.baseline.isEmpty()) {
+        int regressions = compareWithBaseline(report, options);
+        if (regressions < 0)
+            return 1;
+        failures += regressions;
+    }
+    if (failures > 0)
+        std::fprintf(stderr, "meshviewer-bench: %d check%s failed\n", failures, failures == 1 ? "" : "s");
+    return failures > 0 ? 1 : 0;
+}
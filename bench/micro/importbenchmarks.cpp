@@ -0,0 +1,330 @@
+#include "microbench.h"
+#include "mesh.h"
+#include "submesh.h"
+#include "shaderprogram.h"
+#include "texturecache.h"
+#include "picking.h"
+
+#include <QTemporaryDir>
+
+#include <assimp/scene.h>
+#include <assimp/material.h>
+
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <map>
+#include <memory>
+#include <random>
+
+// The import and mesh-processing hot paths, on synthetic inputs from fixed seeds so two runs
+// see the same data. None of it needs a GL context: meshes are processed but never uploaded,
+// and textures go through TextureCache::load(), the CPU side of Mesh::genTextures().
+//
+//   meshviewer-microbench --benchmark_out=before.json
+//   python bench/compare.py before.json after.json
+
+using namespace makai;
+
+namespace
+{
+    const unsigned SEED = 20170518;
+    // images per texture benchmark iteration, different content so no cache can help
+    const int TEXTURE_COUNT = 4;
+
+    const char* LIGHT_PROPERTIES[] = { "intensity", "position", "attenuation" };
+
+    // About vertexCount vertices on a jittered grid, two triangles per cell.
+    aiMesh* makeMesh(unsigned vertexCount, unsigned materialIndex, std::mt19937 &random)
+    {
+        std::uniform_real_distribution<float> jitter(-0.25f, 0.25f);
+        const unsigned side = std::max(2u, (unsigned)std::sqrt((double)vertexCount));
+
+        aiMesh* mesh = new aiMesh();
+        mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+        mesh->mMaterialIndex = materialIndex;
+        mesh->mNumVertices = side * side;
+        mesh->mVertices = new aiVector3D[mesh->mNumVertices];
+        mesh->mNormals = new aiVector3D[mesh->mNumVertices];
+        mesh->mTextureCoords[0] = new aiVector3D[mesh->mNumVertices];
+        mesh->mNumUVComponents[0] = 2;
+        for (unsigned y = 0; y < side; y++)
+        {
+            for (unsigned x = 0; x < side; x++)
+            {
+                unsigned i = y * side + x;
+                mesh->mVertices[i] = aiVector3D(x + jitter(random), jitter(random), y + jitter(random));
+                aiVector3D normal(jitter(random), 1.0f, jitter(random));
+                mesh->mNormals[i] = normal.Normalize();
+                mesh->mTextureCoords[0][i] = aiVector3D((float)x / (side - 1), (float)y / (side - 1), 0.0f);
+            }
+        }
+
+        mesh->mNumFaces = (side - 1) * (side - 1) * 2;
+        mesh->mFaces = new aiFace[mesh->mNumFaces];
+        for (unsigned y = 0, face = 0; y + 1 < side; y++)
+        {
+            for (unsigned x = 0; x + 1 < side; x++)
+            {
+                unsigned corner = y * side + x;
+                const unsigned triangles[2][3] = { { corner, corner + side, corner + 1 },
+                                                   { corner + 1, corner + side, corner + side + 1 } };
+                for (const unsigned* triangle : triangles)
+                {
+                    aiFace& f = mesh->mFaces[face++];
+                    f.mNumIndices = 3;
+                    f.mIndices = new unsigned[3] { triangle[0], triangle[1], triangle[2] };
+                }
+            }
+        }
+        return mesh;
+    }
+
+    // Diffuse, specular and normal maps, named after entries of a pool of textureCount images,
+    // so materials share some of them as they do in real models.
+    aiMaterial* makeMaterial(unsigned textureCount, std::mt19937 &random)
+    {
+        std::uniform_int_distribution<unsigned> pick(0, textureCount - 1);
+        auto name = [&]() {
+            char fileName[32];
+            std::snprintf(fileName, sizeof(fileName), "texture_%04u.tga", pick(random));
+            return aiString(fileName);
+        };
+
+        aiMaterial* material = new aiMaterial();
+        aiString diffuse = name(), specular = name(), normal = name();
+        material->AddProperty(&diffuse, AI_MATKEY_TEXTURE_DIFFUSE(0));
+        material->AddProperty(&specular, AI_MATKEY_TEXTURE_SPECULAR(0));
+        material->AddProperty(&normal, AI_MATKEY_TEXTURE_NORMALS(0));
+        return material;
+    }
+
+    // meshCount meshes under the root node, each with its own material
+    std::unique_ptr<aiScene> makeScene(unsigned meshCount, unsigned verticesPerMesh, unsigned textureCount)
+    {
+        std::mt19937 random(SEED);
+        std::unique_ptr<aiScene> scene(new aiScene());
+        scene->mNumMeshes = meshCount;
+        scene->mMeshes = new aiMesh*[meshCount];
+        scene->mNumMaterials = meshCount;
+        scene->mMaterials = new aiMaterial*[meshCount];
+        scene->mRootNode = new aiNode();
+        scene->mRootNode->mNumMeshes = meshCount;
+        scene->mRootNode->mMeshes = new unsigned[meshCount];
+        for (unsigned i = 0; i < meshCount; i++)
+        {
+            scene->mMeshes[i] = makeMesh(verticesPerMesh, i, random);
+            scene->mMaterials[i] = makeMaterial(textureCount, random);
+            scene->mRootNode->mMeshes[i] = i;
+        }
+        return scene;
+    }
+
+    // TEXTURE_COUNT size x size images of smooth color plus noise, written once per size as TGA,
+    // the format SOIL can write; the cache and the encoder don't care what the source was
+    const std::vector<std::string>& textureFiles(int size)
+    {
+        static QTemporaryDir directory;
+        static std::map<int, std::vector<std::string>> files;
+        std::vector<std::string>& sized = files[size];
+        if (!sized.empty())
+            return sized;
+
+        std::mt19937 random(SEED + size);
+        std::uniform_int_distribution<int> noise(-24, 24);
+        std::vector<unsigned char> image((size_t)size * size * 4);
+        for (int t = 0; t < TEXTURE_COUNT; t++)
+        {
+            for (int y = 0; y < size; y++)
+            {
+                for (int x = 0; x < size; x++)
+                {
+                    unsigned char* texel = &image[((size_t)y * size + x) * 4];
+                    int base[3] = { x * 255 / size, y * 255 / size, (x + y + t * 64) * 127 / size };
+                    for (int c = 0; c < 3; c++)
+                        texel[c] = (unsigned char)std::min(std::max(base[c] + noise(random), 0), 255);
+                    texel[3] = 255;
+                }
+            }
+            char name[64];
+            std::snprintf(name, sizeof(name), "/noise_%d_%d.tga", size, t);
+            std::string fileName = directory.path().toStdString() + name;
+            if (SOIL_save_image(fileName.c_str(), SOIL_SAVE_TYPE_TGA, size, size, 4, image.data()))
+                sized.push_back(fileName);
+        }
+        return sized;
+    }
+
+    void loadTextures(bench::State &state)
+    {
+        const std::vector<std::string>& files = textureFiles((int)state.argument());
+        while (state.keepRunning())
+        {
+            for (const std::string& file : files)
+            {
+                TextureData data;
+                TextureCache::load(file, TextureCache::COLOR, data);
+                bench::doNotOptimize(data.levels.size());
+            }
+        }
+        state.setItemsProcessed((int64_t)state.iterations() * files.size());
+        state.setBytesProcessed((int64_t)state.iterations() * files.size() * state.argument() * state.argument() * 4);
+    }
+}
+
+// Mesh::processMesh() through loadModelFromScene(), one mesh of about argument vertices
+static void processMesh(bench::State &state)
+{
+    std::unique_ptr<aiScene> scene = makeScene(1, (unsigned)state.argument(), 3);
+    while (state.keepRunning())
+    {
+        Mesh mesh;
+        mesh.loadModelFromScene(scene.get(), "textures");
+        bench::doNotOptimize(&mesh);
+    }
+    state.setItemsProcessed((int64_t)state.iterations() * scene->mMeshes[0]->mNumVertices);
+}
+MAKAI_BENCHMARK(processMesh, 1 << 10, 1 << 14, 1 << 18);
+
+// Mesh::loadMaterialTextures(): argument small meshes with a material each, textures shared between them
+static void loadMaterialTextures(bench::State &state)
+{
+    const unsigned materials = (unsigned)state.argument();
+    std::unique_ptr<aiScene> scene = makeScene(materials, 4, materials * 2);
+    while (state.keepRunning())
+    {
+        Mesh mesh;
+        mesh.loadModelFromScene(scene.get(), "textures");
+        bench::doNotOptimize(&mesh);
+    }
+    state.setItemsProcessed((int64_t)state.iterations() * materials);
+}
+MAKAI_BENCHMARK(loadMaterialTextures, 16, 256, 1024);
+
+// SubMesh's constructor copying the vertex, index and texture index arrays of argument vertices
+static void subMeshConstruction(bench::State &state)
+{
+    std::unique_ptr<aiScene> scene = makeScene(1, (unsigned)state.argument(), 3);
+    const aiMesh* source = scene->mMeshes[0];
+    std::vector<float> vertices((size_t)source->mNumVertices * 8);
+    std::vector<unsigned> indices;
+    for (unsigned i = 0; i < source->mNumFaces; i++)
+        indices.insert(indices.end(), source->mFaces[i].mIndices, source->mFaces[i].mIndices + 3);
+    std::vector<unsigned> texIndices = { 0, 1, 2 };
+
+    while (state.keepRunning())
+    {
+        SubMesh subMesh(vertices, indices, texIndices, 8);
+        bench::doNotOptimize(&subMesh);
+    }
+    state.setBytesProcessed((int64_t)state.iterations() *
+                            (vertices.size() * sizeof(float) + indices.size() * sizeof(unsigned)));
+}
+MAKAI_BENCHMARK(subMeshConstruction, 1 << 10, 1 << 14, 1 << 18);
+
+// the names setArrayUniform() builds for argument lights each frame, three properties a light
+static void arrayUniformName(bench::State &state)
+{
+    while (state.keepRunning())
+    {
+        for (int64_t light = 0; light < state.argument(); light++)
+        {
+            for (const char* property : LIGHT_PROPERTIES)
+            {
+                std::string name = ShaderProgram::arrayUniformName("allLights", (size_t)light, property);
+                bench::doNotOptimize(name);
+            }
+        }
+    }
+    state.setItemsProcessed((int64_t)state.iterations() * state.argument() * 3);
+}
+MAKAI_BENCHMARK(arrayUniformName, 8, 64);
+
+// decoding and mip chains without compression, as with --no-texture-compression
+static void textureDecode(bench::State &state)
+{
+    TextureCache::setEnabled(false);
+    loadTextures(state);
+    TextureCache::setEnabled(true);
+}
+MAKAI_BENCHMARK(textureDecode, 256, 1024);
+
+// the first import of a texture: decoding, mip chain and block compression
+static void textureEncode(bench::State &state)
+{
+    const std::string directory = TextureCache::directory();
+    TextureCache::setDirectory(std::string());
+    loadTextures(state);
+    TextureCache::setDirectory(directory);
+}
+MAKAI_BENCHMARK(textureEncode, 256, 1024);
+
+// later imports, reading the KTX files the first one wrote
+static void textureCacheHit(bench::State &state)
+{
+    static QTemporaryDir cache;
+    const std::string directory = TextureCache::directory();
+    TextureCache::setDirectory(cache.path().toStdString());
+    for (const std::string& file : textureFiles((int)state.argument()))
+    {
+        TextureData data;
+        TextureCache::load(file, TextureCache::COLOR, data);
+    }
+    loadTextures(state);
+    TextureCache::setDirectory(directory);
+}
+MAKAI_BENCHMARK(textureCacheHit, 256, 1024);
+
+// Bvh::buildTriangles() over the grid mesh of about argument vertices, two triangles a vertex
+static void bvhBuild(bench::State &state)
+{
+    std::unique_ptr<aiScene> scene = makeScene(1, (unsigned)state.argument(), 3);
+    Mesh mesh;
+    mesh.loadModelFromScene(scene.get(), "textures");
+    const SubMesh& subMesh = mesh.subMeshes().at(0);
+    while (state.keepRunning())
+    {
+        Bvh bvh;
+        bvh.buildTriangles(subMesh.vertices, subMesh.step, subMesh.indices);
+        bench::doNotOptimize(bvh.nodes().data());
+    }
+    state.setItemsProcessed((int64_t)state.iterations() * subMesh.indices.size() / 3);
+}
+MAKAI_BENCHMARK(bvhBuild, 1 << 14, 1 << 18, 1 << 22);
+
+// Picking::intersect(), what a click costs: random rays down onto the grid mesh of about argument vertices
+static void pickRay(bench::State &state)
+{
+    std::unique_ptr<aiScene> scene = makeScene(1, (unsigned)state.argument(), 3);
+    Mesh mesh;
+    mesh.loadModelFromScene(scene.get(), "textures");
+    mesh.buildBvhs();
+    const float side = std::sqrt((float)state.argument());
+
+    std::mt19937 random(SEED);
+    std::uniform_real_distribution<float> position(0.0f, side), tilt(-0.5f, 0.5f);
+    std::vector<Picking::Ray> rays(1024);
+    for (Picking::Ray& ray : rays)
+    {
+        ray.origin = glm::vec3(position(random), 10.0f, position(random));
+        ray.direction = glm::normalize(glm::vec3(tilt(random), -1.0f, tilt(random)));
+    }
+
+    size_t next = 0;
+    int64_t hits = 0;
+    while (state.keepRunning())
+    {
+        float distance = std::numeric_limits<float>::infinity();
+        Picking::Hit hit;
+        hits += Picking::intersect(mesh, rays[next++ % rays.size()], distance, hit) ? 1 : 0;
+        bench::doNotOptimize(hit.triangle);
+    }
+    state.setItemsProcessed((int64_t)state.iterations());
+    state.setLabel(std::to_string(hits * 100 / std::max<int64_t>((int64_t)state.iterations(), 1)) + "% hit");
+}
+MAKAI_BENCHMARK(pickRay, 1 << 14, 1 << 18, 1 << 22);
+
+int main(int argc, char *argv[])
+{
+    return bench::runBenchmarks(argc, argv);
+}
@@ -0,0 +1,77 @@
+#-------------------------------------------------
+#
+# Microbenchmarks of the import and mesh-processing paths, no GL context needed.
+# bench/compare.py compares the JSON of two runs.
+#
+#-------------------------------------------------
+
+QT       += core
+
+TARGET = meshviewer-microbench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += \
+    microbench.cpp \
+    importbenchmarks.cpp \
+    ../../src/shader.cpp \
+    ../../src/shaderprogram.cpp \
+    ../../src/mesh.cpp \
+    ../../src/light.cpp \
+    ../../src/submesh.cpp \
+    ../../src/makaidebug.cpp \
+    ../../src/threadpool.cpp \
+    ../../src/blockcompression.cpp \
+    ../../src/texturecache.cpp \
+    ../../src/texturestreamer.cpp \
+    ../../src/mipchain.cpp \
+    ../../src/tracer.cpp \
+    ../../src/memorytracker.cpp \
+    ../../src/renderstats.cpp \
+    ../../src/bvh.cpp \
+    ../../src/gameobject.cpp \
+    ../../src/picking.cpp \
+    ../../src/scenegraph.cpp
+
+HEADERS += \
+    microbench.h \
+    ../../headers/shaderprogram.h \
+    ../../headers/shader.h \
+    ../../headers/mesh.h \
+    ../../headers/light.h \
+    ../../headers/submesh.h \
+    ../../headers/makaidebug.h \
+    ../../headers/uniform.h \
+    ../../headers/threadpool.h \
+    ../../headers/blockcompression.h \
+    ../../headers/texturecache.h \
+    ../../headers/texturestreamer.h \
+    ../../headers/mipchain.h \
+    ../../headers/tracer.h \
+    ../../headers/memorytracker.h \
+    ../../headers/renderstats.h \
+    ../../headers/bvh.h \
+    ../../headers/gameobject.h \
+    ../../headers/picking.h \
+    ../../headers/scenegraph.h
+
+INCLUDEPATH += $$PWD/../../headers
+
+DISTFILES += \
+    ../compare.py
+
+win32 {
+    LIBS += -L$$PWD/../../lib/x86 -lassimp \
+        -lopengl32 \
+        -lGlu32 \
+        -L$$PWD/../../lib/x86 -lglew32 \
+        -lglew32s \
+        -lSOIL
+}
+
+unix {
+    LIBS += -lassimp -lGLEW -lGL -lSOIL
+}
@@ -0,0 +1,334 @@
+#include "microbench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <thread>
+
+using namespace makai::bench;
+
+namespace
+{
+    struct Benchmark
+    {
+        std::string name;
+        Function function;
+        std::vector<int64_t> arguments;
+    };
+
+    std::vector<Benchmark>& registry()
+    {
+        static std::vector<Benchmark> benchmarks;
+        return benchmarks;
+    }
+
+    struct Options
+    {
+        std::string filter;
+        std::string output;
+        double minTime = 0.5;
+        int repetitions = 3;
+    };
+
+    // one line of the report, times per iteration in nanoseconds
+    struct Result
+    {
+        std::string name;
+        std::string runName;
+        // "iteration" for a repetition, "aggregate" for mean, median and stddev over them
+        std::string runType;
+        std::string aggregateName;
+        int repetitionIndex = 0;
+        uint64_t iterations = 0;
+        double realTime = 0.0;
+        double cpuTime = 0.0;
+        double itemsPerSecond = 0.0;
+        double bytesPerSecond = 0.0;
+        std::string label;
+    };
+
+    const uint64_t MAX_ITERATIONS = 1000000000;
+
+    double realNow()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // process time, so work handed to the thread pool counts too
+    double cpuNow()
+    {
+        return (double)std::clock() / CLOCKS_PER_SEC;
+    }
+
+    bool parseOptions(int argc, char *argv[], Options &options)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            const char* argument = argv[i];
+            const char* value = std::strchr(argument, '=');
+            const std::string key = value ? std::string(argument, value - argument) : std::string(argument);
+            if (value)
+                value++;
+            if (key == "--benchmark_filter" && value)
+                options.filter = value;
+            else if (key == "--benchmark_out" && value)
+                options.output = value;
+            else if (key == "--benchmark_min_time" && value)
+                options.minTime = std::atof(value);
+            else if (key == "--benchmark_repetitions" && value)
+                options.repetitions = std::max(std::atoi(value), 1);
+            else
+                return false;
+        }
+        return true;
+    }
+
+    Result makeResult(const std::string &runName, const State &state, int repetition)
+    {
+        Result result;
+        result.name = runName;
+        result.runName = runName;
+        result.runType = "iteration";
+        result.repetitionIndex = repetition;
+        result.iterations = state.iterations();
+        result.realTime = state.realSeconds() * 1e9 / state.iterations();
+        result.cpuTime = state.cpuSeconds() * 1e9 / state.iterations();
+        if (state.realSeconds() > 0.0)
+        {
+            result.itemsPerSecond = state.itemsProcessed() / state.realSeconds();
+            result.bytesPerSecond = state.bytesProcessed() / state.realSeconds();
+        }
+        result.label = state.label();
+        return result;
+    }
+
+    Result aggregate(const std::vector<Result> &runs, const char *name)
+    {
+        auto combine = [&](double Result::*field) {
+            std::vector<double> values;
+            for (const Result& run : runs)
+                values.push_back(run.*field);
+            double mean = 0.0;
+            for (double value : values)
+                mean += value / values.size();
+            if (std::strcmp(name, "mean") == 0)
+                return mean;
+            if (std::strcmp(name, "median") == 0)
+            {
+                std::sort(values.begin(), values.end());
+                size_t middle = values.size() / 2;
+                return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2.0;
+            }
+            double variance = 0.0;
+            for (double value : values)
+                variance += (value - mean) * (value - mean);
+            return values.size() > 1 ? std::sqrt(variance / (values.size() - 1)) : 0.0;
+        };
+
+        Result result = runs.front();
+        result.name = runs.front().runName + "_" + name;
+        result.runType = "aggregate";
+        result.aggregateName = name;
+        result.realTime = combine(&Result::realTime);
+        result.cpuTime = combine(&Result::cpuTime);
+        result.itemsPerSecond = combine(&Result::itemsPerSecond);
+        result.bytesPerSecond = combine(&Result::bytesPerSecond);
+        return result;
+    }
+
+    // Grows the iteration count until a run lasts minTime, like Google Benchmark does,
+    // then repeats the run at that count.
+    std::vector<Result> run(const Benchmark &benchmark, int64_t argument, const std::string &runName,
+                            const Options &options)
+    {
+        std::vector<Result> results;
+        uint64_t iterations = 1;
+        for (;;)
+        {
+            State state(argument, iterations);
+            benchmark.function(state);
+            const double seconds = state.realSeconds();
+            if (seconds >= options.minTime || iterations >= MAX_ITERATIONS)
+            {
+                results.push_back(makeResult(runName, state, 0));
+                break;
+            }
+            double multiplier = seconds / options.minTime > 0.1 ? options.minTime * 1.4 / seconds : 10.0;
+            iterations = std::min(std::max(iterations + 1, (uint64_t)(iterations * multiplier)), MAX_ITERATIONS);
+        }
+
+        for (int repetition = 1; repetition < options.repetitions; repetition++)
+        {
+            State state(argument, iterations);
+            benchmark.function(state);
+            results.push_back(makeResult(runName, state, repetition));
+        }
+        return results;
+    }
+
+    void print(const Result &result)
+    {
+        std::printf("%-48s %13.0f ns %13.0f ns %12llu", result.name.c_str(), result.realTime, result.cpuTime,
+                    (unsigned long long)result.iterations);
+        if (result.itemsPerSecond > 0.0)
+            std::printf(" %10.3g items/s", result.itemsPerSecond);
+        if (result.bytesPerSecond > 0.0)
+            std::printf(" %8.1f MB/s", result.bytesPerSecond / 1048576.0);
+        if (!result.label.empty())
+            std::printf(" %s", result.label.c_str());
+        std::printf("\n");
+    }
+
+    std::string quoted(const std::string &text)
+    {
+        std::string out = "\"";
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            out += c;
+        }
+        return out + "\"";
+    }
+
+    bool writeJson(const std::string &fileName, const std::vector<Result> &results, int repetitions)
+    {
+        std::ofstream file(fileName);
+        if (!file.is_open())
+            return false;
+        file.precision(10);
+
+        char date[64];
+        std::time_t now = std::time(nullptr);
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+#ifdef _DEBUG
+        const char* buildType = "debug";
+#else
+        const char* buildType = "release";
+#endif
+        file << "{\n  \"context\": {\n"
+             << "    \"date\": " << quoted(date) << ",\n"
+             << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+             << "    \"library_build_type\": " << quoted(buildType) << "\n"
+             << "  },\n  \"benchmarks\": [";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const Result& result = results[i];
+            file << (i ? ",\n" : "\n") << "    {\n"
+                 << "      \"name\": " << quoted(result.name) << ",\n"
+                 << "      \"run_name\": " << quoted(result.runName) << ",\n"
+                 << "      \"run_type\": " << quoted(result.runType) << ",\n";
+            if (!result.aggregateName.empty())
+                file << "      \"aggregate_name\": " << quoted(result.aggregateName) << ",\n";
+            file << "      \"repetitions\": " << repetitions << ",\n"
+                 << "      \"repetition_index\": " << result.repetitionIndex << ",\n"
+                 << "      \"iterations\": " << result.iterations << ",\n"
+                 << "      \"real_time\": " << result.realTime << ",\n"
+                 << "      \"cpu_time\": " << result.cpuTime << ",\n"
+                 << "      \"time_unit\": \"ns\"";
+            if (result.itemsPerSecond > 0.0)
+                file << ",\n      \"items_per_second\": " << result.itemsPerSecond;
+            if (result.bytesPerSecond > 0.0)
+                file << ",\n      \"bytes_per_second\": " << result.bytesPerSecond;
+            if (!result.label.empty())
+                file << ",\n      \"label\": " << quoted(result.label);
+            file << "\n    }";
+        }
+        file << "\n  ]\n}\n";
+        return file.good();
+    }
+}
+
+State::State(int64_t argument, uint64_t iterations) :
+    m_argument(argument), m_iterations(iterations), m_remaining(iterations), m_running(false),
+    m_realStart(0.0), m_cpuStart(0.0), m_realSeconds(0.0), m_cpuSeconds(0.0), m_items(0), m_bytes(0), m_label()
+{
+}
+
+bool State::keepRunning()
+{
+    // the first call starts the clocks, the last stops them
+    if (m_remaining == m_iterations && !m_running)
+        resumeTiming();
+    if (m_remaining > 0)
+    {
+        m_remaining--;
+        return true;
+    }
+    pauseTiming();
+    return false;
+}
+
+void State::pauseTiming()
+{
+    if (!m_running)
+        return;
+    m_realSeconds += realNow() - m_realStart;
+    m_cpuSeconds += cpuNow() - m_cpuStart;
+    m_running = false;
+}
+
+void State::resumeTiming()
+{
+    m_realStart = realNow();
+    m_cpuStart = cpuNow();
+    m_running = true;
+}
+
+int makai::bench::registerBenchmark(const char *name, Function function, const std::vector<int64_t> &arguments)
+{
+    Benchmark benchmark;
+    benchmark.name = name;
+    benchmark.function = function;
+    benchmark.arguments = arguments;
+    registry().push_back(benchmark);
+    return (int)registry().size();
+}
+
+int makai::bench::runBenchmarks(int argc, char *argv[])
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        std::fprintf(stderr, "usage: %s [--benchmark_filter=substring] [--benchmark_min_time=seconds]"
+                             " [--benchmark_repetitions=n] [--benchmark_out=file.json]\n", argv[0]);
+        return 2;
+    }
+
+    std::printf("%-48s %16s %16s %12s\n", "Benchmark", "Time", "CPU", "Iterations");
+    std::vector<Result> results;
+    for (const Benchmark& benchmark : registry())
+    {
+        for (int64_t argument : benchmark.arguments)
+        {
+            const std::string runName = benchmark.name + "/" + std::to_string(argument);
+            if (!options.filter.empty() && runName.find(options.filter) == std::string::npos)
+                continue;
+
+            std::vector<Result> runs = run(benchmark, argument, runName, options);
+            for (const Result& result : runs)
+                print(result);
+            results.insert(results.end(), runs.begin(), runs.end());
+            if (runs.size() > 1)
+            {
+                for (const char* name : { "mean", "median", "stddev" })
+                {
+                    results.push_back(aggregate(runs, name));
+                    print(results.back());
+                }
+            }
+        }
+    }
+
+    if (!options.output.empty() && !writeJson(options.output, results, options.repetitions))
+    {
+        std::fprintf(stderr, "can't write %s\n", options.output.c_str());
+        return 1;
+    }
+    return 0;
+}
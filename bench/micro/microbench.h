@@ -0,0 +1,83 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "makaidebug.h"
+
+namespace makai
+{
+    namespace bench
+    {
+        // The timing loop of one run, in the style of Google Benchmark:
+        //     static void textureDecode(bench::State& state) { setup; while (state.keepRunning()) { work; } }
+        // The runner picks the iteration count so a run lasts about --benchmark_min_time seconds.
+        class State
+        {
+        public:
+            State(int64_t argument, uint64_t iterations);
+
+            bool keepRunning();
+            // the argument the benchmark was registered with for this run
+            int64_t argument() const { return m_argument; }
+            uint64_t iterations() const { return m_iterations; }
+
+            // Stops the clocks around per-iteration setup that shouldn't be measured.
+            void pauseTiming();
+            void resumeTiming();
+
+            // Totals over all iterations, reported as rates.
+            void setItemsProcessed(int64_t items) { m_items = items; }
+            void setBytesProcessed(int64_t bytes) { m_bytes = bytes; }
+            void setLabel(const std::string &label) { m_label = label; }
+
+            double realSeconds() const { return m_realSeconds; }
+            double cpuSeconds() const { return m_cpuSeconds; }
+            int64_t itemsProcessed() const { return m_items; }
+            int64_t bytesProcessed() const { return m_bytes; }
+            const std::string& label() const { return m_label; }
+
+        private:
+            int64_t m_argument;
+            uint64_t m_iterations;
+            uint64_t m_remaining;
+            bool m_running;
+            double m_realStart;
+            double m_cpuStart;
+            double m_realSeconds;
+            double m_cpuSeconds;
+            int64_t m_items;
+            int64_t m_bytes;
+            std::string m_label;
+        };
+
+        typedef void (*Function)(State&);
+
+        // Runs the function once per argument, as "name/argument". Use MAKAI_BENCHMARK.
+        int registerBenchmark(const char *name, Function function, const std::vector<int64_t> &arguments);
+
+        // Runs the registered benchmarks, prints a table, and with --benchmark_out=file writes
+        // Google Benchmark's JSON format, which bench/compare.py reads. Other options:
+        // --benchmark_filter=substring, --benchmark_min_time=seconds, --benchmark_repetitions=n.
+        int runBenchmarks(int argc, char *argv[]);
+
+        // Keeps the compiler from dropping a computation whose result is unused.
+        template <typename T>
+        inline void doNotOptimize(const T &value)
+        {
+#if defined(_MSC_VER)
+            static volatile const void* sink;
+            sink = &value;
+#else
+            asm volatile("" : : "r,m"(value) : "memory");
+#endif
+        }
+    }
+}
+
+#define MAKAI_BENCHMARK(function, ...) \
+    static int _MAKAI_CONCAT(_makaiBenchmark, __LINE__) = makai::bench::registerBenchmark(#function, function, { __VA_ARGS__ })
+
+#endif // MICROBENCH_H
@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""Renders the bundled scenes under software GL and fails if a picture or a time changed.
+
+Runs meshviewer-bench on models/sphere.dae, models/nanosuit/nanosuit.obj and the built-in cubes,
+in every display, shading and texture mode, with Mesa's llvmpipe so every machine draws the same
+pixels. Each run's image is compared with its golden in bench/golden/<scene>/ within a perceptual
+tolerance, and its load and median frame times with bench/baseline/<scene>.json.
+
+    python bench/regression.py [--bench path/to/meshviewer-bench] [--threshold 10]
+    python bench/regression.py --update     # after a change that is meant to alter the output
+
+Run it from the repository root. Timings are only comparable on the machine the baseline came from,
+--update there first, or --images-only elsewhere. Exits with 1 if any scene failed.
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+
+SCENES = [
+    ("sphere", ["models/sphere.dae"]),
+    ("nanosuit", ["models/nanosuit/nanosuit.obj"]),
+    ("builtin", ["--builtin"]),
+]
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--bench", default=os.path.join(HERE, "meshviewer-bench"),
+                        help="the meshviewer-bench executable")
+    parser.add_argument("--frames", type=int, default=60, help="measured frames per run (default 60)")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="percent slower that counts as a regression (default 10)")
+    parser.add_argument("--max-delta-e", type=float, default=2.3,
+                        help="per-pixel CIE76 color difference that counts as changed (default 2.3)")
+    parser.add_argument("--max-diff-fraction", type=float, default=0.001,
+                        help="fraction of changed pixels an image may have (default 0.001)")
+    parser.add_argument("--images-only", action="store_true", help="don't compare times")
+    parser.add_argument("--update", action="store_true", help="write new goldens and baselines instead")
+    args = parser.parse_args()
+
+    env = dict(os.environ)
+    env.update({
+        "QT_QPA_PLATFORM": "offscreen",
+        "LIBGL_ALWAYS_SOFTWARE": "1",
+        "GALLIUM_DRIVER": "llvmpipe",
+    })
+
+    failed = []
+    for name, scene in SCENES:
+        golden_dir = os.path.join(HERE, "golden", name)
+        baseline = os.path.join(HERE, "baseline", name + ".json")
+        command = [args.bench] + scene + [
+            "--frames", str(args.frames),
+            "--width", "640", "--height", "360",
+            "--golden-dir", golden_dir,
+            "--max-delta-e", str(args.max_delta_e),
+            "--max-diff-fraction", str(args.max_diff_fraction),
+        ]
+        if args.update:
+            os.makedirs(os.path.dirname(baseline), exist_ok=True)
+            command += ["--update-goldens", "--output", baseline]
+        else:
+            command += ["--output", os.path.join(HERE, name + ".result.json")]
+            if not args.images_only:
+                command += ["--baseline", baseline, "--threshold", str(args.threshold)]
+
+        print("== %s" % name, flush=True)
+        if subprocess.call(command, env=env) != 0:
+            failed.append(name)
+
+    if failed:
+        print("\nfailed: %s" % ", ".join(failed))
+        return 1
+    print("\nall scenes %s" % ("updated" if args.update else "match"))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,194 @@
+#include "renderer.h"
+#include "renderstats.h"
+#include "framecapture.h"
+#include "tracer.h"
+
+#include <QGuiApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QSurfaceFormat>
+#include <QStringList>
+#include <QImage>
+
+#include <chrono>
+#include <cstdio>
+
+// Draws a frame saved with Debug > Capture Frame again and again offscreen, for a profiler to look at
+// without the viewer, the original interaction or, with embedded geometry, the model file.
+//
+//   meshviewer-replay <capture.mkfc> [--frames N] [--trace file.json] [--save frame.png]
+//
+// --frames 0 loops until killed. Every 100 frames and at the end the CPU and GPU frame times and the
+// RenderStats counters are printed. Run it from the repository root, where shaders/ is.
+
+using namespace makai;
+
+namespace
+{
+    struct Options
+    {
+        QString capture;
+        int frames = 1000;
+        QString trace;
+        QString image;
+    };
+
+    const int WARMUP_FRAMES = 10;
+    const int MAX_WARMUP_FRAMES = 1000;
+    const int REPORT_INTERVAL = 100;
+
+    void usage()
+    {
+        std::fprintf(stderr, "usage: meshviewer-replay <capture.mkfc> [--frames N] [--trace file.json]"
+                             " [--save frame.png]\n");
+    }
+
+    bool parseArguments(const QStringList &arguments, Options &options)
+    {
+        for (int i = 1; i < arguments.size(); i++)
+        {
+            const QString argument = arguments.at(i);
+            const bool hasValue = i + 1 < arguments.size();
+            bool ok = true;
+            if (argument == "--frames" && hasValue)
+                options.frames = arguments.at(++i).toInt(&ok);
+            else if (argument == "--trace" && hasValue)
+                options.trace = arguments.at(++i);
+            else if (argument == "--save" && hasValue)
+                options.image = arguments.at(++i);
+            else if (!argument.startsWith("-") && options.capture.isEmpty())
+                options.capture = argument;
+            else
+                ok = false;
+            if (!ok)
+                return false;
+        }
+        return !options.capture.isEmpty() && options.frames >= 0;
+    }
+
+    void report(int frames, double cpuMilliseconds, double gpuMilliseconds, bool gpuTimes)
+    {
+        const RenderStats::Counters& stats = RenderStats::instance().lastFrame();
+        std::printf("%d frames: CPU %.3f ms", frames, cpuMilliseconds);
+        if (gpuTimes)
+            std::printf(", GPU %.3f ms", gpuMilliseconds);
+        std::printf(" | %llu draws, %llu triangles, %llu program, %llu texture, %llu VAO binds, %llu uniforms\n",
+                    (unsigned long long)stats.drawCalls, (unsigned long long)stats.triangles,
+                    (unsigned long long)stats.programBinds, (unsigned long long)stats.textureBinds,
+                    (unsigned long long)stats.vaoBinds, (unsigned long long)stats.uniformCalls);
+        std::fflush(stdout);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QGuiApplication a(argc, argv);
+
+    Options options;
+    if (!parseArguments(a.arguments(), options)) {
+        usage();
+        return 2;
+    }
+
+    FrameCapture capture;
+    if (!capture.load(options.capture.toStdString())) {
+        std::fprintf(stderr, "meshviewer-replay: %s isn't a frame capture\n", options.capture.toLocal8Bit().constData());
+        return 1;
+    }
+
+    Tracer::instance().setThreadName("GL thread");
+    Tracer::instance().setEnabled(!options.trace.isEmpty());
+
+    QSurfaceFormat format;
+    format.setVersion(3, 3);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    format.setDepthBufferSize(24);
+
+    QOpenGLContext context;
+    context.setFormat(format);
+    QOffscreenSurface surface;
+    surface.setFormat(format);
+    surface.create();
+    if (!context.create() || !context.makeCurrent(&surface)) {
+        std::fprintf(stderr, "meshviewer-replay: can't create an OpenGL 3.3 core context\n");
+        return 1;
+    }
+
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK) {
+        std::fprintf(stderr, "meshviewer-replay: glewInit failed\n");
+        return 1;
+    }
+    //glewInit leaves GL_INVALID_ENUM behind on core profiles
+    glGetError();
+    GLDebug::setEnabled(false);
+    GLDebug::initialize();
+
+    int result = 0;
+    {
+        QOpenGLFramebufferObject framebuffer(capture.width, capture.height, QOpenGLFramebufferObject::Depth);
+        Renderer renderer;
+        renderer.initialize();
+        if (!renderer.replayFrame(capture)) {
+            std::fprintf(stderr, "meshviewer-replay: can't load %s\n", capture.modelPath.c_str());
+            renderer.destroy();
+            return 1;
+        }
+
+        //shader variants compile and streamed textures settle before anything is measured
+        for (int i = 0; i < WARMUP_FRAMES || (renderer.isStreamingTextures() && i < MAX_WARMUP_FRAMES); i++)
+            renderer.render(framebuffer.handle(), capture.width, capture.height, capture.interactive);
+        glFinish();
+
+        //two queries, the previous frame's is read while the current one is queued
+        const bool gpuTimes = GLEW_ARB_timer_query != 0;
+        GLuint queries[2] = { 0, 0 };
+        if (gpuTimes)
+            glGenQueries(2, queries);
+
+        double cpuSum = 0.0, gpuSum = 0.0;
+        int measured = 0, gpuMeasured = 0;
+        for (int frame = 0; options.frames == 0 || frame < options.frames; frame++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            if (gpuTimes)
+                glBeginQuery(GL_TIME_ELAPSED, queries[frame % 2]);
+            renderer.render(framebuffer.handle(), capture.width, capture.height, capture.interactive);
+            if (gpuTimes)
+                glEndQuery(GL_TIME_ELAPSED);
+            cpuSum += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            measured++;
+
+            if (gpuTimes && frame > 0) {
+                GLuint64 nanoseconds = 0;
+                glGetQueryObjectui64v(queries[(frame + 1) % 2], GL_QUERY_RESULT, &nanoseconds);
+                gpuSum += nanoseconds / 1.0e6;
+                gpuMeasured++;
+            }
+
+            if (measured == REPORT_INTERVAL) {
+                report(measured, cpuSum / measured, gpuMeasured ? gpuSum / gpuMeasured : 0.0, gpuTimes);
+                cpuSum = gpuSum = 0.0;
+                measured = gpuMeasured = 0;
+            }
+        }
+        if (measured > 0)
+            report(measured, cpuSum / measured, gpuMeasured ? gpuSum / gpuMeasured : 0.0, gpuTimes);
+        if (gpuTimes)
+            glDeleteQueries(2, queries);
+
+        if (!options.image.isEmpty() && !framebuffer.toImage().save(options.image)) {
+            std::fprintf(stderr, "meshviewer-replay: can't write %s\n", options.image.toLocal8Bit().constData());
+            result = 1;
+        }
+        renderer.destroy();
+    }
+    context.doneCurrent();
+
+    if (!options.trace.isEmpty() && !Tracer::instance().write(options.trace.toStdString())) {
+        std::fprintf(stderr, "meshviewer-replay: can't write %s\n", options.trace.toLocal8Bit().constData());
+        result = 1;
+    }
+    return result;
+}
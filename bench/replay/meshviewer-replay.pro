@@ -0,0 +1,85 @@
+#-------------------------------------------------
+#
+# Replays a frame saved with Debug > Capture Frame offscreen, in a loop, for profiling.
+# Run it from the repository root, where shaders/ is.
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+TARGET = meshviewer-replay
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += \
+    main.cpp \
+    ../../src/shader.cpp \
+    ../../src/shaderprogram.cpp \
+    ../../src/mesh.cpp \
+    ../../src/light.cpp \
+    ../../src/submesh.cpp \
+    ../../src/gameobject.cpp \
+    ../../src/makaidebug.cpp \
+    ../../src/threadpool.cpp \
+    ../../src/lightclusters.cpp \
+    ../../src/gbuffer.cpp \
+    ../../src/shaderpermutations.cpp \
+    ../../src/blockcompression.cpp \
+    ../../src/texturecache.cpp \
+    ../../src/texturestreamer.cpp \
+    ../../src/mipchain.cpp \
+    ../../src/profiler.cpp \
+    ../../src/renderer.cpp \
+    ../../src/tracer.cpp \
+    ../../src/memorytracker.cpp \
+    ../../src/renderstats.cpp \
+    ../../src/framecapture.cpp \
+    ../../src/bvh.cpp \
+    ../../src/picking.cpp \
+    ../../src/scenegraph.cpp
+
+HEADERS += \
+    ../../headers/camera.h \
+    ../../headers/light.h \
+    ../../headers/shaderprogram.h \
+    ../../headers/shader.h \
+    ../../headers/mesh.h \
+    ../../headers/submesh.h \
+    ../../headers/gameobject.h \
+    ../../headers/makaidebug.h \
+    ../../headers/uniform.h \
+    ../../headers/threadpool.h \
+    ../../headers/lightclusters.h \
+    ../../headers/gbuffer.h \
+    ../../headers/shaderpermutations.h \
+    ../../headers/blockcompression.h \
+    ../../headers/texturecache.h \
+    ../../headers/texturestreamer.h \
+    ../../headers/mipchain.h \
+    ../../headers/profiler.h \
+    ../../headers/renderer.h \
+    ../../headers/tracer.h \
+    ../../headers/memorytracker.h \
+    ../../headers/renderstats.h \
+    ../../headers/framecapture.h \
+    ../../headers/bvh.h \
+    ../../headers/picking.h \
+    ../../headers/scenegraph.h
+
+INCLUDEPATH += $$PWD/../../headers
+
+win32 {
+    LIBS += -L$$PWD/../../lib/x86 -lassimp \
+        -lopengl32 \
+        -lGlu32 \
+        -L$$PWD/../../lib/x86 -lglew32 \
+        -lglew32s \
+        -lSOIL
+}
+
+unix {
+    LIBS += -lassimp -lGLEW -lGL -lSOIL
+}
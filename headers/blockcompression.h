@@ -0,0 +1,48 @@
+#ifndef BLOCKCOMPRESSION_H
+#define BLOCKCOMPRESSION_H
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace makai
+{
+    // CPU encoders for the BCn block formats, which store 4x4 texels per block.
+    // The endpoints are the bounding box of the block inset a little, which is fast
+    // and close enough for import-time encoding; see TextureCache for where the results go.
+    class BlockCompression
+    {
+    public:
+        enum Format {
+            //RGB, 4 bits per texel
+            BC1,
+            //RGBA, 8 bits per texel
+            BC3,
+            //two independent channels, for the XY of normal maps, 8 bits per texel
+            BC5
+        };
+
+        static GLenum glInternalFormat(Format format);
+        // bytes of one 4x4 block
+        static size_t blockBytes(Format format);
+        // bytes of a width x height level, partial blocks at the edges count whole
+        static size_t compressedSize(Format format, int width, int height);
+
+        // Encodes a tightly packed RGBA8 image. BC1 reads RGB, BC3 RGBA and BC5 RG.
+        // Rows of blocks are spread over ThreadPool::instance().
+        static std::vector<unsigned char> encode(Format format, const unsigned char *rgba, int width, int height);
+
+        // An RGBA8 image scaled to any size with bilinear filtering, for images that must match the size of others.
+        static std::vector<unsigned char> resize(const unsigned char *rgba, int width, int height,
+                                                 int newWidth, int newHeight);
+
+    private:
+        // block is 16 RGBA8 texels in row order
+        static void encodeBC1(const unsigned char *block, unsigned char *out);
+        // one channel of the block as a BC4 block, the alpha half of BC3 and each half of BC5
+        static void encodeBC4(const unsigned char *block, int channel, unsigned char *out);
+    };
+}
+
+#endif // BLOCKCOMPRESSION_H
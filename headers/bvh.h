@@ -0,0 +1,104 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace makai
+{
+    // An axis-aligned box; empty until something is added.
+    struct Aabb
+    {
+        glm::vec3 min;
+        glm::vec3 max;
+
+        Aabb();
+        Aabb(const glm::vec3 &min, const glm::vec3 &max);
+
+        bool isEmpty() const { return min.x > max.x; }
+        void grow(const glm::vec3 &point);
+        void grow(const Aabb &box);
+        glm::vec3 center() const { return (min + max) * 0.5f; }
+        // 0 for empty boxes
+        float surfaceArea() const;
+        // the box around this one moved by the matrix
+        Aabb transformed(const glm::mat4 &matrix) const;
+    };
+
+    // A bounding volume hierarchy over boxes, the primitives: triangles of a sub-mesh, or objects of the scene.
+    // Built top down with binned SAH, the surface area heuristic evaluated at BIN_COUNT planes per axis.
+    // Large nodes bin their primitives on the thread pool and the subtrees below them are built in parallel.
+    // Nodes are one flat array; siblings are next to each other, so one cache line holds both children.
+    class Bvh
+    {
+    public:
+        static const int BIN_COUNT = 16;
+        // leaves hold at most this many primitives, and fewer where SAH says splitting doesn't pay
+        static const uint32_t MAX_LEAF_SIZE = 8;
+
+        // 32 bytes
+        struct Node
+        {
+            glm::vec3 boundsMin;
+            // inner nodes: the index of the left child, the right one follows; leaves: the first primitive
+            uint32_t leftOrFirst;
+            glm::vec3 boundsMax;
+            // primitives in a leaf, 0 for inner nodes
+            uint32_t count;
+
+            bool isLeaf() const { return count > 0; }
+        };
+
+        struct Statistics
+        {
+            size_t primitives = 0;
+            size_t nodes = 0;
+            size_t leaves = 0;
+            int maxDepth = 0;
+            double averageLeafSize = 0.0;
+            // expected cost of a random ray, traversal steps plus primitive tests, relative to the root area;
+            // lower is better, compare it between builds of the same primitives
+            double sahCost = 0.0;
+            double buildMilliseconds = 0.0;
+            double refitMilliseconds = 0.0;
+        };
+
+        // Builds over the boxes of the primitives, indexed as in the vector.
+        void build(const std::vector<Aabb> &bounds);
+        // Builds over the triangles of an indexed mesh, positions the first three floats of each vertex.
+        void buildTriangles(const std::vector<float> &vertices, unsigned step, const std::vector<unsigned> &indices);
+
+        // Keeps the tree, updates the boxes of the leaves holding the changed primitives and of their ancestors.
+        // bounds has every primitive's box, as for build(). The quality drops as primitives move apart from
+        // the ones they share nodes with; statistics().sahCost afterwards is that of the refitted tree.
+        void refit(const std::vector<Aabb> &bounds, const std::vector<uint32_t> &changed);
+
+        void clear();
+        bool isEmpty() const { return m_nodes.empty(); }
+
+        const std::vector<Node>& nodes() const { return m_nodes; }
+        // primitive indices, leaves refer to ranges of these
+        const std::vector<uint32_t>& primitives() const { return m_primitives; }
+        Aabb bounds() const;
+        Statistics statistics() const { return m_statistics; }
+        // what the nodes and the index arrays take
+        size_t byteSize() const;
+
+    private:
+        std::vector<Node> m_nodes;
+        std::vector<uint32_t> m_primitives;
+        // for refit(): every node's parent, and the leaf of every primitive
+        std::vector<uint32_t> m_parents;
+        std::vector<uint32_t> m_primitiveLeaves;
+        Statistics m_statistics;
+
+        struct Builder;
+        // the parent and leaf maps and the statistics of a new tree
+        void finishBuild(double milliseconds);
+        double computeSahCost() const;
+    };
+}
+
+#endif // BVH_H
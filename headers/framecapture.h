@@ -0,0 +1,101 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace makai
+{
+    // The state one frame was drawn from: the modes, the viewport, the camera, the lights, where every
+    // object was, and the model as a file reference or as the geometry itself. Renderer::captureFrame()
+    // fills it and Renderer::replayFrame() puts it back, so a frame can be drawn again and again away
+    // from the viewer, see bench/replay. Saved as a small binary file.
+    struct FrameCapture
+    {
+        static const uint32_t VERSION = 2;
+
+        // How the model travels with the capture.
+        enum Geometry {
+            // the path of the model file, replaying needs the file where it was
+            REFERENCE,
+            // the vertices, indices and texture file names, the model file isn't needed
+            EMBED,
+            // embedded, but each part's vertices snapped to a 16^3 grid over its bounds, normals pointing
+            // out of its center and texture coordinates and files dropped: the draw calls, vertex counts
+            // and rough screen coverage stay, the design doesn't
+            ANONYMIZE
+        };
+
+        struct Camera {
+            glm::vec3 position;
+            glm::vec3 up;
+            float yaw;
+            float pitch;
+            float fieldOfView;
+        };
+
+        struct Light {
+            int type;
+            glm::vec4 position;
+            glm::vec4 direction;
+            glm::vec3 intensity;
+            float attenuation;
+            float range;
+        };
+
+        // the renderer's objects in order, the model first, then the built-in cubes
+        struct Object {
+            glm::vec3 position;
+            glm::vec3 scale;
+            glm::quat rotation;
+        };
+
+        struct SubMesh {
+            uint32_t step;
+            // from the sub-mesh's space to model space, its scene graph node's world transform
+            glm::mat4 transform;
+            std::vector<float> vertices;
+            std::vector<uint32_t> indices;
+            std::vector<uint32_t> texIndices;
+        };
+
+        struct Texture {
+            int type;
+            std::string fileName;
+        };
+
+        // Renderer modes, as their enum values
+        int displayMode = 0;
+        int shadingMode = 0;
+        int textureMode = 0;
+        bool flat = false;
+        bool depthPrepass = false;
+        bool interactive = false;
+        int width = 1;
+        int height = 1;
+
+        Camera camera;
+        std::vector<Light> lights;
+        std::vector<Object> objects;
+
+        Geometry geometry = REFERENCE;
+        // REFERENCE: the model file, empty if none was loaded; otherwise the model's name
+        std::string modelPath;
+        // EMBED and ANONYMIZE only
+        std::vector<SubMesh> subMeshes;
+        std::vector<Texture> textures;
+
+        // replaces the geometry with its anonymized version, see ANONYMIZE
+        void anonymize();
+
+        // False if the file can't be written or read, or isn't a capture of this version.
+        bool save(const std::string &fileName) const;
+        bool load(const std::string &fileName);
+    };
+}
+
+#endif // FRAMECAPTURE_H
@@ -0,0 +1,90 @@
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include <QWidget>
+#include <QTimer>
+#include <QElapsedTimer>
+
+namespace makai
+{
+    // Decides when the viewport repaints.
+    // By default frames are only drawn when something visible changed: the widget reports
+    // camera, scene and mode changes and the scheduler turns them into coalesced update() calls.
+    // A continuous policy redraws at a capped frame rate instead.
+    class FrameScheduler
+    {
+    public:
+        enum Policy {
+            ONDEMAND,
+            CONTINUOUS
+        };
+
+        struct Statistics {
+            // frames per second and process CPU usage since the previous call of statistics()
+            double fps;
+            double cpuPercent;
+            // no frame was drawn in that interval
+            bool idle;
+            unsigned long long totalFrames;
+        };
+
+        explicit FrameScheduler(QWidget *target);
+
+        Policy policy() const;
+        void setPolicy(Policy policy);
+
+        // frame rate cap of the continuous policy
+        int targetFps() const;
+        void setTargetFps(int fps);
+
+        // When on, frames drawn during an interaction are marked interactive so the widget
+        // can render them cheaper, and a full quality frame follows once input stops for refineDelay ms.
+        bool refineWhenIdle() const;
+        void setRefineWhenIdle(bool refine);
+        int refineDelay() const;
+        void setRefineDelay(int ms);
+
+        // Something visible changed, schedule one more frame.
+        void requestRedraw();
+
+        // Like requestRedraw(), for changes driven by user input such as camera movement.
+        void interact();
+
+        // Keep redrawing while a load is in flight. Calls nest.
+        void beginLoad();
+        void endLoad();
+
+        // True while rendering a frame that belongs to an ongoing interaction.
+        bool isInteractiveFrame() const;
+
+        // Called by the widget at the end of paintGL().
+        void frameRendered();
+
+        Statistics statistics();
+
+        FrameScheduler(const FrameScheduler &other) = delete;
+        const FrameScheduler& operator=(const FrameScheduler &other) = delete;
+    private:
+        QWidget *m_target;
+        Policy m_policy;
+        int m_targetFps;
+        bool m_refineWhenIdle;
+        bool m_interacting;
+        int m_loadsInFlight;
+
+        QTimer m_frameTimer;
+        QTimer m_refineTimer;
+
+        unsigned long long m_totalFrames;
+        unsigned long long m_sampleFrames;
+        QElapsedTimer m_sampleClock;
+        double m_sampleCpuSeconds;
+
+        void onRefineTimeout();
+
+        // CPU time consumed by this process so far, user plus kernel
+        static double processCpuSeconds();
+    };
+}
+
+#endif // FRAMESCHEDULER_H
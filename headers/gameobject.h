@@ -22,14 +22,25 @@ namespace makai
 
         void setRotation(const glm::vec3 &rotation);
         void setRotation(float x, float y, float z);
+        glm::quat rotation() const;
+        void setRotation(const glm::quat &rotation);
 
+        Mesh *mesh() const;
         void setMesh(Mesh *mesh);
 
         void setShaderProgram(ShaderProgram *shaderProgram);
 
-        void paint(const std::vector<Light> &lights);
+        //lights are uploaded once per frame by the caller
+        void paint();
+        //positions only with the given program, for the depth pre-pass
+        void paintDepth(ShaderProgram *depthProgram);
         ShaderProgram *shaderProgram();
 
+        //model matrix from position, scalar and rotation
+        glm::mat4 modelMatrix() const;
+        //counts changes of the transform and the mesh, for caches of the world bounds
+        uint64_t revision() const { return m_revision; }
+
         //World Space
         //angle : degree
         void rotate(float angle, glm::vec3 axis);
@@ -42,6 +53,7 @@ namespace makai
         glm::vec3 m_position;
         glm::vec3 m_scalar;
         glm::quat m_rotation;
+        uint64_t m_revision;
     };
 }
 
@@ -0,0 +1,47 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include <GL/glew.h>
+
+namespace makai
+{
+    // Render targets of the deferred shading mode.
+    // Albedo with a single specular intensity in RGBA8 and an octahedral normal in RG16;
+    // the lighting pass reconstructs positions from the depth texture, so a pixel costs 8 bytes plus depth.
+    class GBuffer
+    {
+    public:
+        enum Target {
+            ALBEDO_SPECULAR,
+            NORMAL,
+            DEPTH,
+            TARGET_COUNT
+        };
+
+        GBuffer();
+        ~GBuffer();
+
+        //(re)creates the targets for the given size, needs a current context
+        bool resize(int width, int height);
+        void destroy();
+
+        int width() const;
+        int height() const;
+        GLuint texture(Target target) const;
+
+        //binds the framebuffer for the geometry pass
+        void bindForWriting() const;
+        //binds the targets to the texture units firstUnit + Target
+        void bindTextures(GLuint firstUnit) const;
+
+        GBuffer(const GBuffer &other) = delete;
+        const GBuffer& operator=(const GBuffer &other) = delete;
+    private:
+        GLuint m_framebuffer;
+        GLuint m_textures[TARGET_COUNT];
+        int m_width;
+        int m_height;
+    };
+}
+
+#endif // GBUFFER_H
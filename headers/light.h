@@ -18,15 +18,27 @@ public:
     void setType(const LightType &type);
     glm::vec4 direction() const;
     void setDirection(float x, float y, float z);
+    void setDirection(const glm::vec4 &direction);
     glm::vec4 position() const;
     void setPosition(float x, float y, float z);
+    //w = 0 makes the light directional for the renderer
+    void setPosition(const glm::vec4 &position);
     glm::vec3 intensity() const;
     void setColor(float r, float g, float b);
+    //quadratic falloff, 1 / (1 + attenuation * d^2)
+    float attenuation() const;
+    void setAttenuation(float attenuation);
+    //distance at which a point light has faded out completely,
+    //LightClusters only assigns the light to clusters within this radius
+    float range() const;
+    void setRange(float range);
 
 private:
     glm::vec4 m_direction;
     glm::vec4 m_position;
     glm::vec3 m_intensity;
+    float m_attenuation;
+    float m_range;
     LightType m_type;
 
     float clamp(float input, float min, float max);
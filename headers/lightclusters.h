@@ -0,0 +1,98 @@
+#ifndef LIGHTCLUSTERS_H
+#define LIGHTCLUSTERS_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "light.h"
+#include "shaderprogram.h"
+
+namespace makai
+{
+    // Clustered forward lighting.
+    // The view frustum is cut into TILES_X * TILES_Y screen tiles and SLICES exponential depth slices.
+    // update() bins the point lights into the clusters their range touches, upload() sends the
+    // per-cluster light lists to buffer textures, and the shaders then only evaluate the lights
+    // of the cluster they are in instead of every light in the scene.
+    class LightClusters
+    {
+    public:
+        static const unsigned TILES_X = 16;
+        static const unsigned TILES_Y = 9;
+        static const unsigned SLICES = 24;
+        static const unsigned CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+        //lights beyond this in a single cluster are dropped
+        static const unsigned MAX_LIGHTS_PER_CLUSTER = 256;
+
+        LightClusters();
+        ~LightClusters();
+
+        //creates the buffers, needs a current context
+        void initialize();
+        void destroy();
+
+        //bins the point lights (position.w != 0) for a camera with the given view matrix and
+        //perspective projection, fieldOfView in degrees
+        void update(const std::vector<Light> &lights, const glm::mat4 &view,
+                    float fieldOfView, float aspect, float zNear, float zFar);
+        //uploads the result of the last update()
+        void upload();
+
+        //binds the light data, cluster grid and light index buffer textures to
+        //firstUnit, firstUnit + 1 and firstUnit + 2 and sets the cluster uniforms of a bound program
+        void bind(ShaderProgram *program, GLuint firstUnit) const;
+
+        unsigned pointLightCount() const;
+        //light indices in all clusters together, after the last update()
+        unsigned assignedLightCount() const;
+        //time the last update() took on the CPU
+        double binningMilliseconds() const;
+
+        LightClusters(const LightClusters &other) = delete;
+        const LightClusters& operator=(const LightClusters &other) = delete;
+    private:
+        struct ClusterBounds
+        {
+            glm::vec3 min;
+            glm::vec3 max;
+        };
+
+        //view space bounds of every cluster, rebuilt when the projection changes
+        std::vector<ClusterBounds> m_bounds;
+        float m_fieldOfView;
+        float m_aspect;
+        float m_near;
+        float m_far;
+
+        //point lights in view space, as separate arrays for the 4-wide tests
+        std::vector<float> m_lightX;
+        std::vector<float> m_lightY;
+        std::vector<float> m_lightZ;
+        std::vector<float> m_lightRadius;
+        //candidate lights (indices into the arrays above) of every depth slice
+        std::vector<std::vector<unsigned>> m_sliceLights;
+
+        //what the shaders fetch: two vec4 per light (world position, range) and (intensity, attenuation)
+        std::vector<GLfloat> m_lightData;
+        //scratch lists filled in parallel, MAX_LIGHTS_PER_CLUSTER entries per cluster
+        std::vector<GLuint> m_clusterLights;
+        std::vector<GLuint> m_clusterCounts;
+        //(offset, count) into m_lightIndices per cluster
+        std::vector<GLuint> m_grid;
+        std::vector<GLuint> m_lightIndices;
+
+        enum { LIGHT_DATA, GRID, LIGHT_INDICES, BUFFER_COUNT };
+        GLuint m_buffers[BUFFER_COUNT];
+        GLuint m_textures[BUFFER_COUNT];
+
+        double m_binningMilliseconds;
+
+        void buildBounds();
+        unsigned sliceOf(float depth) const;
+        void binSlice(unsigned slice);
+    };
+}
+
+#endif // LIGHTCLUSTERS_H
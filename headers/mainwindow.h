@@ -4,6 +4,7 @@
 #include <QMainWindow>
 #include "openglwidget.h"
 #include <QActionGroup>
+#include <QTimer>
 
 namespace Ui {
 class MainWindow;
@@ -24,9 +25,20 @@ private:
     QActionGroup* shadingModeAG;
     QActionGroup* flatShadingModeAG;
     QActionGroup* textModeAG;
+    QActionGroup* redrawPolicyAG;
+    QActionGroup* pointLightsAG;
+
+    //refreshes the status bar readout once a second
+    QTimer* statusTimer;
 
     void createActionGroups();
     void connections();
+    void updateStatusBar();
+    void runShadingBenchmark();
+    //starts recording a trace, or stops and asks where to save it
+    void onRecordTraceToggled(bool checked);
+    //saves the state of the last frame, asking how to include the model
+    void captureFrame();
 
 };
 
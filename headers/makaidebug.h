@@ -4,15 +4,93 @@
 #include <GL/glew.h>
 #include <QDebug>
 
+#include <string>
+
 namespace makai
 {
     void CheckOpenGLError(const char* stmt, const char* fname, int line);
+
+    // GL validation built on KHR_debug.
+    // Errors are reported by the driver through a message callback instead of polling glGetError,
+    // so validation doesn't serialize the pipeline. It can be switched on and off at runtime;
+    // when off, debug output is disabled in the driver and every hook here is a single flag test.
+    class GLDebug
+    {
+    public:
+        // Checks for KHR_debug and installs the message callback.
+        // Must be called once with the context current, after glewInit().
+        static void initialize();
+
+        static bool isSupported() { return s_supported; }
+        static bool isEnabled() { return s_enabled; }
+        static void setEnabled(bool enabled);
+
+        // Synchronous output reports a message from inside the offending call, so a breakpoint in the
+        // callback shows the call site, at the price of serializing the driver again. Off by default.
+        static bool isSynchronous() { return s_synchronous; }
+        static void setSynchronous(bool synchronous);
+
+        // Messages less severe than this are dropped by the driver.
+        // One of GL_DEBUG_SEVERITY_HIGH, _MEDIUM, _LOW or _NOTIFICATION. Default is LOW.
+        static GLenum minimumSeverity() { return s_minimumSeverity; }
+        static void setMinimumSeverity(GLenum severity);
+
+        // Debug groups mark render passes in the message log and in frame debuggers.
+        // They are off by default, even while validation is on.
+        static bool debugGroupsEnabled() { return s_enabled && s_debugGroups && s_supported; }
+        static void setDebugGroupsEnabled(bool enabled);
+        static void pushGroup(const char* name);
+        static void popGroup();
+
+        // Names a GL object (GL_VERTEX_ARRAY, GL_BUFFER, GL_TEXTURE, GL_PROGRAM, GL_SHADER...).
+        // Only objects created while validation is enabled get a label.
+        static void setObjectLabel(GLenum identifier, GLuint name, const std::string& label);
+
+        // True when validation is on but the context lacks KHR_debug,
+        // in which case GL_CHECK falls back to glGetError.
+        static bool needsErrorPolling() { return s_enabled && !s_supported; }
+
+    private:
+        static bool s_supported;
+        static bool s_enabled;
+        static bool s_synchronous;
+        static bool s_debugGroups;
+        static GLenum s_minimumSeverity;
+
+        static void applySeverityFilter();
+    };
+
+    // Pushes a debug group for the lifetime of the object, if debug groups are enabled.
+    class GLDebugGroup
+    {
+    public:
+        explicit GLDebugGroup(const char* name) : m_pushed(GLDebug::debugGroupsEnabled())
+        {
+            if (m_pushed) GLDebug::pushGroup(name);
+        }
+        ~GLDebugGroup()
+        {
+            if (m_pushed) GLDebug::popGroup();
+        }
+
+        GLDebugGroup(const GLDebugGroup &other) = delete;
+        const GLDebugGroup& operator=(const GLDebugGroup &other) = delete;
+    private:
+        bool m_pushed;
+    };
 }
 
+#define _MAKAI_CONCAT_IMPL(a, b) a ## b
+#define _MAKAI_CONCAT(a, b) _MAKAI_CONCAT_IMPL(a, b)
+
+// Opens a debug group that lasts until the end of the enclosing scope.
+#define GL_DEBUG_GROUP(name) makai::GLDebugGroup _MAKAI_CONCAT(_makaiDebugGroup, __LINE__)(name)
+
 #ifdef _DEBUG
     #define GL_CHECK(stmt) do { \
             stmt; \
-            makai::CheckOpenGLError(#stmt, __FILE__, __LINE__); \
+            if (makai::GLDebug::needsErrorPolling()) \
+                makai::CheckOpenGLError(#stmt, __FILE__, __LINE__); \
         } while (0)
 #else
     #define GL_CHECK(stmt) stmt
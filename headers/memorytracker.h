@@ -0,0 +1,66 @@
+#ifndef MEMORYTRACKER_H
+#define MEMORYTRACKER_H
+
+#include <atomic>
+#include <cstddef>
+
+namespace makai
+{
+    // Bytes held by loaded models, on the CPU and estimated on the GPU, per kind of resource,
+    // with the highest totals seen so workstations can be sized for the largest assemblies.
+    // The code that creates and frees a resource reports it; Mesh, SubMesh and TextureStreamer do.
+    // Safe to call from any thread.
+    class MemoryTracker
+    {
+    public:
+        enum Resource {
+            //CPU: the vertex, index and texture index arrays of sub-meshes
+            GEOMETRY,
+            //CPU: texture levels read and encoded on their way to the GPU, streamed levels in flight
+            TEXTURE_STAGING,
+            //GPU: VBOs, interleaved and position-only
+            VERTEX_BUFFERS,
+            //GPU: EBOs
+            INDEX_BUFFERS,
+            //GPU: texture arrays, resident levels only
+            TEXTURES,
+            RESOURCE_COUNT
+        };
+
+        struct Totals {
+            size_t bytes[RESOURCE_COUNT];
+            size_t cpu;
+            size_t gpu;
+            // the largest cpu and gpu have been since the start or resetPeaks()
+            size_t peakCpu;
+            size_t peakGpu;
+        };
+
+        static MemoryTracker& instance();
+
+        static bool isGpu(Resource resource);
+        static const char* name(Resource resource);
+
+        void allocate(Resource resource, size_t bytes);
+        void release(Resource resource, size_t bytes);
+        // allocates or releases the difference
+        void resize(Resource resource, size_t oldBytes, size_t newBytes);
+
+        Totals totals() const;
+        // starts the high-water marks again from the current totals
+        void resetPeaks();
+
+        MemoryTracker(const MemoryTracker &other) = delete;
+        const MemoryTracker& operator=(const MemoryTracker &other) = delete;
+    private:
+        MemoryTracker();
+
+        std::atomic<size_t> m_bytes[RESOURCE_COUNT];
+        std::atomic<size_t> m_cpu;
+        std::atomic<size_t> m_gpu;
+        std::atomic<size_t> m_peakCpu;
+        std::atomic<size_t> m_peakGpu;
+    };
+}
+
+#endif // MEMORYTRACKER_H
@@ -15,19 +15,27 @@
 #include "shaderprogram.h"
 #include "light.h"
 #include "submesh.h"
+#include "bvh.h"
+#include "scenegraph.h"
 #include "makaidebug.h"
 
 namespace makai
 {
+    class TextureStreamer;
+
     enum TextureType
     {
         diffuse = 0,
-        specular = 1
+        specular = 1,
+        normal = 2
     };
+    static const unsigned TEXTURE_TYPE_COUNT = 3;
 
     struct Texture
     {
+        // the GL_TEXTURE_2D_ARRAY genBuffers() put the texture in, and its layer there; -1 if it didn't load
         GLuint objectId;
+        GLint layer;
         TextureType type;
         std::string fileName;
     };
@@ -41,15 +49,79 @@ namespace makai
         // Loads a model with supported ASSIMP extensions from file
         // and stores the resulting meshes in the meshes vector.
         bool loadModelFromFile(const std::string &path);
+        // The same for a scene already in memory, texture paths are relative to directory.
+        // Touches no GL state, genBuffers() uploads the result.
+        bool loadModelFromScene(const aiScene *scene, const std::string &directory);
 
-        void addSubMesh(const SubMesh &subMesh);
-        void addTexture(const Texture& texture);
+        // used to label the GL objects of this mesh, set to the file path by loadModelFromFile()
+        std::string name() const;
+        void setName(const std::string &name);
 
-        //call for rendering
-        void paint(ShaderProgram* shader, const std::vector<Light> &lights);
+        // node is the sceneGraph() node that draws the sub-mesh, -1 for none: it is drawn untransformed
+        void addSubMesh(const SubMesh &subMesh, int node = -1);
+        void addTexture(const Texture& texture);
+        const std::vector<SubMesh>& subMeshes() const;
+        const std::vector<Texture>& textures() const;
+
+        // The node hierarchy of the model file, sub-meshes being in the space of their node.
+        // Moving a node through setLocalTransform() moves its sub-meshes and those of its subtree.
+        SceneGraph& sceneGraph();
+        const SceneGraph& sceneGraph() const;
+        // from the space of a sub-mesh to model space, the world transform of its node
+        glm::mat4 subMeshTransform(size_t subMesh) const;
+
+        // How genBuffers() groups textures into arrays. Only textures of the same format and size can share one:
+        // EXACT_SIZE gives each size its own array, RESIZE scales the textures of a format
+        // to the size most of them have, so a model usually needs one array per format.
+        enum TextureArrayPolicy {
+            EXACT_SIZE,
+            RESIZE
+        };
+        static void setTextureArrayPolicy(TextureArrayPolicy policy);
+        static TextureArrayPolicy textureArrayPolicy();
+
+        //call for rendering, model places the whole mesh; each node's sub-meshes get model times the node's transform
+        //each texture type has its own unit, and an array stays bound while the next sub-meshes use it too
+        void paint(ShaderProgram* shader, const glm::mat4 &model);
+
+        //draw positions only, for the depth pre-pass
+        void paintDepth(ShaderProgram* shader, const glm::mat4 &model);
 
         //generate VAO, VBO, TBOs and upload data
-        void genBuffers();
+        //with a streamer, cached texture arrays start at their small levels and the streamer loads the rest
+        void genBuffers(TextureStreamer *streamer = nullptr);
+
+        // What the mesh holds now, see MemoryTracker for the totals of all meshes.
+        // Streamed texture arrays count their resident levels.
+        struct MemoryUsage {
+            //CPU
+            size_t geometry;
+            //GPU
+            size_t vertexBuffers;
+            size_t indexBuffers;
+            size_t textures;
+        };
+        MemoryUsage memoryUsage() const;
+
+        // a sphere around all vertices in model space as the nodes were placed at genBuffers()
+        glm::vec3 boundingCenter() const;
+        float boundingRadius() const;
+        // the box around all vertices in model space, with the nodes where they are now; valid after genBuffers()
+        Aabb bounds() const;
+
+        // the triangles of each sub-mesh, one per subMeshes() as indexed in its indices / 3; built by genBuffers()
+        const std::vector<Bvh>& bvhs() const;
+        // the sub-mesh BVHs together: the sums, the deepest and, for sahCost, the triangle weighted mean
+        Bvh::Statistics bvhStatistics() const;
+        // Builds bvhs(), the sub-meshes in parallel, and logs the totals. genBuffers() calls it,
+        // tools that pick without uploading can call it alone.
+        void buildBvhs();
+        // changes whenever bounds() may have: the BVHs were built again or a scene graph node moved
+        uint64_t boundsRevision() const;
+
+        // Asks the streamer for the mip levels the texture arrays need when the mesh covers
+        // pixelDiameter pixels on screen, assuming the textures wrap the mesh about once.
+        void requestTextureDetail(TextureStreamer &streamer, float pixelDiameter) const;
 
         //delete VAO, VBO, TBOs
         void deleteBuffers();
@@ -57,27 +129,53 @@ namespace makai
         //delete VAO, VBO, TBOs and clean all mesh data
         void clear();
 
-        static GLuint textureFromFile(const std::string &fileName);
-
         Mesh(const Mesh& other) = delete;
         const Mesh &operator=(const Mesh &other) const = delete;
     private:
         /*  Model Data  */
+        std::string m_name;
         std::vector<SubMesh> m_meshes;
         /*  the directory containing texture images  */
         std::string directoryOfTex;
         // Stores all the textures loaded so far,
         // optimization to make sure textures aren't loaded more than once.
         std::vector<Texture> m_textures;
+        // the texture arrays holding m_textures
+        struct TextureArray
+        {
+            GLuint texture;
+            int width;
+            int height;
+            // bytes in VRAM, 0 for streamed arrays, which the streamer accounts for
+            size_t bytes;
+        };
+        std::vector<TextureArray> m_textureArrays;
+        // the streamer genBuffers() registered the arrays with, nullptr if none
+        TextureStreamer* m_streamer;
+        glm::vec3 m_boundingCenter;
+        float m_boundingRadius;
+        // one per m_meshes, in the space of the sub-mesh
+        std::vector<Bvh> m_bvhs;
+        SceneGraph m_sceneGraph;
+        // the node of each of m_meshes, -1 for none
+        std::vector<int> m_subMeshNodes;
+        Bvh::Statistics m_bvhStatistics;
+        uint64_t m_bvhRevision = 0;
+        static TextureArrayPolicy s_textureArrayPolicy;
         // map from assing texture type to my Texture type
         std::map<int, int> typeMap;
 
-        void genVertexBuffers(SubMesh &mesh);
+        void genVertexBuffers(SubMesh &mesh, const std::string &label);
+        // Loads m_textures through TextureCache and uploads them as layers of texture arrays,
+        // then logs the load time and VRAM against uncompressed textures.
+        void genTextures();
+        void computeBounds();
 
 
         // Processes a node in a recursive fashion.
-        // Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-        void processNode(const aiNode *node, const aiScene* scene);
+        // Adds the node under parent to the scene graph, processes each individual mesh located at the node
+        // and repeats this process on its children nodes (if any).
+        void processNode(const aiNode *node, const aiScene* scene, int parent);
         SubMesh processMesh(const aiMesh* mesh, const aiScene* scene);
 
         // Checks all material textures of a given type and loads the textures if they're not loaded yet.
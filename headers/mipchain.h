@@ -0,0 +1,29 @@
+#ifndef MIPCHAIN_H
+#define MIPCHAIN_H
+
+#include <vector>
+
+namespace makai
+{
+    // Builds mip chains on the CPU, so every driver shows the same levels and the GL thread
+    // never filters. Each level is made from the one before with a separable Kaiser-windowed sinc
+    // filter, which keeps more detail than a box and aliases less. The filter works on linear values
+    // with SSE, one RGBA texel per register, and wraps at the edges like the GL_REPEAT samplers.
+    class MipChain
+    {
+    public:
+        enum Content {
+            //sRGB color in RGB, filtered in linear light; linear alpha
+            COLOR,
+            //tangent space normals in RGB, renormalized at every level; linear alpha
+            NORMAL
+        };
+
+        // Every level of a tightly packed RGBA8 image down to 1x1, level 0 first and unchanged.
+        // Rows are spread over ThreadPool::instance().
+        static std::vector<std::vector<unsigned char>> build(Content content, const unsigned char *rgba,
+                                                             int width, int height);
+    };
+}
+
+#endif // MIPCHAIN_H
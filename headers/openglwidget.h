@@ -6,47 +6,59 @@
 
 #include <QOpenGLWidget>
 #include <QAction>
-#include <QMatrix4x4>
 #include <QKeyEvent>
 #include <QMouseEvent>
 #include <QFileDialog>
 #include <QDir>
 #include <QOpenGLContext>
 #include <QTime>
+#include <QElapsedTimer>
+#include <QLabel>
 
-#include "mesh.h"
-#include "shaderprogram.h"
-#include "camera.h"
-#include "light.h"
-#include "gameobject.h"
+#include "renderer.h"
+#include "framescheduler.h"
+#include "shaderreloader.h"
 
 using namespace makai;
 
 class OpenGLWidget : public QOpenGLWidget
 {
+    Q_OBJECT
+
 public:
     OpenGLWidget(QWidget *parent = 0);
     ~OpenGLWidget();
 
-    //modes
-    enum DISPLAYMODE {
-        FILL,
-        FILLLINES,
-        WIREFRAME
-    } displayMode = FILL;
+    bool isCaptureAllEvent = false;
 
-    enum SHADINGMODE {
-        PHONG,
-        GOURAUD
-    } shadingMode = GOURAUD;
+    //KHR_debug validation, see makaidebug.h
+#ifdef _DEBUG
+    bool glValidation = true;
+#else
+    bool glValidation = false;
+#endif
+    bool glDebugGroups = false;
+    //exact call sites for validation messages, serializes the driver
+    bool glSynchronousDebugOutput = false;
 
-    enum TEXTUREMODE {
-        TEXTURE,
-        COLOR
-    } textureMode = COLOR;
+    //the scene, the modes and the passes, see renderer.h
+    Renderer& frameRenderer();
+    FrameScheduler& frameScheduler();
+
+    //replaces the point lights but the first with count - 1 small lights at fixed random places
+    void scatterLights(unsigned count);
+
+    //GPU time per frame of PHONG against DEFERRED at 1, 10, 100 and 1000 lights,
+    //averaged over the given number of frames, as a table
+    QString benchmarkShading(unsigned frames = 30);
+
+    //the result of the last left click, nothing hit until the first
+    const Picking::Hit& lastPick() const;
+
+signals:
+    //a left click without a drag picked what is under the cursor, see Renderer::pick()
+    void objectPicked(const makai::Picking::Hit &hit);
 
-    bool flat_flag = true;
-    bool isCaptureAllEvent = false;
 protected:
     //Qt OpenGL functions
     void initializeGL();
@@ -58,6 +70,8 @@ protected:
     bool isFirstMouseClick = true;
     int lastX = 0, lastY = 0;
     int mouseButton;
+    //where the left button went down, a release near it is a click and picks
+    int pressX = 0, pressY = 0;
 
     //input events
     void keyPressEvent(QKeyEvent* event);
@@ -74,48 +88,23 @@ private:
     const GLfloat rot1Sensitivity = 0.5f;
     const GLfloat scaSensitivity = 0.05f;
     GLfloat scaler = 1.0f;
-    GLfloat transX = 0.0f;
-    GLfloat transY = 0.0f;
     GLfloat rotationAroundY = 0.0f;
 
-    QMatrix4x4 matrixProjection;
-    QMatrix4x4 matrixModel;
-    Camera camera;
-
-    ShaderProgram* phongShader;
-    ShaderProgram* gourandShader;
-    ShaderProgram* curShader;
-
-    QVector3D lightAmbient = QVector3D(0.3f, 0.3f, 0.3f);
-    std::vector<Light> lights;
-
-    void uploadMatrices();
-
-    void setBuiltInObject();
-    std::vector<Mesh*> builtInMeshes;
-    std::vector<GameObject *> builtInObjects;
-
-    const char* lightVertShaderSource =
-            "#version 330 core\n"
-            "layout (location = 0) in vec3 aPos;\n"
-            "uniform mat4 model;\n"
-            "uniform mat4 view;\n"
-            "uniform mat4 projection;\n"
-            "void main() {\n"
-            "    gl_Position = projection * view * model * vec4(aPos, 1.0);\n"
-            "}\n";
-
-    const char* lightFraShaderSource =
-        "#version 330 core\n"
-        "out vec4 FragColor;\n"
-        "void main()\n"
-        "{\n"
-        "    FragColor = vec4(1.0);\n"
-        "}\n";
-    ShaderProgram* lightProgram;
-    unsigned lightVAO = 0;
-    void initLightVAO(const std::vector<float> &v);
-    void paintLights();
+    //repaints only when something changed, see framescheduler.h
+    FrameScheduler scheduler;
+
+    Renderer renderer;
+    //rebuilds the renderer's shader sets when their files change, see shaderreloader.h
+    ShaderReloader shaderReloader;
+
+    //the renderer has texture reads in flight, which counts as a load for the scheduler
+    bool texturesStreaming = false;
+
+    //RenderStats of the last frame over the top left of the view, a widget so painting it leaves GL alone
+    QLabel* statsOverlay = nullptr;
+    void updateStatsOverlay();
+
+    Picking::Hit m_lastPick;
 
 public slots:
     void openfile();
@@ -123,6 +112,14 @@ public slots:
     void onShadingModeChanged(QAction *mode);
     void onFlatShadingModeChanged(QAction *mode);
     void onTextureModeChanged(QAction *mode);
+    void onGLValidationToggled(bool checked);
+    void onDebugGroupsToggled(bool checked);
+    void onSynchronousDebugOutputToggled(bool checked);
+    void onRedrawPolicyChanged(QAction *policy);
+    void onRefineWhenIdleToggled(bool checked);
+    void onDepthPrepassToggled(bool checked);
+    void onRenderStatsToggled(bool checked);
+    void onPointLightsChanged(QAction *count);
 };
 
 #endif // OPENGLWIDGET_H
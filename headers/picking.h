@@ -0,0 +1,60 @@
+#ifndef PICKING_H
+#define PICKING_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "bvh.h"
+
+namespace makai
+{
+    class GameObject;
+    class Mesh;
+
+    // Rays against the scene: the top level BVH finds the objects a ray may hit, their sub-mesh BVHs the
+    // triangles, and those are tested four at a time with Möller-Trumbore, SSE where the compiler has it.
+    // Only the nodes along the ray are visited, so a click on millions of triangles takes microseconds.
+    class Picking
+    {
+    public:
+        struct Ray {
+            glm::vec3 origin;
+            // unit length in world space
+            glm::vec3 direction;
+        };
+
+        // The nearest triangle a ray hit.
+        struct Hit {
+            // nullptr if the ray hit nothing
+            GameObject* object = nullptr;
+            int objectIndex = -1;
+            int subMesh = -1;
+            // the corners are the sub-mesh's indices[3 * triangle] and the two after it
+            int triangle = -1;
+            // weights of the second and third corner, the first has 1 - x - y
+            glm::vec2 barycentrics = glm::vec2(0.0f);
+            // along the ray, and the point there in world space
+            float distance = 0.0f;
+            glm::vec3 position = glm::vec3(0.0f);
+            double milliseconds = 0.0;
+
+            bool isHit() const { return object != nullptr; }
+        };
+
+        // The ray from the near plane through the center of pixel (x, y) of a width x height viewport,
+        // y going down as in window coordinates.
+        static Ray rayThroughPixel(const glm::mat4 &view, const glm::mat4 &projection,
+                                   float x, float y, int width, int height);
+
+        // The nearest hit among the objects, sceneBvh holding objects[i] as primitive i.
+        static Hit pick(const Bvh &sceneBvh, const std::vector<GameObject*> &objects, const Ray &ray);
+
+        // The nearest hit with the mesh closer than distance, the ray in model space and not necessarily
+        // unit length; each sub-mesh is tested where its scene graph node puts it. Fills distance,
+        // in units of the ray direction, and the hit's fields of the mesh.
+        static bool intersect(const Mesh &mesh, const Ray &ray, float &distance, Hit &hit);
+    };
+}
+
+#endif // PICKING_H
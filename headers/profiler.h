@@ -0,0 +1,143 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <vector>
+
+#include "makaidebug.h"
+
+// Zones are compiled in debug builds, or in any build that defines MAKAI_ENABLE_PROFILER.
+// Frame totals are always measured, they cost two timestamp queries a frame.
+#if defined(_DEBUG) || defined(MAKAI_ENABLE_PROFILER)
+    #define MAKAI_PROFILER
+#endif
+
+namespace makai
+{
+    // Where the frame time goes, on the CPU and on the GPU.
+    // The widget brackets every frame with beginFrame() and endFrame(); zones inside a frame
+    // measure CPU time with a steady clock and, for GPU zones, GPU time with GL_TIMESTAMP queries,
+    // which nest where GL_TIME_ELAPSED queries don't. Queries are double-buffered: a frame's results
+    // are read when its slot comes around again two frames later, and dropped rather than waited for
+    // if the GPU isn't done by then. All calls belong on the GL thread.
+    class Profiler
+    {
+    public:
+        // averages over the last FRAME_HISTORY frames, in milliseconds
+        struct Statistics {
+            // from the start of one frame to the start of the next, idle gaps left out
+            double frame;
+            // between beginFrame() and endFrame() on the GL thread
+            double cpu;
+            // between the same points on the GPU, 0 without timer queries
+            double gpu;
+        };
+
+        struct Zone {
+            const char* name;
+            // zones open around this one
+            int depth;
+            double cpuMilliseconds;
+            // -1 for CPU zones and without timer queries
+            double gpuMilliseconds;
+        };
+
+        static const int FRAME_HISTORY = 60;
+
+        static Profiler& instance();
+
+        // Creates the queries; needs the context current. Without ARB_timer_query only CPU times are measured.
+        void initialize();
+        // Deletes the queries, before the context goes away.
+        void destroy();
+        bool hasGpuTimes() const;
+
+        void beginFrame();
+        void endFrame();
+
+        // Zones nest and are closed in reverse order, see ProfileZone. The returned index closes the zone.
+        // Outside a frame they are ignored.
+        int beginZone(const char *name, bool gpu);
+        void endZone(int zone);
+
+        Statistics statistics() const;
+        // the zones of the last frame whose results came back, in the order they began,
+        // smoothed against the frames before while the zones stay the same
+        std::vector<Zone> zones() const;
+
+        Profiler(const Profiler &other) = delete;
+        const Profiler& operator=(const Profiler &other) = delete;
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        struct ZoneRecord {
+            const char* name;
+            int depth;
+            Clock::time_point begin;
+            Clock::time_point end;
+            // 0 for CPU zones
+            GLuint beginQuery;
+            GLuint endQuery;
+        };
+
+        // one frame in flight
+        struct FrameSlot {
+            bool recorded = false;
+            double cpuMilliseconds = 0.0;
+            GLuint beginQuery = 0;
+            GLuint endQuery = 0;
+            std::vector<ZoneRecord> zones;
+            // queries of this slot, reused every time it comes around
+            std::vector<GLuint> queries;
+            size_t usedQueries = 0;
+        };
+
+        Profiler();
+
+        bool m_timerQueries;
+        bool m_inFrame;
+        int m_openZones;
+        unsigned long long m_frameIndex;
+        FrameSlot m_slots[2];
+        Clock::time_point m_frameStart;
+        Clock::time_point m_lastFrameStart;
+
+        double m_frameHistory[FRAME_HISTORY];
+        double m_cpuHistory[FRAME_HISTORY];
+        double m_gpuHistory[FRAME_HISTORY];
+        int m_frameSamples;
+        int m_resolvedSamples;
+        std::vector<Zone> m_zones;
+
+        FrameSlot& currentSlot();
+        GLuint timestamp(FrameSlot &slot);
+        // reads the results of the frame last recorded in the slot, if the GPU has them
+        void resolve(FrameSlot &slot);
+    };
+
+    // A profiler zone for the lifetime of the object.
+    class ProfileZone
+    {
+    public:
+        explicit ProfileZone(const char *name, bool gpu = false) : m_zone(Profiler::instance().beginZone(name, gpu)) {}
+        ~ProfileZone() { Profiler::instance().endZone(m_zone); }
+
+        ProfileZone(const ProfileZone &other) = delete;
+        const ProfileZone& operator=(const ProfileZone &other) = delete;
+    private:
+        int m_zone;
+    };
+}
+
+// Time the rest of the enclosing scope on the CPU, or on the CPU and the GPU.
+#ifdef MAKAI_PROFILER
+    #define PROFILE_ZONE(name) makai::ProfileZone _MAKAI_CONCAT(_makaiProfileZone, __LINE__)(name)
+    #define PROFILE_GPU_ZONE(name) makai::ProfileZone _MAKAI_CONCAT(_makaiProfileZone, __LINE__)(name, true)
+#else
+    #define PROFILE_ZONE(name) do {} while (0)
+    #define PROFILE_GPU_ZONE(name) do {} while (0)
+#endif
+
+#endif // PROFILER_H
@@ -0,0 +1,221 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+#include "mesh.h"
+#include "shaderprogram.h"
+#include "camera.h"
+#include "light.h"
+#include "gameobject.h"
+#include "lightclusters.h"
+#include "gbuffer.h"
+#include "shaderpermutations.h"
+#include "texturecache.h"
+#include "texturestreamer.h"
+#include "profiler.h"
+#include "framecapture.h"
+#include "bvh.h"
+#include "picking.h"
+
+namespace makai
+{
+    // The scene and the passes that draw it, without a window.
+    // OpenGLWidget drives it from paintGL() into its framebuffer; the benchmark runner drives it
+    // into an offscreen FBO. Every call that touches GL needs the context current.
+    class Renderer
+    {
+    public:
+        Renderer();
+
+        //modes
+        enum DISPLAYMODE {
+            FILL,
+            FILLLINES,
+            WIREFRAME
+        } displayMode = FILL;
+
+        enum SHADINGMODE {
+            PHONG,
+            GOURAUD,
+            DEFERRED
+        } shadingMode = GOURAUD;
+
+        enum TEXTUREMODE {
+            TEXTURE,
+            COLOR
+        } textureMode = COLOR;
+
+        bool flat_flag = true;
+
+        //lay down depth first, then shade with GL_EQUAL so every pixel is lit once
+        bool depthPrepass = false;
+
+        //a white cube at every light
+        bool lightMarkers = true;
+
+        Camera camera;
+
+        const GLfloat zNear = 0.1f;
+        const GLfloat zFar = 100.0f;
+
+        // Sets up the shaders and the built-in scene, once glewInit() has run.
+        void initialize();
+        // Deletes everything initialize() and loadModel() created, before the context goes away.
+        void destroy();
+
+        struct LoadTimes {
+            // reading and processing the file with assimp
+            double importMilliseconds;
+            // buffers and textures until the GPU has them
+            double uploadMilliseconds;
+        };
+        // Replaces the model shown with the one in the file. False if assimp can't read it.
+        bool loadModel(const std::string &path, LoadTimes *times = nullptr);
+        // the model loadModel() fills, and the objects drawn
+        Mesh& model();
+        const Mesh& model() const;
+        const std::vector<GameObject*>& objects() const;
+        // objects() by their world bounds, as of the last render(); primitive i is objects()[i]
+        const Bvh& sceneBvh() const;
+        // The nearest triangle under pixel (x, y) of the last render(), y going down, see Picking.
+        // Objects moved since that frame are where they are now.
+        Picking::Hit pick(int x, int y);
+
+        // Draws a frame into the framebuffer. Interactive frames may trade quality for speed,
+        // see FrameScheduler::isInteractiveFrame().
+        void render(GLuint framebuffer, int width, int height, bool interactive = false);
+
+        const std::vector<Light>& lights() const;
+        void setLights(const std::vector<Light> &lights);
+        //replaces the point lights but the first with count - 1 small lights at fixed random places
+        void scatterLights(unsigned count);
+
+        //fragments that passed the depth test in the shading pass of the last measured frame
+        GLuint shadedFragments() const;
+        const LightClusters& lightClusters() const;
+        const TextureStreamer& textureStreamer() const;
+        //the last render() left reads in flight, frames should keep coming until it doesn't
+        bool isStreamingTextures() const;
+
+        // The state the last render() drew from, to save and draw again elsewhere, see FrameCapture.
+        FrameCapture captureFrame(FrameCapture::Geometry geometry) const;
+        // Puts the captured state back: modes, camera, lights, object placement and the model, which is
+        // loaded from its file or built from the embedded geometry. render() at the captured size then
+        // draws the frame again. False if the model can't be loaded.
+        bool replayFrame(const FrameCapture &capture);
+
+        //the shader sets, for ShaderReloader
+        std::vector<ShaderPermutations*> shaderPermutations();
+
+        Renderer(const Renderer &other) = delete;
+        const Renderer& operator=(const Renderer &other) = delete;
+    private:
+        //render() between the RenderStats frame brackets
+        void renderFrame(GLuint framebuffer, int width, int height, bool interactive);
+
+        int m_width = 1;
+        int m_height = 1;
+        bool m_interactive = false;
+        glm::mat4 m_projection;
+
+        //flat, texture, fill-lines and light count variants, picked per frame by shaderFeatures()
+        ShaderPermutations phongVariants;
+        ShaderPermutations gourandVariants;
+        ShaderPermutations gbufferVariants;
+        ShaderPermutations depthVariants;
+        ShaderPermutations deferredVariants;
+        ShaderProgram* curShader;
+
+        //DEFERRED: shader.vert with gbuffer.frag fills the g-buffer, deferred.frag lights it
+        GBuffer gbuffer;
+        //the lighting pass draws one triangle from gl_VertexID, but core profile still wants a VAO
+        GLuint screenVAO = 0;
+        void paintDeferredLighting(GLuint framebuffer);
+
+        glm::vec3 lightAmbient = glm::vec3(0.3f, 0.3f, 0.3f);
+        std::vector<Light> m_lights;
+        //point lights per froxel, the shaders read them from buffer textures on these units
+        LightClusters clusters;
+        const GLuint clusterTextureUnit = 4;
+
+        //fine mip levels of the mesh textures, loaded while they are big on screen
+        TextureStreamer streamer;
+        bool texturesStreaming = false;
+        //asks for the texture levels each object needs at its projected size, then updates the streamer
+        void streamTextures();
+
+        void updateMatrices();
+        void uploadMatrices();
+        void uploadLights(ShaderProgram *program);
+        unsigned directionalLightCount() const;
+        //ShaderPermutations feature bits for the current modes
+        uint32_t shaderFeatures() const;
+
+        //false if the depth program doesn't compile, then the shading pass runs without GL_EQUAL
+        bool paintDepthPrepass();
+
+        //GL_SAMPLES_PASSED queries around the shading pass, two so reading one never waits for the GPU
+        GLuint samplesQueries[2] = {0, 0};
+        unsigned samplesQueryFrame = 0;
+        GLuint lastShadedFragments = 0;
+
+        void setBuiltInObject();
+        std::vector<Mesh*> builtInMeshes;
+        std::vector<GameObject *> builtInObjects;
+
+        //the top level over the objects, the sub-mesh BVHs of their meshes are the bottom level
+        Bvh objectBvh;
+        std::vector<Aabb> objectBounds;
+        //what objectBounds were computed from, an object whose revisions moved on is refitted
+        struct ObjectRevision {
+            uint64_t object;
+            const Mesh* mesh;
+            uint64_t meshBounds;
+            bool operator!=(const ObjectRevision &other) const
+            {
+                return object != other.object || mesh != other.mesh || meshBounds != other.meshBounds;
+            }
+        };
+        std::vector<ObjectRevision> objectRevisions;
+        //kept between frames so the per frame check allocates nothing
+        std::vector<uint32_t> changedObjects;
+        //SAH cost right after the last full build, refits that degrade it past REBUILD_COST rebuild instead
+        double objectBvhBuildCost = 0.0;
+        const double REBUILD_COST = 1.5;
+        //rebuilds when objects come or go, refits the ones whose transform, mesh or node transforms changed otherwise
+        void updateSceneBvh();
+
+        const char* lightVertShaderSource =
+                "#version 330 core\n"
+                "layout (location = 0) in vec3 aPos;\n"
+                "layout (location = 1) in vec4 lightPositionScale;\n"
+                "uniform mat4 view;\n"
+                "uniform mat4 projection;\n"
+                "void main() {\n"
+                "    vec3 worldPos = aPos * lightPositionScale.w + lightPositionScale.xyz;\n"
+                "    gl_Position = projection * view * vec4(worldPos, 1.0);\n"
+                "}\n";
+
+        const char* lightFraShaderSource =
+            "#version 330 core\n"
+            "out vec4 FragColor;\n"
+            "void main()\n"
+            "{\n"
+            "    FragColor = vec4(1.0);\n"
+            "}\n";
+        ShaderProgram* lightProgram;
+        unsigned lightVAO = 0;
+        //a cube per light, drawn instanced: (position, scale) of each light, refilled every frame
+        unsigned lightInstanceVBO = 0;
+        std::vector<glm::vec4> lightInstances;
+        void initLightVAO(const std::vector<float> &v);
+        void paintLights();
+    };
+}
+
+#endif // RENDERER_H
@@ -0,0 +1,71 @@
+#ifndef RENDERSTATS_H
+#define RENDERSTATS_H
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+namespace makai
+{
+    // What a frame asked of the driver: draws, the primitives they carry and the state changes between them.
+    // The code issuing the calls counts them, Mesh, GameObject, Renderer and ShaderProgram do, so the numbers
+    // show what batching and culling save. Counting is a few increments, always on. GL thread only.
+    class RenderStats
+    {
+    public:
+        struct Counters {
+            uint64_t drawCalls = 0;
+            uint64_t triangles = 0;
+            uint64_t vertices = 0;
+            uint64_t programBinds = 0;
+            uint64_t textureBinds = 0;
+            uint64_t vaoBinds = 0;
+            uint64_t uniformCalls = 0;
+        };
+
+        static RenderStats& instance();
+
+        // Renderer::render() brackets every frame with these
+        void beginFrame();
+        void endFrame();
+
+        // vertices drawn as mode, triangles are counted for the triangle modes only
+        void countDraw(GLenum mode, uint64_t vertices)
+        {
+            m_current.drawCalls++;
+            m_current.vertices += vertices;
+            if (mode == GL_TRIANGLES)
+                m_current.triangles += vertices / 3;
+            else if ((mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN) && vertices >= 3)
+                m_current.triangles += vertices - 2;
+        }
+        void countProgramBind() { m_current.programBinds++; }
+        void countTextureBind() { m_current.textureBinds++; }
+        void countVaoBind() { m_current.vaoBinds++; }
+        void countUniformCall() { m_current.uniformCalls++; }
+
+        // the frame being drawn, and the last one finished
+        const Counters& current() const { return m_current; }
+        const Counters& lastFrame() const { return m_lastFrame; }
+        // frames finished since the start
+        uint64_t frameCount() const { return m_frameCount; }
+
+        // Writes the counters of every frame finished from now on to the file, one JSON object per line,
+        // replacing what it held; empty stops logging. False if the file can't be opened.
+        bool setLogFile(const std::string &fileName);
+
+        RenderStats(const RenderStats &other) = delete;
+        const RenderStats& operator=(const RenderStats &other) = delete;
+    private:
+        RenderStats();
+
+        Counters m_current;
+        Counters m_lastFrame;
+        uint64_t m_frameCount;
+        std::ofstream m_log;
+    };
+}
+
+#endif // RENDERSTATS_H
@@ -0,0 +1,61 @@
+#ifndef SCENEGRAPH_H
+#define SCENEGRAPH_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace makai
+{
+    // The node hierarchy of a model as assimp describes it: every node's transform relative to its
+    // parent and the sub-meshes it draws. Nodes are stored depth first in flat arrays, a parent before
+    // its children and every subtree contiguous, so a pass in index order sees parents first.
+    // World transforms are computed when asked for and cached; changing a node's local transform
+    // only marks its subtree dirty, and only dirty nodes are computed again.
+    class SceneGraph
+    {
+    public:
+        // Appends a node under parent, -1 for a root. Nodes must be added depth first:
+        // parent is the last node added or one of its ancestors.
+        int addNode(const std::string &name, int parent, const glm::mat4 &local);
+        // the node draws the sub-meshes [first, first + count) of its Mesh
+        void setSubMeshes(int node, uint32_t first, uint32_t count);
+
+        size_t nodeCount() const { return m_parents.size(); }
+        const std::string& name(int node) const { return m_names[node]; }
+        int parent(int node) const { return m_parents[node]; }
+        // one past the last node of node's subtree
+        int subtreeEnd(int node) const { return m_subtreeEnds[node]; }
+        uint32_t firstSubMesh(int node) const { return m_firstSubMeshes[node]; }
+        uint32_t subMeshCount(int node) const { return m_subMeshCounts[node]; }
+        // the first node called name, -1 if none
+        int find(const std::string &name) const;
+
+        const glm::mat4& localTransform(int node) const { return m_locals[node]; }
+        void setLocalTransform(int node, const glm::mat4 &local);
+        // the product of the local transforms from the root down to node
+        const glm::mat4& worldTransform(int node) const;
+        // brings every dirty node up to date in one pass, cheaper than asking node by node after big changes
+        void updateWorldTransforms() const;
+        // counts setLocalTransform() calls, for caches of what depends on the world transforms
+        uint64_t revision() const { return m_revision; }
+
+        void clear();
+
+    private:
+        std::vector<std::string> m_names;
+        std::vector<int> m_parents;
+        std::vector<int> m_subtreeEnds;
+        std::vector<uint32_t> m_firstSubMeshes;
+        std::vector<uint32_t> m_subMeshCounts;
+        std::vector<glm::mat4> m_locals;
+        // caches; a dirty node's descendants are all dirty too, so a clean node has clean ancestors
+        mutable std::vector<glm::mat4> m_worlds;
+        mutable std::vector<uint8_t> m_dirty;
+        uint64_t m_revision = 0;
+    };
+}
+
+#endif // SCENEGRAPH_H
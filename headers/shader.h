@@ -4,6 +4,8 @@
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <vector>
+#include <chrono>
 #include "GL/glew.h"
 
 namespace makai
@@ -14,18 +16,44 @@ namespace makai
         enum ShaderType
         {
             Vertex = 0,
-            Fragment = 1
+            Fragment = 1,
+            Geometry = 2
         };
 
         Shader(Shader::ShaderType type);
         ~Shader();
-        bool compileSourceCode(const std::string &source);
-        bool compileSourceFile(const std::string &fileName);
+        // defines are inserted after the #version line, "NAME" or "NAME VALUE" each
+        bool compileSourceCode(const std::string &source,
+                               const std::vector<std::string> &defines = std::vector<std::string>());
+        bool compileSourceFile(const std::string &fileName,
+                               const std::vector<std::string> &defines = std::vector<std::string>());
+
+        // compileSourceCode() in two halves, so the driver can compile while the caller goes on.
+        // begin*() submit the source; finishCompile() waits for the result if it isn't there yet.
+        bool beginCompile(const std::string &source,
+                          const std::vector<std::string> &defines = std::vector<std::string>());
+        bool beginCompileFile(const std::string &fileName,
+                              const std::vector<std::string> &defines = std::vector<std::string>());
+        // Asks without blocking where ARB_parallel_shader_compile is available; always true elsewhere.
+        bool isCompileComplete();
+        bool finishCompile();
+        // from beginCompile() until the driver was seen to be done
+        double compileMilliseconds() const;
+
         bool isCompiled() const;
         std::string log() const;
         GLuint shaderId() const;
         Shader::ShaderType shaderType() const;
         std::string sourceCode() const;
+        // empty for shaders compiled from source code
+        std::string fileName() const;
+
+        static std::string insertDefines(const std::string &source, const std::vector<std::string> &defines);
+        // Reads a whole shader file, errors are appended to log.
+        // A line #include "file" is replaced by that file, relative to the including one; GLSL has no
+        // includes of its own. Each file is pulled in once, its path added to includedFiles if given.
+        static bool readSourceFile(const std::string &fileName, std::string &source, std::string &log,
+                                   std::vector<std::string> *includedFiles = nullptr);
 
         Shader(const Shader &other) = delete;
         const Shader& operator=(const Shader &other) = delete;
@@ -35,7 +63,16 @@ namespace makai
         std::string m_log;
         GLuint m_id;
         std::string m_code;
+        std::string m_fileName;
+
+        std::chrono::steady_clock::time_point m_compileStart;
+        double m_compileMilliseconds;
+        bool m_compileDone;
 
+        void stampCompileDone();
+        static bool readFile(const std::string &fileName, std::string &source, std::string &log);
+        static bool expandIncludes(const std::string &fileName, std::string &source, std::string &log,
+                                   std::vector<std::string> &included);
     };
 }
 
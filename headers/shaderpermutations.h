@@ -0,0 +1,89 @@
+#ifndef SHADERPERMUTATIONS_H
+#define SHADERPERMUTATIONS_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "shader.h"
+#include "shaderprogram.h"
+
+namespace makai
+{
+    // Compile-time variants of one set of shader files.
+    // Every feature bit becomes a #define in all stages, so the shaders branch with #ifdef
+    // instead of on uniforms, and the compiler strips what a variant doesn't use.
+    // A variant is compiled and linked the first time program() asks for it and then kept by its feature bits.
+    class ShaderPermutations
+    {
+    public:
+        enum Feature {
+            FLAT = 1 << 0,
+            TEXTURED = 1 << 1,
+            WIREFRAME_OVERLAY = 1 << 2,
+            //two bits selecting MAX_LIGHTS from LIGHT_BUCKETS, see lightBucket()
+            LIGHT_BUCKET_SHIFT = 3,
+            LIGHT_BUCKET_MASK = 3 << LIGHT_BUCKET_SHIFT
+        };
+        static const unsigned LIGHT_BUCKET_COUNT = 4;
+        static const unsigned LIGHT_BUCKETS[LIGHT_BUCKET_COUNT];
+
+        // the feature bits of the smallest bucket with room for lightCount lights
+        static uint32_t lightBucket(unsigned lightCount);
+        // the #defines for the given feature bits
+        static std::vector<std::string> defines(uint32_t features);
+
+        // name is only used in logs
+        explicit ShaderPermutations(const std::string &name);
+        ~ShaderPermutations();
+
+        // Adds a stage to the variants that have all of requiredFeatures.
+        void addShaderFile(Shader::ShaderType type, const std::string &fileName, uint32_t requiredFeatures = 0);
+
+        // The program for the given feature bits, built on first use, needs a current context.
+        // Returns nullptr if the variant doesn't compile; the error is logged once.
+        ShaderProgram* program(uint32_t features);
+
+        // Rebuilds every variant asked for so far from the current files, in the background:
+        // the old programs stay in use until pollReload() swaps in their replacements.
+        // Calling it again before that finishes drops the replacements still in flight.
+        // Needs a current context.
+        void reload();
+        // Swaps in the replacements that finished linking; one that failed is logged and the
+        // old program kept. Call once a frame while isReloading(). Returns true if a program changed.
+        bool pollReload();
+        bool isReloading() const;
+
+        // the files of all stages and the files they include
+        std::vector<std::string> files() const;
+
+        // variants built so far
+        size_t size() const;
+        // deletes all variants, needs a current context
+        void clear();
+
+        ShaderPermutations(const ShaderPermutations &other) = delete;
+        const ShaderPermutations& operator=(const ShaderPermutations &other) = delete;
+    private:
+        struct Stage
+        {
+            Shader::ShaderType type;
+            std::string fileName;
+            uint32_t requiredFeatures;
+        };
+
+        std::string m_name;
+        std::vector<Stage> m_stages;
+        //failed variants are kept as nullptr, so they aren't retried every frame
+        std::unordered_map<uint32_t, ShaderProgram*> m_programs;
+        // replacements started by reload(), keyed like m_programs
+        std::unordered_map<uint32_t, ShaderProgram*> m_reloads;
+
+        // an unlinked program with the stages of the given variant
+        ShaderProgram* createVariant(uint32_t features, bool &success) const;
+        std::string variantName(uint32_t features) const;
+    };
+}
+
+#endif // SHADERPERMUTATIONS_H
@@ -9,8 +9,11 @@
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <unordered_map>
+#include <chrono>
 
 #include "shader.h"
+#include "uniform.h"
 
 #include <QDebug>
 
@@ -27,8 +30,13 @@ namespace makai
         // Ownership of the shader object remains with the caller.
         // It will not be deleted when this ShaderProgram instance is deleted.
         // This allows the caller to add the same shader to multiple shader programs.
+        // Programs with shaders added this way are never taken from the binary cache.
         bool addShader(Shader *shader);
-        bool addShaderFromFile(Shader::ShaderType type, const std::string &fileName);
+
+        // Adds shader source to be compiled by link(), unless the linked program is in the binary cache.
+        // addShaderFromFile() only fails if the file can't be read; compile errors are reported by link().
+        bool addShaderFromFile(Shader::ShaderType type, const std::string &fileName,
+                               const std::vector<std::string> &defines = std::vector<std::string>());
         bool addShaderFromSourceCode(Shader::ShaderType type, const char* sourceCode);
 
         //remove the shader added by addShader()
@@ -37,8 +45,33 @@ namespace makai
         // Links together the shaders that were added to this program with addShader().
         // Returns true if the link was successful or false otherwise. If the link failed,
         // the error messages can be retrieved with log().
+        // On success the active uniforms and uniform blocks are read back into a lookup table,
+        // so setters never have to ask the driver for a location.
+        // With a binary cache directory set, the linked program is restored with glProgramBinary
+        // when the sources and the driver match a cached one, and saved there after a fresh link.
         bool link();
 
+        enum LinkStatus { LINK_PENDING, LINK_DONE, LINK_FAILED };
+
+        // link() in two halves, so a program can be built across frames while another one is in use.
+        // beginLink() submits the compiles and the link without asking for their status and returns
+        // false only if that already failed. pollLink() is then called once a frame until it stops
+        // returning LINK_PENDING; with ARB_parallel_shader_compile it never blocks, without it the
+        // driver gets one frame before the status query waits for it.
+        bool beginLink();
+        LinkStatus pollLink();
+
+        // true if the driver compiles and links on its own threads and can be asked whether it's done
+        static bool isParallelCompileSupported();
+
+        // true if the last link() restored the program from the binary cache instead of compiling it
+        bool isFromBinaryCache() const;
+
+        // Where linked program binaries are kept; empty, the default, disables the cache.
+        // The directory must exist.
+        static void setBinaryCacheDirectory(const std::string &directory);
+        static std::string binaryCacheDirectory();
+
         // glUseProgram(this->program);
         void bind();
 
@@ -51,15 +84,24 @@ namespace makai
         // @result The attribute index for the given name, as returned from glGetAttribLocation.
         GLint attrib(const GLchar* attribName) const;
 
-        // @result The uniform index for the given name, as returned from glGetUniformLocation.
-        GLint uniform(const GLchar* uniformName) const;
+        // @result The uniform handle for the given name, looked up in the table built by link().
+        // Names the program doesn't have are reported once and resolve to an invalid handle.
+        Uniform uniform(const UniformName& uniformName) const;
+
+        // True if the program has an active uniform of that name. Unlike uniform(), a miss isn't reported,
+        // for callers that serve several shader variants.
+        bool hasUniform(const UniformName& uniformName) const;
+
+        // @result The uniform block index for the given name, or GL_INVALID_INDEX.
+        GLuint uniformBlock(const UniformName& blockName) const;
 
         /**
          Setters for attribute and uniform variables.
 
          These are convenience methods for the glVertexAttrib* and glUniform* functions.
+         Uniform setters take either a name or a handle returned by uniform().
          */
-#define _MAKAI_PROGRAM_ATTRIB_N_UNIFORM_SETTERS(TYPE) \
+#define _MAKAI_PROGRAM_ATTRIB_SETTERS(TYPE) \
         void setAttrib(const GLchar* attribName, TYPE v0); \
         void setAttrib(const GLchar* attribName, TYPE v0, TYPE v1); \
         void setAttrib(const GLchar* attribName, TYPE v0, TYPE v1, TYPE v2); \
@@ -68,54 +110,57 @@ namespace makai
         void setAttrib1v(const GLchar* attribName, const TYPE* v); \
         void setAttrib2v(const GLchar* attribName, const TYPE* v); \
         void setAttrib3v(const GLchar* attribName, const TYPE* v); \
-        void setAttrib4v(const GLchar* attribName, const TYPE* v); \
-\
-        void setUniform(const GLchar* uniformName, TYPE v0); \
-        void setUniform(const GLchar* uniformName, TYPE v0, TYPE v1); \
-        void setUniform(const GLchar* uniformName, TYPE v0, TYPE v1, TYPE v2); \
-        void setUniform(const GLchar* uniformName, TYPE v0, TYPE v1, TYPE v2, TYPE v3); \
+        void setAttrib4v(const GLchar* attribName, const TYPE* v);
+
+#define _MAKAI_PROGRAM_UNIFORM_SETTERS(KEY, TYPE) \
+        void setUniform(KEY uniform, TYPE v0); \
+        void setUniform(KEY uniform, TYPE v0, TYPE v1); \
+        void setUniform(KEY uniform, TYPE v0, TYPE v1, TYPE v2); \
+        void setUniform(KEY uniform, TYPE v0, TYPE v1, TYPE v2, TYPE v3); \
 \
-        void setUniform1v(const GLchar* uniformName, const TYPE* v, GLsizei count=1); \
-        void setUniform2v(const GLchar* uniformName, const TYPE* v, GLsizei count=1); \
-        void setUniform3v(const GLchar* uniformName, const TYPE* v, GLsizei count=1); \
-        void setUniform4v(const GLchar* uniformName, const TYPE* v, GLsizei count=1);
+        void setUniform1v(KEY uniform, const TYPE* v, GLsizei count=1); \
+        void setUniform2v(KEY uniform, const TYPE* v, GLsizei count=1); \
+        void setUniform3v(KEY uniform, const TYPE* v, GLsizei count=1); \
+        void setUniform4v(KEY uniform, const TYPE* v, GLsizei count=1);
+
+#define _MAKAI_PROGRAM_ATTRIB_N_UNIFORM_SETTERS(TYPE) \
+        _MAKAI_PROGRAM_ATTRIB_SETTERS(TYPE) \
+        _MAKAI_PROGRAM_UNIFORM_SETTERS(const UniformName&, TYPE) \
+        _MAKAI_PROGRAM_UNIFORM_SETTERS(Uniform, TYPE)
 
         _MAKAI_PROGRAM_ATTRIB_N_UNIFORM_SETTERS(GLfloat)
         _MAKAI_PROGRAM_ATTRIB_N_UNIFORM_SETTERS(GLdouble)
         _MAKAI_PROGRAM_ATTRIB_N_UNIFORM_SETTERS(GLint)
         _MAKAI_PROGRAM_ATTRIB_N_UNIFORM_SETTERS(GLuint)
 
-        void setUniformMatrix2(const GLchar* uniformName, const GLfloat* v, GLsizei count=1, GLboolean transpose=GL_FALSE);
-        void setUniformMatrix3(const GLchar* uniformName, const GLfloat* v, GLsizei count=1, GLboolean transpose=GL_FALSE);
-        void setUniformMatrix4(const GLchar* uniformName, const GLfloat* v, GLsizei count=1, GLboolean transpose=GL_FALSE);
-        void setUniform(const GLchar* uniformName, const glm::mat2& m, GLboolean transpose=GL_FALSE);
-        void setUniform(const GLchar* uniformName, const glm::mat3& m, GLboolean transpose=GL_FALSE);
-        void setUniform(const GLchar* uniformName, const glm::mat4& m, GLboolean transpose=GL_FALSE);
-        void setUniform(const GLchar* uniformName, const glm::vec3& v);
-        void setUniform(const GLchar* uniformName, const glm::vec4& v);
+        void setUniformMatrix2(const UniformName& uniformName, const GLfloat* v, GLsizei count=1, GLboolean transpose=GL_FALSE);
+        void setUniformMatrix3(const UniformName& uniformName, const GLfloat* v, GLsizei count=1, GLboolean transpose=GL_FALSE);
+        void setUniformMatrix4(const UniformName& uniformName, const GLfloat* v, GLsizei count=1, GLboolean transpose=GL_FALSE);
+        void setUniform(const UniformName& uniformName, const glm::mat2& m, GLboolean transpose=GL_FALSE);
+        void setUniform(const UniformName& uniformName, const glm::mat3& m, GLboolean transpose=GL_FALSE);
+        void setUniform(const UniformName& uniformName, const glm::mat4& m, GLboolean transpose=GL_FALSE);
+        void setUniform(const UniformName& uniformName, const glm::vec3& v);
+        void setUniform(const UniformName& uniformName, const glm::vec4& v);
+
+        void setUniformMatrix2(Uniform uniform, const GLfloat* v, GLsizei count=1, GLboolean transpose=GL_FALSE);
+        void setUniformMatrix3(Uniform uniform, const GLfloat* v, GLsizei count=1, GLboolean transpose=GL_FALSE);
+        void setUniformMatrix4(Uniform uniform, const GLfloat* v, GLsizei count=1, GLboolean transpose=GL_FALSE);
+        void setUniform(Uniform uniform, const glm::mat2& m, GLboolean transpose=GL_FALSE);
+        void setUniform(Uniform uniform, const glm::mat3& m, GLboolean transpose=GL_FALSE);
+        void setUniform(Uniform uniform, const glm::mat4& m, GLboolean transpose=GL_FALSE);
+        void setUniform(Uniform uniform, const glm::vec3& v);
+        void setUniform(Uniform uniform, const glm::vec4& v);
 
         template <typename T>
         void setArrayUniform(const char* arrayName, size_t index, const T& value, const char* propertyName = nullptr)
         {
-            std::ostringstream ss;
-            if (propertyName != nullptr)
-            {
-                ss << arrayName << "[" << index << "]." << propertyName;
-            }
-            else
-            {
-                ss << arrayName << "[" << index << "]";
-            }
-            std::string uniformName = ss.str();
-            try {
-                this->setUniform(uniformName.c_str(), value);
-            }
-            catch (std::runtime_error e) {
-                qDebug() << e.what();
-            }
-
+            std::string uniformName = arrayUniformName(arrayName, index, propertyName);
+            this->setUniform(uniformName.c_str(), value);
         }
 
+        // "arrayName[index]", or "arrayName[index].propertyName", the name setArrayUniform() sets
+        static std::string arrayUniformName(const char* arrayName, size_t index, const char* propertyName = nullptr);
+
         ShaderProgram(const ShaderProgram &other) = delete;
         const ShaderProgram& operator=(const ShaderProgram &other) = delete;
     private:
@@ -123,8 +168,57 @@ namespace makai
         //shaders added by using addShader()
         std::vector<Shader*> addedShaders;
 
+        // sources given to addShaderFrom*(), compiled by link() on a binary cache miss
+        struct PendingShader
+        {
+            Shader::ShaderType type;
+            std::string fileName;
+            std::string source;
+            std::vector<std::string> defines;
+        };
+        std::vector<PendingShader> m_pendingShaders;
+        bool m_fromBinaryCache;
+        static std::string s_binaryCacheDirectory;
+
+        // state of a link started by beginLink()
+        LinkStatus m_linkStatus;
+        std::string m_cacheFile;
+        std::chrono::steady_clock::time_point m_linkStart;
+        unsigned m_linkPolls;
+
         std::string m_log;
         GLuint m_program;
+        // debug label, the names of the shaders this program was built from
+        std::string m_label;
+
+        // the program made current by bind(), kept so uniform setters can assert on it cheaply
+        static GLuint s_boundProgram;
+
+        // a table entry keeps its name, so a lookup whose hash collides with another name isn't taken for it
+        template <typename T>
+        struct NamedEntry {
+            std::string name;
+            T value;
+        };
+
+        // uniform locations and block indices keyed by name hash, filled in by link().
+        // Misses are cached as -1 so a missing uniform is only looked up and reported once.
+        mutable std::unordered_map<uint32_t, NamedEntry<GLint>> m_uniforms;
+        std::unordered_map<uint32_t, NamedEntry<GLuint>> m_uniformBlocks;
+
+        void appendLabel(const std::string& shaderName);
+        bool beginCompilePendingShaders();
+        // waits for the driver, reports errors and timings, builds the uniform table
+        bool finishLink();
+        void failLink();
+        // cache file for the pending sources on the current driver, empty if caching is off or unsupported
+        std::string binaryCacheFile() const;
+        bool loadBinary(const std::string& cacheFile);
+        void saveBinary(const std::string& cacheFile);
+        void buildUniformTable();
+        // asserts the program is bound, false for invalid handles
+        bool uploads(Uniform u) const;
+        void addUniform(const std::string& name, GLint location);
     };
 }
 
@@ -0,0 +1,54 @@
+#ifndef SHADERRELOADER_H
+#define SHADERRELOADER_H
+
+#include <QFileSystemWatcher>
+#include <QElapsedTimer>
+
+#include <vector>
+
+#include "shaderpermutations.h"
+#include "framescheduler.h"
+
+namespace makai
+{
+    // Hot reload: watches the files of ShaderPermutations sets and rebuilds a set when one of them changes.
+    // The rebuild runs across frames (see ShaderPermutations::reload()), so saving a shader
+    // doesn't stall the viewport and the old programs keep drawing until the new ones link.
+    class ShaderReloader
+    {
+    public:
+        explicit ShaderReloader(FrameScheduler &scheduler);
+
+        // Watches the files of the set, which must outlive the reloader.
+        void watch(ShaderPermutations *permutations);
+
+        // Starts rebuilds for changed files and swaps in programs that finished linking.
+        // Called at the start of paintGL(), with the context current. Returns true if a program changed.
+        bool poll();
+
+        ShaderReloader(const ShaderReloader &other) = delete;
+        const ShaderReloader& operator=(const ShaderReloader &other) = delete;
+    private:
+        struct Entry
+        {
+            ShaderPermutations *permutations;
+            // absolute paths of its files
+            std::vector<QString> files;
+            // changed since the last reload() / reload() still in flight
+            bool dirty;
+            bool reloading;
+        };
+
+        FrameScheduler &m_scheduler;
+        QFileSystemWatcher m_watcher;
+        std::vector<Entry> m_entries;
+        // editors save in several writes, reloads start once the files were quiet for a moment
+        QElapsedTimer m_sinceChange;
+
+        void onFileChanged(const QString &path);
+        // keeps the scheduler drawing while an entry is dirty or reloading
+        void setBusy(Entry &entry, bool dirty, bool reloading);
+    };
+}
+
+#endif // SHADERRELOADER_H
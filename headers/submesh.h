@@ -1,6 +1,7 @@
 #ifndef SUBMESH_H
 #define SUBMESH_H
 
+#include <cstddef>
 #include <vector>
 
 namespace makai
@@ -17,13 +18,24 @@ namespace makai
 
         /*  Render data  */
         unsigned VAO, VBO, EBO;
+        //positions only, tightly packed, for the depth pre-pass. shares EBO
+        unsigned depthVAO, positionVBO;
 
         //VBO step
         unsigned step;
+        //the step of the layout Mesh::processMesh writes and genBuffers() sets the attributes up for:
+        //position, normal, texture coordinates
+        static const unsigned VERTEX_STEP = 8;
 
         std::vector<float> vertices;
         std::vector<unsigned> indices;
         std::vector<unsigned> texIndices;
+
+        //what the arrays above take, for MemoryTracker
+        size_t cpuBytes() const;
+        //what genBuffers() makes of them: the interleaved and the position-only VBO, and the EBO
+        size_t vertexBufferBytes() const;
+        size_t indexBufferBytes() const;
     };
 }
 
@@ -0,0 +1,92 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+
+#include "blockcompression.h"
+
+namespace makai
+{
+    // A texture with its whole mip chain, level 0 first.
+    // Block-compressed, or GL_RGBA8 when TextureCache is disabled.
+    struct TextureData
+    {
+        GLenum internalFormat = 0;
+        GLsizei width = 0;
+        GLsizei height = 0;
+        // every level of the chain, those load() left out are empty
+        std::vector<std::vector<unsigned char>> levels;
+        // the KTX file holding all levels, empty if the texture isn't cached
+        std::string cacheFile;
+
+        // bytes of the levels present, which is what the texture takes in VRAM
+        size_t byteSize() const;
+        // the first level present
+        int baseLevel() const;
+    };
+
+    // Encodes textures to BCn on import and keeps the results as KTX files, so later runs
+    // only read and upload them. A cache file is keyed by the content of the source image,
+    // an edited image is encoded again.
+    class TextureCache
+    {
+    public:
+        enum Usage {
+            //diffuse and specular maps: BC1, or BC3 if the image has alpha
+            COLOR,
+            //tangent space normal maps: BC5, the shader rebuilds Z
+            NORMAL
+        };
+
+        // Where encoded textures are kept; empty, the default, encodes on every load.
+        // The directory must exist.
+        static void setDirectory(const std::string &directory);
+        static std::string directory();
+
+        // Off makes load() decode to uncompressed RGBA8 without touching the cache, to compare against.
+        static void setEnabled(bool enabled);
+        static bool isEnabled();
+        // true if the context can sample the BCn formats, needs a current context
+        static bool isSupported();
+
+        // The encoded texture for the image file, from the cache or encoded now with a full mip chain
+        // from MipChain.
+        // A width and height other than 0 resize the image first, so it can share a texture array.
+        // With maxLevelSize, levels larger than that are left empty when the cache file has them,
+        // for TextureStreamer to read later. Safe to call from several threads at once.
+        // Returns false if the image can't be read.
+        static bool load(const std::string &fileName, Usage usage, TextureData &texture,
+                         int width = 0, int height = 0, int maxLevelSize = 0);
+
+        // A GL_TEXTURE_2D with immutable storage where the context has it, trilinear and repeating.
+        // Needs a current context.
+        static GLuint upload(const TextureData &texture, const std::string &label);
+        // A GL_TEXTURE_2D_ARRAY with one layer per texture, sampled like upload() samples.
+        // The layers must agree in format and size. Levels start at the first one every layer has,
+        // GL_TEXTURE_BASE_LEVEL is set to that. Complete arrays get immutable storage unless streamed,
+        // TextureStreamer has to respecify their levels. Needs a current context.
+        static GLuint uploadArray(const std::vector<const TextureData*> &layers, const std::string &label,
+                                  bool streamed = false);
+
+        // bytes of one level of the given format
+        static size_t levelSize(GLenum internalFormat, int width, int height);
+
+        // KTX 1.1 with one face, no array layers and no key/value data.
+        // readKtx() skips the levels larger than maxLevelSize unless it is 0.
+        static bool readKtx(const std::string &fileName, TextureData &texture, int maxLevelSize = 0);
+        static bool readKtxLevel(const std::string &fileName, int level, std::vector<unsigned char> &data);
+        static bool writeKtx(const std::string &fileName, const TextureData &texture);
+
+    private:
+        static std::string s_directory;
+        static bool s_enabled;
+
+        static bool encode(const std::vector<unsigned char> &fileData, Usage usage, TextureData &texture,
+                           int width, int height);
+    };
+}
+
+#endif // TEXTURECACHE_H
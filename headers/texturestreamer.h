@@ -0,0 +1,95 @@
+#ifndef TEXTURESTREAMER_H
+#define TEXTURESTREAMER_H
+
+#include <GL/glew.h>
+
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace makai
+{
+    // Streams the fine mip levels of block-compressed texture arrays from their KTX cache files.
+    // Arrays start out with their small levels only (see INITIAL_LEVEL_SIZE). Every frame the widget
+    // reports the finest level each array needs, from the screen size of the objects using it;
+    // update() then reads missing levels on the thread pool, one level per array at a time, and drops
+    // levels nobody needs or that don't fit the memory budget. GL_TEXTURE_BASE_LEVEL always points at
+    // the finest resident level, so sampling never touches a level that isn't there.
+    class TextureStreamer
+    {
+    public:
+        // levels up to this many texels on a side are loaded with the mesh
+        static const int INITIAL_LEVEL_SIZE = 64;
+
+        explicit TextureStreamer(size_t budgetBytes = 256 * 1024 * 1024);
+
+        // bytes the streamed arrays may take together; levels are dropped from the largest arrays first
+        size_t budget() const;
+        void setBudget(size_t bytes);
+        // bytes the streamed arrays take now
+        size_t residentBytes() const;
+        // bytes one of them takes, 0 if it isn't streamed
+        size_t residentBytes(GLuint texture) const;
+        size_t arrayCount() const;
+
+        // Streams an array uploaded by TextureCache::uploadArray() with levels from baseLevel on.
+        // layerFiles are the cache files of its layers, in layer order.
+        void add(GLuint texture, GLenum internalFormat, int width, int height, int levelCount, int baseLevel,
+                 const std::vector<std::string> &layerFiles);
+        // stops streaming the array, before it is deleted
+        void remove(GLuint texture);
+
+        // The array is drawn this frame and needs level (fractions round down) to look sharp.
+        void request(GLuint texture, float level);
+
+        // Once a frame after the requests, with the context current: uploads levels that were read,
+        // starts new reads and evicts. Returns true while reads are in flight.
+        bool update();
+
+        TextureStreamer(const TextureStreamer &other) = delete;
+        const TextureStreamer& operator=(const TextureStreamer &other) = delete;
+    private:
+        // one level of all layers, filled in by a pool thread
+        struct LevelRead
+        {
+            int level;
+            std::vector<std::vector<unsigned char>> layers;
+            bool success;
+            // accounted as MemoryTracker::TEXTURE_STAGING until the read is done with
+            size_t bytes;
+        };
+
+        struct StreamedArray
+        {
+            GLuint texture;
+            GLenum internalFormat;
+            int width;
+            int height;
+            int levelCount;
+            // the finest resident level, GL_TEXTURE_BASE_LEVEL
+            int baseLevel;
+            // the finest level asked for since the last update(), levelCount when nobody asked
+            int wantedLevel;
+            // a cache file couldn't be read, the array stays as it is
+            bool failed;
+            std::vector<std::string> layerFiles;
+
+            std::shared_ptr<LevelRead> read;
+            std::future<void> readDone;
+        };
+
+        size_t m_budget;
+        std::vector<StreamedArray> m_arrays;
+
+        // bytes of the levels from level on
+        static size_t bytesFrom(const StreamedArray &array, int level);
+        StreamedArray* find(GLuint texture);
+        void startRead(StreamedArray &array, int level);
+        void uploadRead(StreamedArray &array);
+        void evictBelow(StreamedArray &array, int level);
+        void finishRead(StreamedArray &array);
+    };
+}
+
+#endif // TEXTURESTREAMER_H
@@ -0,0 +1,49 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace makai
+{
+    // A fixed set of worker threads for CPU work that shouldn't run on the GL thread alone.
+    class ThreadPool
+    {
+    public:
+        // threadCount 0 means one worker per hardware thread, minus the calling one
+        explicit ThreadPool(unsigned threadCount = 0);
+        ~ThreadPool();
+
+        // The pool shared by the whole application.
+        static ThreadPool& instance();
+
+        unsigned threadCount() const;
+
+        // Queues a task and returns a future that becomes ready when it has run.
+        std::future<void> submit(std::function<void()> task);
+
+        // Calls body(first, last) on disjoint chunks of [begin, end) of at most grain items
+        // and returns when all chunks are done. The calling thread works on chunks too,
+        // so it is safe to call from inside a task.
+        void parallelFor(size_t begin, size_t end, size_t grain,
+                         const std::function<void(size_t, size_t)> &body);
+
+        ThreadPool(const ThreadPool &other) = delete;
+        const ThreadPool& operator=(const ThreadPool &other) = delete;
+    private:
+        std::vector<std::thread> m_workers;
+        std::deque<std::function<void()>> m_tasks;
+        std::mutex m_mutex;
+        std::condition_variable m_condition;
+        bool m_stopping;
+
+        void workerLoop(unsigned index);
+    };
+}
+
+#endif // THREADPOOL_H
@@ -0,0 +1,113 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "makaidebug.h"
+
+namespace makai
+{
+    // Begin and end events from any thread, saved as Chrome trace JSON for chrome://tracing or Perfetto.
+    // Every thread writes to a buffer of its own without locking; a lock is only taken the first time
+    // a thread records and when the trace is written. Off, an event costs one relaxed atomic load.
+    // Unlike Profiler zones, which time frames on the GL thread, this follows work across threads,
+    // the load pipeline in particular, and is there in release builds.
+    class Tracer
+    {
+    public:
+        // events a thread can hold, the rest are dropped
+        static const size_t CHUNK_EVENTS = 4096;
+        static const size_t MAX_CHUNKS = 256;
+        // longest detail kept, longer ones keep their end
+        static const size_t DETAIL_SIZE = 64;
+
+        static Tracer& instance();
+
+        void setEnabled(bool enabled);
+        bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+        // name must outlive the tracer, a string literal; detail, a file name say, is copied
+        void begin(const char *name, const char *detail = nullptr);
+        void end();
+
+        // shown for the calling thread's events
+        void setThreadName(const std::string &name);
+
+        // Writes everything recorded so far. Threads may keep recording meanwhile,
+        // their events after the call are left out.
+        bool write(const std::string &fileName);
+        // events dropped because a thread's buffer was full
+        size_t droppedEvents() const;
+
+        Tracer(const Tracer &other) = delete;
+        const Tracer& operator=(const Tracer &other) = delete;
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        struct Event {
+            const char* name;
+            // since the tracer was created
+            long long nanoseconds;
+            // 'B' or 'E'
+            char phase;
+            char detail[DETAIL_SIZE];
+        };
+
+        // Written by its thread only. Chunks never move once allocated, and count is published
+        // with release order after the event is complete, so write() can read up to count safely.
+        struct ThreadBuffer {
+            int id;
+            std::string name;
+            Event* chunks[MAX_CHUNKS];
+            std::atomic<size_t> count;
+
+            ThreadBuffer(int id);
+            ~ThreadBuffer();
+        };
+
+        Tracer();
+
+        std::atomic<bool> m_enabled;
+        std::atomic<size_t> m_dropped;
+        Clock::time_point m_start;
+        // guards the list of buffers and their names
+        std::mutex m_mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> m_buffers;
+
+        ThreadBuffer& threadBuffer();
+        void record(char phase, const char *name, const char *detail);
+    };
+
+    // A trace event pair for the lifetime of the object; nothing if tracing was off when it began.
+    class TraceScope
+    {
+    public:
+        explicit TraceScope(const char *name, const char *detail = nullptr) : m_active(Tracer::instance().isEnabled())
+        {
+            if (m_active)
+                Tracer::instance().begin(name, detail);
+        }
+        ~TraceScope()
+        {
+            if (m_active)
+                Tracer::instance().end();
+        }
+
+        TraceScope(const TraceScope &other) = delete;
+        const TraceScope& operator=(const TraceScope &other) = delete;
+    private:
+        bool m_active;
+    };
+}
+
+// Trace the rest of the enclosing scope, optionally with a detail string such as a file name.
+#define TRACE_SCOPE(name) makai::TraceScope _MAKAI_CONCAT(_makaiTraceScope, __LINE__)(name)
+#define TRACE_SCOPE_DETAIL(name, detail) makai::TraceScope _MAKAI_CONCAT(_makaiTraceScope, __LINE__)(name, detail)
+
+#endif // TRACER_H
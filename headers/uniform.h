@@ -0,0 +1,57 @@
+#ifndef UNIFORM_H
+#define UNIFORM_H
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace makai
+{
+    // FNV-1a hash of a uniform name.
+    // It is constexpr so names written as string literals can be hashed at compile time.
+    constexpr uint32_t hashUniformName(const char* name, uint32_t hash = 2166136261u)
+    {
+        return *name == '\0' ? hash
+                             : hashUniformName(name + 1, (hash ^ static_cast<unsigned char>(*name)) * 16777619u);
+    }
+
+    // A uniform name together with its hash, used as the key into ShaderProgram's uniform table.
+    // Plain C strings convert implicitly and are hashed at runtime;
+    // the _u literal ("model"_u) lets the compiler do the hashing instead.
+    class UniformName
+    {
+    public:
+        constexpr UniformName(const char* name) : m_name(name), m_hash(hashUniformName(name)) {}
+        constexpr UniformName(const char* name, uint32_t hash) : m_name(name), m_hash(hash) {}
+
+        constexpr const char* c_str() const { return m_name; }
+        constexpr uint32_t hash() const { return m_hash; }
+
+    private:
+        const char* m_name;
+        uint32_t m_hash;
+    };
+
+    constexpr UniformName operator"" _u(const char* name, std::size_t)
+    {
+        return UniformName(name, hashUniformName(name));
+    }
+
+    // A resolved uniform location, as returned by ShaderProgram::uniform().
+    // Handles of uniforms the program doesn't have are invalid, and setting them does nothing.
+    class Uniform
+    {
+    public:
+        Uniform() : m_location(-1) {}
+        explicit Uniform(GLint location) : m_location(location) {}
+
+        GLint location() const { return m_location; }
+        bool isValid() const { return m_location != -1; }
+
+    private:
+        GLint m_location;
+    };
+}
+
+#endif // UNIFORM_H
@@ -0,0 +1,67 @@
+//fragment shader of the deferred lighting pass
+//lights the g-buffer written by gbuffer.frag with the same model as shader.frag,
+//the point lights of each pixel come from its cluster, so a light only costs where it reaches
+#version 330
+
+in vec2 screenTexCoord;
+
+uniform mat4 view;
+uniform mat4 view_inv;
+uniform mat4 projection;
+//clip space back to world space, for positions from depth
+uniform mat4 viewProjection_inv;
+
+//g-buffer, see gbuffer.h
+uniform sampler2D gbuffer_albedoSpecular;
+uniform sampler2D gbuffer_normal;
+uniform sampler2D gbuffer_depth;
+
+#include "lighting.glsl"
+
+//output
+out vec4 color;
+
+vec3 DecodeNormal(vec2 encoded)
+{
+    encoded = encoded * 2.0 - 1.0;
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main()
+{
+    float depth = texture(gbuffer_depth, screenTexCoord).r;
+    //nothing was drawn here, leave the clear color
+    if (depth == 1.0)
+        discard;
+
+    vec4 clipPos = vec4(vec3(screenTexCoord, depth) * 2.0 - 1.0, 1.0);
+    vec4 worldPos = viewProjection_inv * clipPos;
+    vec3 FragPos = worldPos.xyz / worldPos.w;
+
+    vec4 albedoSpecular = texture(gbuffer_albedoSpecular, screenTexCoord);
+    Material mat;
+    mat.shininess = 32.0f;
+    mat.diffuse = albedoSpecular.rgb;
+    mat.specular = vec3(albedoSpecular.a);
+
+    //diffuse and specular part
+    vec3 norm = DecodeNormal(texture(gbuffer_normal, screenTexCoord).rg);
+    vec3 viewDir = normalize(vec3(view_inv * vec4(0.0, 0.0, 0.0, 1.0)) - FragPos);
+    vec3 lights = vec3(0);
+#if MAX_LIGHTS > 0
+    for (int i = 0; i < numLights; i++) {
+        lights += ApplyLight(allLights[i], mat, norm, FragPos, viewDir);
+    }
+#endif
+    lights += ApplyClusteredLights(mat, norm, FragPos, viewDir);
+
+    //ambient part
+    vec3 result = ambientLight * mat.diffuse + lights;
+
+    //keep the scene depth, so the forward passes after this one are still depth tested
+    gl_FragDepth = depth;
+    color = vec4(result, 1.0f);
+}
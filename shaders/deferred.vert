@@ -0,0 +1,12 @@
+//vertex shader of the deferred lighting pass
+//one triangle covering the screen, generated from gl_VertexID without any vertex buffer
+#version 330
+
+out vec2 screenTexCoord;
+
+void main()
+{
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    screenTexCoord = position;
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
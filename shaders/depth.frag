@@ -0,0 +1,7 @@
+//fragment shader for the depth pre-pass
+//color writes are off, only depth is written
+#version 330
+
+void main()
+{
+}
@@ -0,0 +1,16 @@
+//vertex shader for the depth pre-pass
+//only positions are streamed, from the position-only VAO of each sub-mesh
+#version 330
+layout (location = 0) in vec3 posAttr;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+//must match the shading pass bit for bit, which then tests with GL_EQUAL
+invariant gl_Position;
+
+void main()
+{
+    gl_Position = projection * view * model * vec4(posAttr, 1.0f);
+}
@@ -0,0 +1,90 @@
+//fragment shader of the deferred geometry pass, used with shader.vert
+//writes the surface attributes to the g-buffer, deferred.frag lights them
+#version 330
+
+//flat or smooth shading, a permutation, see shaderpermutations.h
+#ifdef FLAT
+#define INTERPOLATION flat
+#else
+#define INTERPOLATION smooth
+#endif
+in VertexData {
+    INTERPOLATION vec3 Normal;
+    INTERPOLATION vec3 FragPos;
+    vec2 fragTexCoord;
+} fragmentIn;
+
+//texture, arrays shared by the sub-meshes of a model; the layers pick this sub-mesh's maps, -1 for none
+#ifdef TEXTURED
+uniform sampler2DArray texture_diffuse1;
+uniform sampler2DArray texture_specular1;
+uniform int layer_diffuse1;
+uniform int layer_specular1;
+
+vec3 SampleLayer(sampler2DArray textures, int layer, vec2 uv)
+{
+    return layer < 0 ? vec3(0.0) : texture(textures, vec3(uv, float(layer))).rgb;
+}
+#endif
+
+//material
+uniform struct Material {
+    vec3 specular;
+    vec3 diffuse;
+    float shininess;
+} material;
+
+//output, see gbuffer.h
+layout (location = 0) out vec4 albedoSpecular;
+layout (location = 1) out vec2 encodedNormal;
+
+#ifdef WIREFRAME_OVERLAY
+//fill-lines mode, barycentric coordinates come from shader.geom
+noperspective in vec3 barycentric;
+uniform vec3 wire_color = vec3(0.0);
+uniform float wire_width = 1.0;
+
+//how much of the surface shows through near the triangle edges
+float WireframeCoverage()
+{
+    vec3 edgeDistance = smoothstep(vec3(0.0), fwidth(barycentric) * wire_width, barycentric);
+    return min(min(edgeDistance.x, edgeDistance.y), edgeDistance.z);
+}
+#endif
+
+//octahedral normal encoding, two components in [0, 1]
+vec2 OctWrap(vec2 v)
+{
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 EncodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    n.xy = n.z >= 0.0 ? n.xy : OctWrap(n.xy);
+    return n.xy * 0.5 + 0.5;
+}
+
+void main()
+{
+    vec3 Normal = fragmentIn.Normal;
+
+#ifdef TEXTURED
+    vec3 diffuse = SampleLayer(texture_diffuse1, layer_diffuse1, fragmentIn.fragTexCoord);
+    vec3 specular = SampleLayer(texture_specular1, layer_specular1, fragmentIn.fragTexCoord);
+#else
+    vec3 diffuse = material.diffuse;
+    vec3 specular = material.specular;
+#endif
+    //a single specular intensity is all the g-buffer keeps
+    float specularIntensity = dot(specular, vec3(1.0 / 3.0));
+
+#ifdef WIREFRAME_OVERLAY
+    float coverage = WireframeCoverage();
+    diffuse = mix(wire_color, diffuse, coverage);
+    specularIntensity *= coverage;
+#endif
+
+    albedoSpecular = vec4(diffuse, specularIntensity);
+    encodedNormal = EncodeNormal(normalize(Normal));
+}
@@ -1,19 +1,40 @@
 #version 330
 
-uniform bool flat_flag = true;
-flat in vec3 flatColor; // Resulting color from lighting calculations
-smooth in vec3 smoothColor; // Resulting color from lighting calculations
+//flat or smooth shading, a permutation, see shaderpermutations.h
+#ifdef FLAT
+#define INTERPOLATION flat
+#else
+#define INTERPOLATION smooth
+#endif
+in VertexData {
+    INTERPOLATION vec3 color; // Resulting color from lighting calculations
+} fragmentIn;
 
 out vec4 color;
 
+#ifdef WIREFRAME_OVERLAY
+//fill-lines mode, barycentric coordinates come from gourandshader.geom
+noperspective in vec3 barycentric;
+uniform vec3 wire_color = vec3(0.0);
+uniform float wire_width = 1.0;
+
+//blend the wire color over the shaded color near the triangle edges,
+//fwidth keeps the lines wire_width pixels wide at any distance
+vec3 ApplyWireframe(vec3 shadedColor)
+{
+    vec3 edgeDistance = smoothstep(vec3(0.0), fwidth(barycentric) * wire_width, barycentric);
+    float edge = min(min(edgeDistance.x, edgeDistance.y), edgeDistance.z);
+    return mix(wire_color, shadedColor, edge);
+}
+#endif
+
 void main()
 {
-   vec3 tColor;
+   vec3 tColor = fragmentIn.color;
 
-   if (flat_flag)
-        tColor = flatColor;
-   else
-        tColor = smoothColor;
+#ifdef WIREFRAME_OVERLAY
+   tColor = ApplyWireframe(tColor);
+#endif
 
    color = vec4(tColor, 1.0f);
 }
@@ -0,0 +1,105 @@
+//lighting shared by shader.frag, gourandshader.vert and deferred.frag, pulled in with #include "lighting.glsl"
+//the including shader declares the view and projection matrices before the #include, ClusterIndex uses them
+
+// light source, directional lights only, point lights come from the clusters
+// MAX_LIGHTS is a permutation, the light count bucket, see shaderpermutations.h
+#ifndef MAX_LIGHTS
+#define MAX_LIGHTS 10
+#endif
+struct Light {
+   vec4 position;
+   vec3 intensity;
+   float attenuation;
+   float ambientCoefficient;
+   float coneAngle;
+   vec3 coneDirection;
+};
+#if MAX_LIGHTS > 0
+uniform int numLights;
+uniform Light allLights[MAX_LIGHTS];
+#endif
+
+uniform vec3 ambientLight;
+
+//clustered point lights, binned on the CPU by LightClusters
+uniform samplerBuffer clusterLightData;      //(position, range), (intensity, attenuation) per light
+uniform usamplerBuffer clusterGrid;          //(offset, count) into clusterLightIndices per cluster
+uniform usamplerBuffer clusterLightIndices;
+uniform ivec3 clusterDims;
+uniform vec2 clusterDepthParams;             //slice = log(depth) * x + y
+
+struct Material {
+    vec3 specular;
+    vec3 diffuse;
+    float shininess;
+};
+
+//caculate multiple light source
+vec3 ApplyLight(Light light, Material mat,  vec3 normal, vec3 surfacePos, vec3 surfaceToCamera) {
+    vec3 surfaceToLight;
+    float attenuation = 1.0;
+    if(light.position.w == 0.0) {
+        //directional light
+        surfaceToLight = normalize(-light.position.xyz);
+        attenuation = 1.0; //no attenuation for directional lights
+    } else {
+        //point light
+        surfaceToLight = normalize(light.position.xyz - surfacePos);
+        float distanceToLight = length(light.position.xyz - surfacePos);
+        attenuation = 1.0 / (1.0 + light.attenuation * pow(distanceToLight, 2));
+
+        //cone restrictions (affects attenuation)
+        //float lightToSurfaceAngle = degrees(acos(dot(-surfaceToLight, normalize(light.coneDirection))));
+        //if(lightToSurfaceAngle > light.coneAngle){
+        //    attenuation = 0.0;
+        //}
+    }
+
+    //diffuse
+    float diffuseCoefficient = max(0.0, dot(normal, surfaceToLight));
+    vec3 diffuse = diffuseCoefficient * light.intensity * mat.diffuse;
+
+    //specular
+    float specularCoefficient = 0.0;
+    if(diffuseCoefficient > 0.0) //back face need not to calculate
+        specularCoefficient = pow(max(0.0, dot(normal, normalize(surfaceToLight + surfaceToCamera))), mat.shininess);
+    vec3 specular = specularCoefficient * light.intensity * mat.specular;
+
+    //linear color (color before gamma correction)
+    return attenuation * (diffuse + specular);
+}
+
+//cluster of a world space position
+int ClusterIndex(vec3 worldPos)
+{
+    vec4 viewPos = view * vec4(worldPos, 1.0);
+    vec4 clipPos = projection * viewPos;
+    vec2 ndc = clipPos.xy / max(clipPos.w, 1e-4);
+    ivec2 tile = clamp(ivec2((ndc * 0.5 + 0.5) * vec2(clusterDims.xy)), ivec2(0), clusterDims.xy - 1);
+    int slice = int(log(max(-viewPos.z, 1e-4)) * clusterDepthParams.x + clusterDepthParams.y);
+    slice = clamp(slice, 0, clusterDims.z - 1);
+    return tile.x + clusterDims.x * (tile.y + clusterDims.y * slice);
+}
+
+//the point lights of the cluster surfacePos is in
+vec3 ApplyClusteredLights(Material mat, vec3 normal, vec3 surfacePos, vec3 surfaceToCamera)
+{
+    uvec2 range = texelFetch(clusterGrid, ClusterIndex(surfacePos)).xy;
+    vec3 result = vec3(0);
+    for (uint i = 0u; i < range.y; i++) {
+        int lightIndex = int(texelFetch(clusterLightIndices, int(range.x + i)).r);
+        vec4 positionRange = texelFetch(clusterLightData, 2 * lightIndex);
+        vec4 intensityAttenuation = texelFetch(clusterLightData, 2 * lightIndex + 1);
+
+        Light light;
+        light.position = vec4(positionRange.xyz, 1.0);
+        light.intensity = intensityAttenuation.rgb;
+        light.attenuation = intensityAttenuation.a;
+
+        //fade out towards the range, so the light ends where its clusters end
+        float d = length(positionRange.xyz - surfacePos) / positionRange.w;
+        float window = clamp(1.0 - d * d * d * d, 0.0, 1.0);
+        result += window * window * ApplyLight(light, mat, normal, surfacePos, surfaceToCamera);
+    }
+    return result;
+}
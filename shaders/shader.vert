@@ -9,30 +9,31 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
-uniform bool flat_flag = true;
-
-flat out vec3 FlatNormal;
-flat out vec3 FlatFragPos;
-smooth out vec3 SmoothNormal;
-smooth out vec3 SmoothFragPos;
-
-out vec2 fragTexCoord;
+//the depth pre-pass computes the same position, the GL_EQUAL depth test needs them identical
+invariant gl_Position;
+
+//flat or smooth shading, a permutation, see shaderpermutations.h
+#ifdef FLAT
+#define INTERPOLATION flat
+#else
+#define INTERPOLATION smooth
+#endif
+
+//a block, so shader.geom can pass it through in the fill-lines mode
+out VertexData {
+    INTERPOLATION vec3 Normal;
+    INTERPOLATION vec3 FragPos;
+    vec2 fragTexCoord;
+} vertexOut;
 
 void main()
 {  
     gl_Position = projection * view * model * vec4(posAttr, 1.0f);
 
-    fragTexCoord = texCoord;
+    vertexOut.fragTexCoord = texCoord;
 
     /*nomal matrix*/
     /*should compute in cpu, however it is easy to understand by coding here*/
-    FlatNormal = mat3(transpose(inverse(model))) * norAttr;
-    FlatFragPos = vec3(model * vec4(posAttr, 1.0f));
-
-    if (flat_flag == false)
-    {
-        SmoothNormal = FlatNormal;
-        SmoothFragPos = FlatFragPos;
-    }
-
+    vertexOut.Normal = mat3(transpose(inverse(model))) * norAttr;
+    vertexOut.FragPos = vec3(model * vec4(posAttr, 1.0f));
 }
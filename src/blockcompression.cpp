@@ -0,0 +1,223 @@
+#include "blockcompression.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+using namespace makai;
+
+static uint16_t toRGB565(const int rgb[3])
+{
+    return (uint16_t)(((rgb[0] >> 3) << 11) | ((rgb[1] >> 2) << 5) | (rgb[2] >> 3));
+}
+
+static void fromRGB565(uint16_t c, int rgb[3])
+{
+    int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+GLenum BlockCompression::glInternalFormat(Format format)
+{
+    switch (format)
+    {
+        case BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case BC5: return GL_COMPRESSED_RG_RGTC2;
+    }
+    return 0;
+}
+
+size_t BlockCompression::blockBytes(Format format)
+{
+    return format == BC1 ? 8 : 16;
+}
+
+size_t BlockCompression::compressedSize(Format format, int width, int height)
+{
+    size_t blocksX = (std::max(width, 1) + 3) / 4;
+    size_t blocksY = (std::max(height, 1) + 3) / 4;
+    return blocksX * blocksY * blockBytes(format);
+}
+
+std::vector<unsigned char> BlockCompression::encode(Format format, const unsigned char *rgba, int width, int height)
+{
+    const int blocksX = (width + 3) / 4;
+    const int blocksY = (height + 3) / 4;
+    const size_t bytes = blockBytes(format);
+    std::vector<unsigned char> result(compressedSize(format, width, height));
+
+    ThreadPool::instance().parallelFor(0, blocksY, 4, [&](size_t firstRow, size_t lastRow) {
+        unsigned char block[16 * 4];
+        for (size_t by = firstRow; by < lastRow; by++)
+        {
+            for (int bx = 0; bx < blocksX; bx++)
+            {
+                // texels past the edge repeat the last row and column
+                for (int y = 0; y < 4; y++)
+                {
+                    int sy = std::min((int)by * 4 + y, height - 1);
+                    for (int x = 0; x < 4; x++)
+                    {
+                        int sx = std::min(bx * 4 + x, width - 1);
+                        std::copy(rgba + (sy * width + sx) * 4, rgba + (sy * width + sx) * 4 + 4, block + (y * 4 + x) * 4);
+                    }
+                }
+
+                unsigned char* out = &result[(by * blocksX + bx) * bytes];
+                switch (format)
+                {
+                    case BC1:
+                        encodeBC1(block, out);
+                        break;
+                    case BC3:
+                        encodeBC4(block, 3, out);
+                        encodeBC1(block, out + 8);
+                        break;
+                    case BC5:
+                        encodeBC4(block, 0, out);
+                        encodeBC4(block, 1, out + 8);
+                        break;
+                }
+            }
+        }
+    });
+    return result;
+}
+
+std::vector<unsigned char> BlockCompression::resize(const unsigned char *rgba, int width, int height,
+                                                    int newWidth, int newHeight)
+{
+    std::vector<unsigned char> result(newWidth * newHeight * 4);
+    ThreadPool::instance().parallelFor(0, newHeight, 16, [&](size_t firstRow, size_t lastRow) {
+        for (size_t y = firstRow; y < lastRow; y++)
+        {
+            // texel centers of the new image in texels of the old one
+            float sy = std::max((y + 0.5f) * height / newHeight - 0.5f, 0.0f);
+            int y0 = std::min((int)sy, height - 1), y1 = std::min(y0 + 1, height - 1);
+            float fy = sy - y0;
+            for (int x = 0; x < newWidth; x++)
+            {
+                float sx = std::max((x + 0.5f) * width / newWidth - 0.5f, 0.0f);
+                int x0 = std::min((int)sx, width - 1), x1 = std::min(x0 + 1, width - 1);
+                float fx = sx - x0;
+                for (int c = 0; c < 4; c++)
+                {
+                    float top = rgba[(y0 * width + x0) * 4 + c] * (1 - fx) + rgba[(y0 * width + x1) * 4 + c] * fx;
+                    float bottom = rgba[(y1 * width + x0) * 4 + c] * (1 - fx) + rgba[(y1 * width + x1) * 4 + c] * fx;
+                    result[(y * newWidth + x) * 4 + c] = (unsigned char)(top * (1 - fy) + bottom * fy + 0.5f);
+                }
+            }
+        }
+    });
+    return result;
+}
+
+void BlockCompression::encodeBC1(const unsigned char *block, unsigned char *out)
+{
+    int lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            lo[c] = std::min(lo[c], (int)block[i * 4 + c]);
+            hi[c] = std::max(hi[c], (int)block[i * 4 + c]);
+        }
+    }
+    // pulling the endpoints in by 1/16 of the range lowers the error of the inner texels
+    for (int c = 0; c < 3; c++)
+    {
+        int inset = (hi[c] - lo[c]) >> 4;
+        lo[c] += inset;
+        hi[c] -= inset;
+    }
+
+    uint16_t c0 = toRGB565(hi), c1 = toRGB565(lo);
+    uint32_t indices = 0;
+    // c0 > c1 selects the four color mode; equal endpoints leave every index at 0
+    if (c0 < c1)
+        std::swap(c0, c1);
+    if (c0 != c1)
+    {
+        int palette[4][3];
+        fromRGB565(c0, palette[0]);
+        fromRGB565(c1, palette[1]);
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0, bestError = INT32_MAX;
+            for (int p = 0; p < 4; p++)
+            {
+                int error = 0;
+                for (int c = 0; c < 3; c++)
+                {
+                    int d = block[i * 4 + c] - palette[p][c];
+                    error += d * d;
+                }
+                if (error < bestError)
+                {
+                    bestError = error;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (i * 2);
+        }
+    }
+
+    out[0] = c0 & 0xff;
+    out[1] = c0 >> 8;
+    out[2] = c1 & 0xff;
+    out[3] = c1 >> 8;
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (indices >> (i * 8)) & 0xff;
+}
+
+void BlockCompression::encodeBC4(const unsigned char *block, int channel, unsigned char *out)
+{
+    int lo = 255, hi = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        lo = std::min(lo, (int)block[i * 4 + channel]);
+        hi = std::max(hi, (int)block[i * 4 + channel]);
+    }
+
+    uint64_t indices = 0;
+    // hi > lo selects the eight value mode; equal endpoints leave every index at 0
+    if (hi != lo)
+    {
+        int palette[8];
+        palette[0] = hi;
+        palette[1] = lo;
+        for (int p = 1; p < 7; p++)
+            palette[p + 1] = ((7 - p) * hi + p * lo) / 7;
+
+        for (int i = 0; i < 16; i++)
+        {
+            int value = block[i * 4 + channel];
+            int best = 0, bestError = INT32_MAX;
+            for (int p = 0; p < 8; p++)
+            {
+                int error = std::abs(value - palette[p]);
+                if (error < bestError)
+                {
+                    bestError = error;
+                    best = p;
+                }
+            }
+            indices |= (uint64_t)best << (i * 3);
+        }
+    }
+
+    out[0] = (unsigned char)hi;
+    out[1] = (unsigned char)lo;
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (indices >> (i * 8)) & 0xff;
+}
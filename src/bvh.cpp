@@ -0,0 +1,448 @@
+#include "bvh.h"
+#include "threadpool.h"
+#include "tracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <limits>
+
+using namespace makai;
+
+// what visiting a node costs against testing one primitive, for SAH
+static const float TRAVERSAL_COST = 1.0f;
+// ranges at least this big are measured and binned on the thread pool, in chunks of PARALLEL_GRAIN
+static const uint32_t PARALLEL_RANGE = 64 * 1024;
+static const size_t PARALLEL_GRAIN = 16 * 1024;
+// below this the build splits no further on the calling thread, the rest of the subtree is a task of its own
+static const uint32_t SUBTREE_RANGE = 16 * 1024;
+
+Aabb::Aabb() :
+    min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max())
+{
+
+}
+
+Aabb::Aabb(const glm::vec3 &min, const glm::vec3 &max) : min(min), max(max)
+{
+
+}
+
+void Aabb::grow(const glm::vec3 &point)
+{
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+void Aabb::grow(const Aabb &box)
+{
+    min = glm::min(min, box.min);
+    max = glm::max(max, box.max);
+}
+
+float Aabb::surfaceArea() const
+{
+    if (isEmpty())
+        return 0.0f;
+    glm::vec3 extent = max - min;
+    return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+Aabb Aabb::transformed(const glm::mat4 &matrix) const
+{
+    if (isEmpty())
+        return *this;
+    // the half extent along each world axis is the absolute linear part times the old half extent
+    glm::vec3 center = glm::vec3(matrix * glm::vec4(this->center(), 1.0f));
+    glm::mat3 linear(matrix);
+    for (int i = 0; i < 3; i++)
+        linear[i] = glm::abs(linear[i]);
+    glm::vec3 extent = linear * ((max - min) * 0.5f);
+    return Aabb(center - extent, center + extent);
+}
+
+struct Bvh::Builder
+{
+    struct Extent {
+        Aabb bounds;
+        Aabb centers;
+    };
+
+    struct Bins {
+        Aabb bounds[3][BIN_COUNT];
+        uint32_t counts[3][BIN_COUNT];
+    };
+
+    // a node of the shared array whose subtree a task builds into nodes, rooted at 0
+    struct Subtree {
+        uint32_t node;
+        uint32_t first;
+        uint32_t count;
+        std::vector<Node> nodes;
+    };
+
+    const std::vector<Aabb>& bounds;
+    std::vector<uint32_t>& primitives;
+    std::vector<glm::vec3> centers;
+    std::vector<Subtree> subtrees;
+
+    Builder(const std::vector<Aabb> &bounds, std::vector<uint32_t> &primitives) :
+        bounds(bounds), primitives(primitives), centers(bounds.size())
+    {
+        primitives.resize(bounds.size());
+        ThreadPool::instance().parallelFor(0, bounds.size(), PARALLEL_GRAIN, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+            {
+                primitives[i] = (uint32_t)i;
+                centers[i] = bounds[i].center();
+            }
+        });
+    }
+
+    static int binOf(float center, float low, float scale)
+    {
+        return std::min(BIN_COUNT - 1, (int)((center - low) * scale));
+    }
+
+    static glm::vec3 binScale(const Extent &extent)
+    {
+        glm::vec3 size = extent.centers.max - extent.centers.min;
+        glm::vec3 scale;
+        for (int axis = 0; axis < 3; axis++)
+            scale[axis] = size[axis] > 0.0f ? BIN_COUNT / size[axis] : 0.0f;
+        return scale;
+    }
+
+    // calls body(first, last, partial) on chunks of the range, on the pool when it is big, and merges the partials
+    template <typename T>
+    T reduce(uint32_t first, uint32_t count, const std::function<void(size_t, size_t, T&)> &body,
+             const std::function<void(T&, const T&)> &merge) const
+    {
+        if (count < PARALLEL_RANGE) {
+            T result = T();
+            body(first, first + count, result);
+            return result;
+        }
+        std::vector<T> partials((count + PARALLEL_GRAIN - 1) / PARALLEL_GRAIN);
+        ThreadPool::instance().parallelFor(first, first + count, PARALLEL_GRAIN, [&](size_t begin, size_t end) {
+            body(begin, end, partials[(begin - first) / PARALLEL_GRAIN]);
+        });
+        for (size_t i = 1; i < partials.size(); i++)
+            merge(partials[0], partials[i]);
+        return partials[0];
+    }
+
+    Extent measure(uint32_t first, uint32_t count) const
+    {
+        return reduce<Extent>(first, count, [this](size_t begin, size_t end, Extent &extent) {
+            for (size_t i = begin; i < end; i++)
+            {
+                uint32_t primitive = primitives[i];
+                extent.bounds.grow(bounds[primitive]);
+                extent.centers.grow(centers[primitive]);
+            }
+        }, [](Extent &extent, const Extent &other) {
+            extent.bounds.grow(other.bounds);
+            extent.centers.grow(other.centers);
+        });
+    }
+
+    Bins bin(uint32_t first, uint32_t count, const Extent &extent) const
+    {
+        const glm::vec3 low = extent.centers.min;
+        const glm::vec3 scale = binScale(extent);
+        return reduce<Bins>(first, count, [&](size_t begin, size_t end, Bins &bins) {
+            for (size_t i = begin; i < end; i++)
+            {
+                uint32_t primitive = primitives[i];
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    int b = binOf(centers[primitive][axis], low[axis], scale[axis]);
+                    bins.bounds[axis][b].grow(bounds[primitive]);
+                    bins.counts[axis][b]++;
+                }
+            }
+        }, [](Bins &bins, const Bins &other) {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                for (int b = 0; b < BIN_COUNT; b++)
+                {
+                    bins.bounds[axis][b].grow(other.bounds[axis][b]);
+                    bins.counts[axis][b] += other.counts[axis][b];
+                }
+            }
+        });
+    }
+
+    // Splits the range top down into nodes, starting with nodes[root]. With collect, ranges
+    // below SUBTREE_RANGE are left to subtrees instead. Children always come after their parent.
+    void split(std::vector<Node> &nodes, uint32_t root, uint32_t rootFirst, uint32_t rootCount, bool collect)
+    {
+        struct Pending {
+            uint32_t node;
+            uint32_t first;
+            uint32_t count;
+        };
+        std::vector<Pending> stack(1, Pending{ root, rootFirst, rootCount });
+        while (!stack.empty())
+        {
+            const Pending range = stack.back();
+            stack.pop_back();
+
+            if (collect && range.count < SUBTREE_RANGE && range.count > 1) {
+                subtrees.push_back(Subtree{ range.node, range.first, range.count, std::vector<Node>() });
+                continue;
+            }
+
+            const Extent extent = measure(range.first, range.count);
+            Node& node = nodes[range.node];
+            node.boundsMin = extent.bounds.min;
+            node.boundsMax = extent.bounds.max;
+            node.leftOrFirst = range.first;
+            node.count = range.count;
+            if (range.count <= 1)
+                continue;
+
+            // the cheapest plane between bins, by the areas and counts on both sides
+            int bestAxis = -1, bestBin = 0;
+            float bestCost = std::numeric_limits<float>::max();
+            const glm::vec3 scale = binScale(extent);
+            if (scale.x > 0.0f || scale.y > 0.0f || scale.z > 0.0f)
+            {
+                const Bins bins = bin(range.first, range.count, extent);
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    if (scale[axis] == 0.0f)
+                        continue;
+                    float rightArea[BIN_COUNT];
+                    uint32_t rightCount[BIN_COUNT];
+                    Aabb box;
+                    uint32_t n = 0;
+                    for (int b = BIN_COUNT - 1; b > 0; b--)
+                    {
+                        box.grow(bins.bounds[axis][b]);
+                        n += bins.counts[axis][b];
+                        rightArea[b] = box.surfaceArea();
+                        rightCount[b] = n;
+                    }
+                    box = Aabb();
+                    n = 0;
+                    for (int b = 1; b < BIN_COUNT; b++)
+                    {
+                        box.grow(bins.bounds[axis][b - 1]);
+                        n += bins.counts[axis][b - 1];
+                        if (n == 0 || rightCount[b] == 0)
+                            continue;
+                        float cost = box.surfaceArea() * n + rightArea[b] * rightCount[b];
+                        if (cost < bestCost) {
+                            bestCost = cost;
+                            bestAxis = axis;
+                            bestBin = b;
+                        }
+                    }
+                }
+            }
+
+            const float area = extent.bounds.surfaceArea();
+            const bool worthSplitting = bestAxis >= 0 && area > 0.0f &&
+                                        TRAVERSAL_COST + bestCost / area < (float)range.count;
+            if (!worthSplitting && range.count <= MAX_LEAF_SIZE)
+                continue;
+
+            uint32_t leftCount = range.count / 2;
+            if (bestAxis >= 0) {
+                const float low = extent.centers.min[bestAxis];
+                const float axisScale = scale[bestAxis];
+                auto begin = primitives.begin() + range.first;
+                auto middle = std::partition(begin, begin + range.count, [&](uint32_t primitive) {
+                    return binOf(centers[primitive][bestAxis], low, axisScale) < bestBin;
+                });
+                leftCount = (uint32_t)(middle - begin);
+            }
+            //otherwise all centers are the same, any half will do
+
+            const uint32_t left = (uint32_t)nodes.size();
+            node.leftOrFirst = left;
+            node.count = 0;
+            //node is invalid from here on
+            nodes.resize(nodes.size() + 2);
+            stack.push_back(Pending{ left + 1, range.first + leftCount, range.count - leftCount });
+            stack.push_back(Pending{ left, range.first, leftCount });
+        }
+    }
+};
+
+void Bvh::build(const std::vector<Aabb> &bounds)
+{
+    TRACE_SCOPE("Bvh::build");
+    auto start = std::chrono::steady_clock::now();
+    clear();
+    if (bounds.empty())
+        return;
+
+    const uint32_t count = (uint32_t)bounds.size();
+    Builder builder(bounds, m_primitives);
+    m_nodes.reserve(2 * (size_t)count - 1);
+    m_nodes.resize(1);
+    builder.split(m_nodes, 0, 0, count, count >= SUBTREE_RANGE);
+
+    //the subtrees own disjoint ranges of m_primitives
+    ThreadPool::instance().parallelFor(0, builder.subtrees.size(), 1, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++)
+        {
+            Builder::Subtree& subtree = builder.subtrees[i];
+            subtree.nodes.reserve(2 * (size_t)subtree.count - 1);
+            subtree.nodes.resize(1);
+            builder.split(subtree.nodes, 0, subtree.first, subtree.count, false);
+        }
+    });
+
+    //a subtree's root takes its placeholder, the other nodes go to the end, sibling pairs stay together
+    for (const Builder::Subtree& subtree : builder.subtrees)
+    {
+        const uint32_t offset = (uint32_t)m_nodes.size() - 1;
+        auto moved = [offset](Node node) {
+            if (!node.isLeaf())
+                node.leftOrFirst += offset;
+            return node;
+        };
+        m_nodes[subtree.node] = moved(subtree.nodes[0]);
+        for (size_t i = 1; i < subtree.nodes.size(); i++)
+            m_nodes.push_back(moved(subtree.nodes[i]));
+    }
+
+    finishBuild(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
+
+void Bvh::buildTriangles(const std::vector<float> &vertices, unsigned step, const std::vector<unsigned> &indices)
+{
+    if (step < 3) {
+        clear();
+        return;
+    }
+    std::vector<Aabb> bounds(indices.size() / 3);
+    ThreadPool::instance().parallelFor(0, bounds.size(), PARALLEL_GRAIN, [&](size_t first, size_t last) {
+        for (size_t triangle = first; triangle < last; triangle++)
+        {
+            Aabb& box = bounds[triangle];
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                size_t vertex = (size_t)indices[triangle * 3 + corner] * step;
+                if (vertex + 2 < vertices.size())
+                    box.grow(glm::vec3(vertices[vertex], vertices[vertex + 1], vertices[vertex + 2]));
+            }
+        }
+    });
+    build(bounds);
+}
+
+void Bvh::refit(const std::vector<Aabb> &bounds, const std::vector<uint32_t> &changed)
+{
+    if (m_nodes.empty() || changed.empty())
+        return;
+    TRACE_SCOPE("Bvh::refit");
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<uint32_t> dirty;
+    for (uint32_t primitive : changed)
+    {
+        if (primitive >= m_primitiveLeaves.size())
+            continue;
+        for (uint32_t node = m_primitiveLeaves[primitive]; ; node = m_parents[node])
+        {
+            dirty.push_back(node);
+            if (node == 0)
+                break;
+        }
+    }
+    //children come after their parents, from the back every node sees its children done
+    std::sort(dirty.begin(), dirty.end(), std::greater<uint32_t>());
+    dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+    for (uint32_t index : dirty)
+    {
+        Node& node = m_nodes[index];
+        Aabb box;
+        if (node.isLeaf()) {
+            for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++)
+                box.grow(bounds[m_primitives[i]]);
+        } else {
+            for (uint32_t child = node.leftOrFirst; child < node.leftOrFirst + 2; child++)
+                box.grow(Aabb(m_nodes[child].boundsMin, m_nodes[child].boundsMax));
+        }
+        node.boundsMin = box.min;
+        node.boundsMax = box.max;
+    }
+
+    m_statistics.sahCost = computeSahCost();
+    m_statistics.refitMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Bvh::clear()
+{
+    m_nodes.clear();
+    m_primitives.clear();
+    m_parents.clear();
+    m_primitiveLeaves.clear();
+    m_statistics = Statistics();
+}
+
+Aabb Bvh::bounds() const
+{
+    if (m_nodes.empty())
+        return Aabb();
+    return Aabb(m_nodes[0].boundsMin, m_nodes[0].boundsMax);
+}
+
+size_t Bvh::byteSize() const
+{
+    return m_nodes.capacity() * sizeof(Node) +
+           (m_primitives.capacity() + m_parents.capacity() + m_primitiveLeaves.capacity()) * sizeof(uint32_t);
+}
+
+void Bvh::finishBuild(double milliseconds)
+{
+    m_parents.assign(m_nodes.size(), 0);
+    m_primitiveLeaves.assign(m_primitives.size(), 0);
+    std::vector<int> depths(m_nodes.size(), 1);
+
+    Statistics statistics;
+    statistics.primitives = m_primitives.size();
+    statistics.nodes = m_nodes.size();
+    for (uint32_t index = 0; index < m_nodes.size(); index++)
+    {
+        const Node& node = m_nodes[index];
+        statistics.maxDepth = std::max(statistics.maxDepth, depths[index]);
+        if (node.isLeaf()) {
+            statistics.leaves++;
+            for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++)
+                m_primitiveLeaves[m_primitives[i]] = index;
+        } else {
+            for (uint32_t child = node.leftOrFirst; child < node.leftOrFirst + 2; child++)
+            {
+                m_parents[child] = index;
+                depths[child] = depths[index] + 1;
+            }
+        }
+    }
+    statistics.averageLeafSize = statistics.leaves > 0 ? (double)statistics.primitives / statistics.leaves : 0.0;
+    statistics.buildMilliseconds = milliseconds;
+    m_statistics = statistics;
+    m_statistics.sahCost = computeSahCost();
+}
+
+double Bvh::computeSahCost() const
+{
+    if (m_nodes.empty())
+        return 0.0;
+    const double rootArea = bounds().surfaceArea();
+    if (rootArea <= 0.0)
+        return (double)m_primitives.size();
+
+    double cost = 0.0;
+    for (const Node& node : m_nodes)
+    {
+        double area = Aabb(node.boundsMin, node.boundsMax).surfaceArea();
+        cost += area / rootArea * (node.isLeaf() ? (double)node.count : TRAVERSAL_COST);
+    }
+    return cost;
+}
@@ -0,0 +1,242 @@
+#include "framecapture.h"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+
+using namespace makai;
+
+// "MKFC", then the version; the rest is written in declaration order, native byte order
+static const uint32_t CAPTURE_MAGIC = 0x43464b4d;
+// cells per axis ANONYMIZE snaps vertices to
+static const float ANONYMIZE_GRID = 16.0f;
+
+namespace
+{
+    class Writer
+    {
+    public:
+        explicit Writer(std::ofstream &file) : m_file(file) {}
+
+        template <typename T>
+        void value(const T &v) { m_file.write(reinterpret_cast<const char*>(&v), sizeof(T)); }
+
+        template <typename T>
+        void array(const std::vector<T> &v)
+        {
+            value((uint64_t)v.size());
+            if (!v.empty())
+                m_file.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+        }
+
+        void string(const std::string &s)
+        {
+            value((uint32_t)s.size());
+            m_file.write(s.data(), s.size());
+        }
+    private:
+        std::ofstream& m_file;
+    };
+
+    // reads fail, and stay failed, past the end of the file or on sizes the file can't hold
+    class Reader
+    {
+    public:
+        Reader(std::ifstream &file, uint64_t size) : m_file(file), m_remaining(size) {}
+
+        bool ok() const { return (bool)m_file; }
+
+        template <typename T>
+        void value(T &v) { bytes(reinterpret_cast<char*>(&v), sizeof(T)); }
+
+        template <typename T>
+        void array(std::vector<T> &v)
+        {
+            uint64_t count = 0;
+            value(count);
+            if (!ok() || count > m_remaining / sizeof(T)) {
+                fail();
+                return;
+            }
+            v.resize((size_t)count);
+            if (count > 0)
+                bytes(reinterpret_cast<char*>(v.data()), (size_t)count * sizeof(T));
+        }
+
+        void string(std::string &s)
+        {
+            uint32_t length = 0;
+            value(length);
+            if (!ok() || length > m_remaining) {
+                fail();
+                return;
+            }
+            s.resize(length);
+            if (length > 0)
+                bytes(&s[0], length);
+        }
+
+        // a count of records of at least minimumSize bytes each
+        bool count(uint64_t &n, size_t minimumSize)
+        {
+            value(n);
+            if (!ok() || n > m_remaining / minimumSize)
+                fail();
+            return ok();
+        }
+    private:
+        std::ifstream& m_file;
+        uint64_t m_remaining;
+
+        void bytes(char *data, size_t size)
+        {
+            if (size > m_remaining) {
+                fail();
+                return;
+            }
+            m_file.read(data, size);
+            m_remaining -= size;
+        }
+
+        void fail() { m_file.setstate(std::ios::failbit); }
+    };
+}
+
+void FrameCapture::anonymize()
+{
+    geometry = ANONYMIZE;
+    textures.clear();
+    for (SubMesh& mesh : subMeshes)
+    {
+        mesh.texIndices.clear();
+        if (mesh.step < 3)
+            continue;
+
+        glm::vec3 low(std::numeric_limits<float>::max()), high(-std::numeric_limits<float>::max());
+        for (size_t i = 0; i + 2 < mesh.vertices.size(); i += mesh.step)
+        {
+            glm::vec3 position(mesh.vertices[i], mesh.vertices[i + 1], mesh.vertices[i + 2]);
+            low = glm::min(low, position);
+            high = glm::max(high, position);
+        }
+        if (low.x > high.x)
+            continue;
+        const glm::vec3 center = (low + high) * 0.5f;
+        const glm::vec3 cell = glm::max((high - low) / ANONYMIZE_GRID, glm::vec3(1e-6f));
+
+        for (size_t i = 0; i + mesh.step <= mesh.vertices.size(); i += mesh.step)
+        {
+            glm::vec3 position(mesh.vertices[i], mesh.vertices[i + 1], mesh.vertices[i + 2]);
+            position = low + glm::floor((position - low) / cell + 0.5f) * cell;
+            glm::vec3 normal = position - center;
+            normal = glm::dot(normal, normal) > 0.0f ? glm::normalize(normal) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+            mesh.vertices[i] = position.x;
+            mesh.vertices[i + 1] = position.y;
+            mesh.vertices[i + 2] = position.z;
+            // the layout is position, normal, texture coordinates, see Mesh::processMesh()
+            for (unsigned j = 3; j < mesh.step; j++)
+                mesh.vertices[i + j] = j < 6 ? normal[j - 3] : 0.0f;
+        }
+    }
+}
+
+bool FrameCapture::save(const std::string &fileName) const
+{
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+
+    Writer out(file);
+    out.value(CAPTURE_MAGIC);
+    out.value(VERSION);
+    out.value((int32_t)displayMode);
+    out.value((int32_t)shadingMode);
+    out.value((int32_t)textureMode);
+    out.value((uint8_t)flat);
+    out.value((uint8_t)depthPrepass);
+    out.value((uint8_t)interactive);
+    out.value((int32_t)width);
+    out.value((int32_t)height);
+    out.value(camera);
+    out.array(lights);
+    out.array(objects);
+
+    out.value((int32_t)geometry);
+    out.string(modelPath);
+    out.value((uint64_t)subMeshes.size());
+    for (const SubMesh& mesh : subMeshes)
+    {
+        out.value(mesh.step);
+        out.value(mesh.transform);
+        out.array(mesh.vertices);
+        out.array(mesh.indices);
+        out.array(mesh.texIndices);
+    }
+    out.value((uint64_t)textures.size());
+    for (const Texture& texture : textures)
+    {
+        out.value((int32_t)texture.type);
+        out.string(texture.fileName);
+    }
+    return (bool)file;
+}
+
+bool FrameCapture::load(const std::string &fileName)
+{
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+        return false;
+    const uint64_t size = (uint64_t)file.tellg();
+    file.seekg(0);
+
+    Reader in(file, size);
+    uint32_t magic = 0, version = 0;
+    in.value(magic);
+    in.value(version);
+    if (!in.ok() || magic != CAPTURE_MAGIC || version != VERSION)
+        return false;
+
+    int32_t i32 = 0;
+    uint8_t u8 = 0;
+    in.value(i32); displayMode = i32;
+    in.value(i32); shadingMode = i32;
+    in.value(i32); textureMode = i32;
+    in.value(u8); flat = u8 != 0;
+    in.value(u8); depthPrepass = u8 != 0;
+    in.value(u8); interactive = u8 != 0;
+    in.value(i32); width = std::max(i32, 1);
+    in.value(i32); height = std::max(i32, 1);
+    in.value(camera);
+    in.array(lights);
+    in.array(objects);
+
+    in.value(i32); geometry = (Geometry)i32;
+    in.string(modelPath);
+    uint64_t count = 0;
+    subMeshes.clear();
+    if (in.count(count, sizeof(uint32_t) + sizeof(glm::mat4) + 3 * sizeof(uint64_t)))
+    {
+        subMeshes.resize((size_t)count);
+        for (SubMesh& mesh : subMeshes)
+        {
+            in.value(mesh.step);
+            in.value(mesh.transform);
+            in.array(mesh.vertices);
+            in.array(mesh.indices);
+            in.array(mesh.texIndices);
+        }
+    }
+    textures.clear();
+    if (in.count(count, sizeof(int32_t) + sizeof(uint32_t)))
+    {
+        textures.resize((size_t)count);
+        for (Texture& texture : textures)
+        {
+            in.value(i32);
+            texture.type = i32;
+            in.string(texture.fileName);
+        }
+    }
+    return in.ok() && geometry >= REFERENCE && geometry <= ANONYMIZE;
+}
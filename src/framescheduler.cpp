@@ -0,0 +1,166 @@
+#include "framescheduler.h"
+
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <sys/resource.h>
+#endif
+
+using namespace makai;
+
+FrameScheduler::FrameScheduler(QWidget *target) : m_target(target),
+    m_policy(ONDEMAND), m_targetFps(60), m_refineWhenIdle(false),
+    m_interacting(false), m_loadsInFlight(0),
+    m_frameTimer(), m_refineTimer(),
+    m_totalFrames(0), m_sampleFrames(0), m_sampleClock(), m_sampleCpuSeconds(0.0)
+{
+    m_frameTimer.setTimerType(Qt::PreciseTimer);
+    m_frameTimer.setInterval(1000 / m_targetFps);
+    QObject::connect(&m_frameTimer, &QTimer::timeout, [this]() { m_target->update(); });
+
+    m_refineTimer.setSingleShot(true);
+    m_refineTimer.setInterval(200);
+    QObject::connect(&m_refineTimer, &QTimer::timeout, [this]() { onRefineTimeout(); });
+
+    m_sampleClock.start();
+    m_sampleCpuSeconds = processCpuSeconds();
+}
+
+FrameScheduler::Policy FrameScheduler::policy() const
+{
+    return m_policy;
+}
+
+void FrameScheduler::setPolicy(Policy policy)
+{
+    m_policy = policy;
+    if (m_policy == CONTINUOUS)
+        m_frameTimer.start();
+    else
+        m_frameTimer.stop();
+    requestRedraw();
+}
+
+int FrameScheduler::targetFps() const
+{
+    return m_targetFps;
+}
+
+void FrameScheduler::setTargetFps(int fps)
+{
+    m_targetFps = fps > 0 ? fps : 1;
+    m_frameTimer.setInterval(1000 / m_targetFps);
+}
+
+bool FrameScheduler::refineWhenIdle() const
+{
+    return m_refineWhenIdle;
+}
+
+void FrameScheduler::setRefineWhenIdle(bool refine)
+{
+    m_refineWhenIdle = refine;
+    requestRedraw();
+}
+
+int FrameScheduler::refineDelay() const
+{
+    return m_refineTimer.interval();
+}
+
+void FrameScheduler::setRefineDelay(int ms)
+{
+    m_refineTimer.setInterval(ms);
+}
+
+void FrameScheduler::requestRedraw()
+{
+    // QWidget::update() coalesces, several requests before the next paint cost one frame
+    m_target->update();
+}
+
+void FrameScheduler::interact()
+{
+    m_interacting = true;
+    m_refineTimer.start();
+    requestRedraw();
+}
+
+void FrameScheduler::beginLoad()
+{
+    m_loadsInFlight++;
+    requestRedraw();
+}
+
+void FrameScheduler::endLoad()
+{
+    if (m_loadsInFlight > 0)
+        m_loadsInFlight--;
+    requestRedraw();
+}
+
+bool FrameScheduler::isInteractiveFrame() const
+{
+    return m_refineWhenIdle && m_interacting;
+}
+
+void FrameScheduler::frameRendered()
+{
+    m_totalFrames++;
+    m_sampleFrames++;
+
+    // loads report progress by changing what is on screen, keep frames coming until they finish
+    if (m_loadsInFlight > 0 && m_policy == ONDEMAND)
+        requestRedraw();
+}
+
+void FrameScheduler::onRefineTimeout()
+{
+    m_interacting = false;
+    // the last frames were drawn at interactive quality, draw the full one now
+    if (m_refineWhenIdle)
+        requestRedraw();
+}
+
+FrameScheduler::Statistics FrameScheduler::statistics()
+{
+    double wallSeconds = m_sampleClock.restart() / 1000.0;
+    double cpuSeconds = processCpuSeconds();
+
+    Statistics stats;
+    stats.fps = wallSeconds > 0.0 ? m_sampleFrames / wallSeconds : 0.0;
+    stats.cpuPercent = wallSeconds > 0.0 ? 100.0 * (cpuSeconds - m_sampleCpuSeconds) / wallSeconds : 0.0;
+    stats.idle = m_sampleFrames == 0;
+    stats.totalFrames = m_totalFrames;
+
+    m_sampleFrames = 0;
+    m_sampleCpuSeconds = cpuSeconds;
+    return stats;
+}
+
+double FrameScheduler::processCpuSeconds()
+{
+#ifdef _WIN32
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime))
+        return 0.0;
+
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+    // FILETIME counts 100 ns intervals
+    return (kernel.QuadPart + user.QuadPart) * 1e-7;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0.0;
+
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+}
@@ -2,7 +2,8 @@
 
 using namespace makai;
 
-GameObject::GameObject() : m_position(0), m_scalar(1), m_rotation()
+GameObject::GameObject() : m_mesh(nullptr), m_shaderProgram(nullptr),
+    m_position(0), m_scalar(1), m_rotation(), m_revision(0)
 {
 
 }
@@ -15,6 +16,7 @@ glm::vec3 GameObject::position() const
 void GameObject::setPosition(const glm::vec3 &position)
 {
     m_position = position;
+    m_revision++;
 }
 
 glm::vec3 GameObject::scalar() const
@@ -25,6 +27,7 @@ glm::vec3 GameObject::scalar() const
 void GameObject::setScalar(const glm::vec3 &scalar)
 {
     m_scalar = scalar;
+    m_revision++;
 }
 
 void GameObject::setRotation(const glm::vec3 &rotation)
@@ -33,6 +36,7 @@ void GameObject::setRotation(const glm::vec3 &rotation)
     glm::quat qy = glm::angleAxis(glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
     glm::quat qz = glm::angleAxis(glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
     m_rotation = qy * qx * qz;
+    m_revision++;
 }
 
 void GameObject::setRotation(float x, float y, float z)
@@ -40,9 +44,26 @@ void GameObject::setRotation(float x, float y, float z)
     setRotation(glm::vec3(x, y, z));
 }
 
+glm::quat GameObject::rotation() const
+{
+    return m_rotation;
+}
+
+void GameObject::setRotation(const glm::quat &rotation)
+{
+    m_rotation = rotation;
+    m_revision++;
+}
+
+Mesh *GameObject::mesh() const
+{
+    return m_mesh;
+}
+
 void GameObject::setMesh(Mesh *mesh)
 {
     m_mesh = mesh;
+    m_revision++;
 }
 
 void GameObject::setShaderProgram(ShaderProgram *shaderProgram)
@@ -50,16 +71,25 @@ void GameObject::setShaderProgram(ShaderProgram *shaderProgram)
     m_shaderProgram = shaderProgram;
 }
 
-void GameObject::paint(const std::vector<Light> &lights)
+void GameObject::paint()
+{
+    if (m_shaderProgram == nullptr || m_mesh == nullptr) return;
+    m_shaderProgram->bind();
+    m_mesh->paint(m_shaderProgram, modelMatrix());
+}
+
+void GameObject::paintDepth(ShaderProgram *depthProgram)
+{
+    if (depthProgram == nullptr || m_mesh == nullptr) return;
+    m_mesh->paintDepth(depthProgram, modelMatrix());
+}
+
+glm::mat4 GameObject::modelMatrix() const
 {
     glm::mat4 model = glm::translate(glm::mat4( 1.0f ), m_position);
     model = glm::scale(model, m_scalar);
     model = model * glm::mat4_cast(m_rotation);
-
-    if (m_shaderProgram == nullptr || m_mesh == nullptr) return;
-    m_shaderProgram->bind();
-    m_shaderProgram->setUniform("model", model);
-    m_mesh->paint(m_shaderProgram, lights);
+    return model;
 }
 
 ShaderProgram *GameObject::shaderProgram()
@@ -71,4 +101,5 @@ void GameObject::rotate(float angle, glm::vec3 axis)
 {
     glm::quat q = glm::angleAxis(glm::radians(-angle), glm::normalize(axis));
     m_rotation = q * m_rotation;
+    m_revision++;
 }
@@ -0,0 +1,119 @@
+#include "gbuffer.h"
+
+#include <QDebug>
+
+#include <algorithm>
+
+#include "makaidebug.h"
+#include "renderstats.h"
+
+using namespace makai;
+
+GBuffer::GBuffer() : m_framebuffer(0), m_width(0), m_height(0)
+{
+    std::fill(m_textures, m_textures + TARGET_COUNT, 0);
+}
+
+GBuffer::~GBuffer()
+{
+    destroy();
+}
+
+bool GBuffer::resize(int width, int height)
+{
+    if (width == m_width && height == m_height && m_framebuffer != 0)
+        return true;
+    destroy();
+
+    m_width = std::max(width, 1);
+    m_height = std::max(height, 1);
+
+    struct TargetFormat {
+        GLint internalFormat;
+        GLenum format;
+        GLenum type;
+        GLenum attachment;
+        const char* label;
+    };
+    const TargetFormat formats[TARGET_COUNT] = {
+        { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_COLOR_ATTACHMENT0, "g-buffer albedo specular" },
+        { GL_RG16, GL_RG, GL_UNSIGNED_SHORT, GL_COLOR_ATTACHMENT1, "g-buffer normal" },
+        { GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, GL_DEPTH_ATTACHMENT, "g-buffer depth" }
+    };
+
+    GL_CHECK( glGenFramebuffers(1, &m_framebuffer) );
+    GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer) );
+    GL_CHECK( glGenTextures(TARGET_COUNT, m_textures) );
+    for (unsigned i = 0; i < TARGET_COUNT; i++)
+    {
+        GL_CHECK( glBindTexture(GL_TEXTURE_2D, m_textures[i]) );
+        GL_CHECK( glTexImage2D(GL_TEXTURE_2D, 0, formats[i].internalFormat, m_width, m_height, 0,
+                               formats[i].format, formats[i].type, nullptr) );
+        //the lighting pass fetches exact texels, no filtering
+        GL_CHECK( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST) );
+        GL_CHECK( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST) );
+        GL_CHECK( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE) );
+        GL_CHECK( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE) );
+        GL_CHECK( glFramebufferTexture2D(GL_FRAMEBUFFER, formats[i].attachment, GL_TEXTURE_2D, m_textures[i], 0) );
+        GLDebug::setObjectLabel(GL_TEXTURE, m_textures[i], formats[i].label);
+    }
+    GL_CHECK( glBindTexture(GL_TEXTURE_2D, 0) );
+
+    const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    GL_CHECK( glDrawBuffers(2, drawBuffers) );
+    GLDebug::setObjectLabel(GL_FRAMEBUFFER, m_framebuffer, "g-buffer");
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, 0) );
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        qDebug("G-buffer incomplete: %04x", status);
+        destroy();
+        return false;
+    }
+    return true;
+}
+
+void GBuffer::destroy()
+{
+    if (m_framebuffer == 0)
+        return;
+    glDeleteTextures(TARGET_COUNT, m_textures);
+    glDeleteFramebuffers(1, &m_framebuffer);
+    std::fill(m_textures, m_textures + TARGET_COUNT, 0);
+    m_framebuffer = 0;
+    m_width = 0;
+    m_height = 0;
+}
+
+int GBuffer::width() const
+{
+    return m_width;
+}
+
+int GBuffer::height() const
+{
+    return m_height;
+}
+
+GLuint GBuffer::texture(Target target) const
+{
+    return m_textures[target];
+}
+
+void GBuffer::bindForWriting() const
+{
+    GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer) );
+    GL_CHECK( glViewport(0, 0, m_width, m_height) );
+}
+
+void GBuffer::bindTextures(GLuint firstUnit) const
+{
+    for (unsigned i = 0; i < TARGET_COUNT; i++)
+    {
+        GL_CHECK( glActiveTexture(GL_TEXTURE0 + firstUnit + i) );
+        GL_CHECK( glBindTexture(GL_TEXTURE_2D, m_textures[i]) );
+        RenderStats::instance().countTextureBind();
+    }
+    GL_CHECK( glActiveTexture(GL_TEXTURE0) );
+}
@@ -3,7 +3,8 @@
 Light::Light() : m_type(LightType::Directional),
     m_direction(-1.0f, -1.0f, -1.0f, 0.0f),
     m_position(1.0f, 1.0f, 1.0f, 1.0f),
-    m_intensity(1.0f, 1.0f, 1.0f)
+    m_intensity(1.0f, 1.0f, 1.0f),
+    m_attenuation(0.01f), m_range(50.0f)
 {
 
 }
@@ -21,11 +22,21 @@ void Light::setPosition(float x, float y, float z)
     m_position = glm::vec4(x, y, z, 1.0f);
 }
 
+void Light::setPosition(const glm::vec4 &position)
+{
+    m_position = position;
+}
+
 void Light::setDirection(float x, float y, float z)
 {
     m_direction = glm::vec4(x, y, z, 0.0f);
 }
 
+void Light::setDirection(const glm::vec4 &direction)
+{
+    m_direction = direction;
+}
+
 int Light::type() const
 {
     return m_type;
@@ -51,6 +62,26 @@ glm::vec3 Light::intensity() const
     return m_intensity;
 }
 
+float Light::attenuation() const
+{
+    return m_attenuation;
+}
+
+void Light::setAttenuation(float attenuation)
+{
+    m_attenuation = attenuation;
+}
+
+float Light::range() const
+{
+    return m_range;
+}
+
+void Light::setRange(float range)
+{
+    m_range = range;
+}
+
 float Light::clamp(float input, float min, float max)
 {
     if (input < min) return min;
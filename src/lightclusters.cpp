@@ -0,0 +1,288 @@
+#include "lightclusters.h"
+
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <cmath>
+
+#include "makaidebug.h"
+#include "renderstats.h"
+#include "threadpool.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#define MAKAI_CLUSTERS_SSE
+#endif
+
+using namespace makai;
+
+LightClusters::LightClusters() : m_bounds(), m_fieldOfView(0.0f), m_aspect(0.0f), m_near(0.0f), m_far(0.0f),
+    m_sliceLights(SLICES), m_clusterLights(CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER),
+    m_clusterCounts(CLUSTER_COUNT), m_grid(CLUSTER_COUNT * 2), m_binningMilliseconds(0.0)
+{
+    std::fill(m_buffers, m_buffers + BUFFER_COUNT, 0);
+    std::fill(m_textures, m_textures + BUFFER_COUNT, 0);
+}
+
+LightClusters::~LightClusters()
+{
+    destroy();
+}
+
+void LightClusters::initialize()
+{
+    if (m_buffers[0] != 0)
+        return;
+
+    const GLenum formats[BUFFER_COUNT] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+    const char* labels[BUFFER_COUNT] = { "cluster light data", "cluster grid", "cluster light indices" };
+
+    GL_CHECK( glGenBuffers(BUFFER_COUNT, m_buffers) );
+    GL_CHECK( glGenTextures(BUFFER_COUNT, m_textures) );
+    for (unsigned i = 0; i < BUFFER_COUNT; i++)
+    {
+        GL_CHECK( glBindBuffer(GL_TEXTURE_BUFFER, m_buffers[i]) );
+        GL_CHECK( glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW) );
+        GL_CHECK( glBindTexture(GL_TEXTURE_BUFFER, m_textures[i]) );
+        GL_CHECK( glTexBuffer(GL_TEXTURE_BUFFER, formats[i], m_buffers[i]) );
+        GLDebug::setObjectLabel(GL_BUFFER, m_buffers[i], labels[i]);
+        GLDebug::setObjectLabel(GL_TEXTURE, m_textures[i], labels[i]);
+    }
+    GL_CHECK( glBindTexture(GL_TEXTURE_BUFFER, 0) );
+    GL_CHECK( glBindBuffer(GL_TEXTURE_BUFFER, 0) );
+}
+
+void LightClusters::destroy()
+{
+    if (m_buffers[0] == 0)
+        return;
+    glDeleteTextures(BUFFER_COUNT, m_textures);
+    glDeleteBuffers(BUFFER_COUNT, m_buffers);
+    std::fill(m_buffers, m_buffers + BUFFER_COUNT, 0);
+    std::fill(m_textures, m_textures + BUFFER_COUNT, 0);
+}
+
+void LightClusters::update(const std::vector<Light> &lights, const glm::mat4 &view,
+                           float fieldOfView, float aspect, float zNear, float zFar)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    if (fieldOfView != m_fieldOfView || aspect != m_aspect || zNear != m_near || zFar != m_far)
+    {
+        m_fieldOfView = fieldOfView;
+        m_aspect = aspect;
+        m_near = zNear;
+        m_far = zFar;
+        buildBounds();
+    }
+
+    m_lightX.clear();
+    m_lightY.clear();
+    m_lightZ.clear();
+    m_lightRadius.clear();
+    m_lightData.clear();
+    for (unsigned s = 0; s < SLICES; s++)
+        m_sliceLights[s].clear();
+
+    //cull by depth and sort the lights into the slices they overlap, serially;
+    //the per-tile tests below are the expensive part and run per slice in parallel
+    for (size_t i = 0; i < lights.size(); i++)
+    {
+        const Light &light = lights.at(i);
+        if (light.position().w == 0.0f)
+            continue;
+
+        glm::vec4 viewPosition = view * light.position();
+        float depth = -viewPosition.z;
+        float radius = light.range();
+        if (depth + radius < m_near || depth - radius > m_far)
+            continue;
+
+        unsigned id = (unsigned)m_lightX.size();
+        m_lightX.push_back(viewPosition.x);
+        m_lightY.push_back(viewPosition.y);
+        m_lightZ.push_back(viewPosition.z);
+        m_lightRadius.push_back(radius);
+
+        glm::vec4 position = light.position();
+        glm::vec3 intensity = light.intensity();
+        GLfloat data[8] = { position.x, position.y, position.z, radius,
+                            intensity.x, intensity.y, intensity.z, light.attenuation() };
+        m_lightData.insert(m_lightData.end(), data, data + 8);
+
+        unsigned last = sliceOf(depth + radius);
+        for (unsigned s = sliceOf(depth - radius); s <= last; s++)
+            m_sliceLights[s].push_back(id);
+    }
+
+    ThreadPool::instance().parallelFor(0, SLICES, 1, [this](size_t first, size_t last) {
+        for (size_t s = first; s < last; s++)
+            binSlice((unsigned)s);
+    });
+
+    //pack the fixed size scratch lists into one index list
+    m_lightIndices.clear();
+    for (unsigned c = 0; c < CLUSTER_COUNT; c++)
+    {
+        const GLuint* clusterLights = &m_clusterLights[c * MAX_LIGHTS_PER_CLUSTER];
+        m_grid[c * 2] = (GLuint)m_lightIndices.size();
+        m_grid[c * 2 + 1] = m_clusterCounts[c];
+        m_lightIndices.insert(m_lightIndices.end(), clusterLights, clusterLights + m_clusterCounts[c]);
+    }
+
+    m_binningMilliseconds = timer.nsecsElapsed() / 1000000.0;
+}
+
+void LightClusters::upload()
+{
+    //an empty buffer can't back a buffer texture, keep one unused element
+    if (m_lightData.empty())
+        m_lightData.resize(8, 0.0f);
+    if (m_lightIndices.empty())
+        m_lightIndices.push_back(0);
+
+    GL_CHECK( glBindBuffer(GL_TEXTURE_BUFFER, m_buffers[LIGHT_DATA]) );
+    GL_CHECK( glBufferData(GL_TEXTURE_BUFFER, m_lightData.size() * sizeof(GLfloat), &m_lightData[0], GL_STREAM_DRAW) );
+    GL_CHECK( glBindBuffer(GL_TEXTURE_BUFFER, m_buffers[GRID]) );
+    GL_CHECK( glBufferData(GL_TEXTURE_BUFFER, m_grid.size() * sizeof(GLuint), &m_grid[0], GL_STREAM_DRAW) );
+    GL_CHECK( glBindBuffer(GL_TEXTURE_BUFFER, m_buffers[LIGHT_INDICES]) );
+    GL_CHECK( glBufferData(GL_TEXTURE_BUFFER, m_lightIndices.size() * sizeof(GLuint), &m_lightIndices[0], GL_STREAM_DRAW) );
+    GL_CHECK( glBindBuffer(GL_TEXTURE_BUFFER, 0) );
+}
+
+void LightClusters::bind(ShaderProgram *program, GLuint firstUnit) const
+{
+    for (unsigned i = 0; i < BUFFER_COUNT; i++)
+    {
+        GL_CHECK( glActiveTexture(GL_TEXTURE0 + firstUnit + i) );
+        GL_CHECK( glBindTexture(GL_TEXTURE_BUFFER, m_textures[i]) );
+        RenderStats::instance().countTextureBind();
+    }
+    GL_CHECK( glActiveTexture(GL_TEXTURE0) );
+
+    program->setUniform("clusterLightData"_u, (GLint)firstUnit);
+    program->setUniform("clusterGrid"_u, (GLint)(firstUnit + 1));
+    program->setUniform("clusterLightIndices"_u, (GLint)(firstUnit + 2));
+    program->setUniform("clusterDims"_u, (GLint)TILES_X, (GLint)TILES_Y, (GLint)SLICES);
+
+    //slice = log(depth) * scale + bias, the inverse of the slice depths in buildBounds()
+    float logRatio = std::log(m_far / m_near);
+    program->setUniform("clusterDepthParams"_u, SLICES / logRatio, -(SLICES * std::log(m_near)) / logRatio);
+}
+
+unsigned LightClusters::pointLightCount() const
+{
+    return (unsigned)m_lightX.size();
+}
+
+unsigned LightClusters::assignedLightCount() const
+{
+    return (unsigned)m_lightIndices.size();
+}
+
+double LightClusters::binningMilliseconds() const
+{
+    return m_binningMilliseconds;
+}
+
+void LightClusters::buildBounds()
+{
+    m_bounds.resize(CLUSTER_COUNT);
+
+    float tanHalfY = std::tan(glm::radians(m_fieldOfView) * 0.5f);
+    float tanHalfX = tanHalfY * m_aspect;
+    for (unsigned s = 0; s < SLICES; s++)
+    {
+        //exponential slices keep the clusters roughly cubic along the view direction
+        float sliceNear = m_near * std::pow(m_far / m_near, (float)s / SLICES);
+        float sliceFar = m_near * std::pow(m_far / m_near, (float)(s + 1) / SLICES);
+        for (unsigned y = 0; y < TILES_Y; y++)
+        {
+            float ndcBottom = -1.0f + 2.0f * y / TILES_Y;
+            float ndcTop = -1.0f + 2.0f * (y + 1) / TILES_Y;
+            for (unsigned x = 0; x < TILES_X; x++)
+            {
+                float ndcLeft = -1.0f + 2.0f * x / TILES_X;
+                float ndcRight = -1.0f + 2.0f * (x + 1) / TILES_X;
+
+                //the tile's side planes go through the eye, so the extremes are at the near or far depth
+                ClusterBounds &bounds = m_bounds[x + TILES_X * (y + TILES_Y * s)];
+                bounds.min.x = std::min(ndcLeft * sliceNear, ndcLeft * sliceFar) * tanHalfX;
+                bounds.max.x = std::max(ndcRight * sliceNear, ndcRight * sliceFar) * tanHalfX;
+                bounds.min.y = std::min(ndcBottom * sliceNear, ndcBottom * sliceFar) * tanHalfY;
+                bounds.max.y = std::max(ndcTop * sliceNear, ndcTop * sliceFar) * tanHalfY;
+                bounds.min.z = -sliceFar;
+                bounds.max.z = -sliceNear;
+            }
+        }
+    }
+}
+
+unsigned LightClusters::sliceOf(float depth) const
+{
+    if (depth <= m_near)
+        return 0;
+    unsigned slice = (unsigned)(std::log(depth / m_near) / std::log(m_far / m_near) * SLICES);
+    return std::min(slice, SLICES - 1);
+}
+
+void LightClusters::binSlice(unsigned slice)
+{
+    const std::vector<unsigned> &candidates = m_sliceLights[slice];
+
+    //gather the candidates, padded to a multiple of four with lights that hit nothing
+    size_t paddedCount = (candidates.size() + 3) & ~size_t(3);
+    std::vector<float> xs(paddedCount, 1e30f), ys(paddedCount, 0.0f), zs(paddedCount, 0.0f), radii(paddedCount, 0.0f);
+    for (size_t k = 0; k < candidates.size(); k++)
+    {
+        unsigned id = candidates[k];
+        xs[k] = m_lightX[id];
+        ys[k] = m_lightY[id];
+        zs[k] = m_lightZ[id];
+        radii[k] = m_lightRadius[id] * m_lightRadius[id];
+    }
+
+    for (unsigned tile = 0; tile < TILES_X * TILES_Y; tile++)
+    {
+        unsigned cluster = tile + TILES_X * TILES_Y * slice;
+        const ClusterBounds &bounds = m_bounds[cluster];
+        GLuint* clusterLights = &m_clusterLights[cluster * MAX_LIGHTS_PER_CLUSTER];
+        unsigned count = 0;
+
+        //sphere against box: squared distance from the center to the box within the squared radius
+#ifdef MAKAI_CLUSTERS_SSE
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 minX = _mm_set1_ps(bounds.min.x), maxX = _mm_set1_ps(bounds.max.x);
+        const __m128 minY = _mm_set1_ps(bounds.min.y), maxY = _mm_set1_ps(bounds.max.y);
+        const __m128 minZ = _mm_set1_ps(bounds.min.z), maxZ = _mm_set1_ps(bounds.max.z);
+        for (size_t k = 0; k < paddedCount && count < MAX_LIGHTS_PER_CLUSTER; k += 4)
+        {
+            __m128 x = _mm_loadu_ps(&xs[k]);
+            __m128 y = _mm_loadu_ps(&ys[k]);
+            __m128 z = _mm_loadu_ps(&zs[k]);
+            __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, x), _mm_sub_ps(x, maxX)), zero);
+            __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, y), _mm_sub_ps(y, maxY)), zero);
+            __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, z), _mm_sub_ps(z, maxZ)), zero);
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            int hits = _mm_movemask_ps(_mm_cmple_ps(distance, _mm_loadu_ps(&radii[k])));
+            for (int lane = 0; hits != 0 && lane < 4; lane++)
+            {
+                if ((hits & (1 << lane)) && count < MAX_LIGHTS_PER_CLUSTER)
+                    clusterLights[count++] = candidates[k + lane];
+                hits &= ~(1 << lane);
+            }
+        }
+#else
+        for (size_t k = 0; k < candidates.size() && count < MAX_LIGHTS_PER_CLUSTER; k++)
+        {
+            float dx = std::max(std::max(bounds.min.x - xs[k], xs[k] - bounds.max.x), 0.0f);
+            float dy = std::max(std::max(bounds.min.y - ys[k], ys[k] - bounds.max.y), 0.0f);
+            float dz = std::max(std::max(bounds.min.z - zs[k], zs[k] - bounds.max.z), 0.0f);
+            if (dx * dx + dy * dy + dz * dz <= radii[k])
+                clusterLights[count++] = candidates[k];
+        }
+#endif
+        m_clusterCounts[cluster] = count;
+    }
+}
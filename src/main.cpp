@@ -1,14 +1,68 @@
 #include "mainwindow.h"
+#include "texturecache.h"
+#include "tracer.h"
+#include "renderstats.h"
 #include <QApplication>
 #include <QSurfaceFormat>
+#include <QStandardPaths>
+#include <QDir>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
 
+    // a debug context makes the driver report everything through KHR_debug,
+    // ask for one in debug builds or when started with --gl-debug
+    bool debugContext = a.arguments().contains("--gl-debug");
+#ifdef _DEBUG
+    debugContext = true;
+#endif
+    if (debugContext) {
+        QSurfaceFormat format = QSurfaceFormat::defaultFormat();
+        format.setOption(QSurfaceFormat::DebugContext);
+        QSurfaceFormat::setDefaultFormat(format);
+    }
+
+    // linked shader programs are cached between runs, --no-shader-cache builds them from source
+    if (!a.arguments().contains("--no-shader-cache")) {
+        QString shaderCache = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/shaders";
+        if (QDir().mkpath(shaderCache))
+            makai::ShaderProgram::setBinaryCacheDirectory(shaderCache.toStdString());
+    }
+
+    // textures are block-compressed on import and the results cached,
+    // --no-texture-compression uploads them uncompressed as before to compare load time and VRAM
+    if (a.arguments().contains("--no-texture-compression")) {
+        makai::TextureCache::setEnabled(false);
+    } else {
+        QString textureCache = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/textures";
+        if (QDir().mkpath(textureCache))
+            makai::TextureCache::setDirectory(textureCache.toStdString());
+    }
+
+    // --trace file.json records from startup, through the first load, and writes the trace on exit
+    makai::Tracer::instance().setThreadName("GL thread");
+    QString traceFile;
+    int traceArgument = a.arguments().indexOf("--trace");
+    if (traceArgument >= 0 && traceArgument + 1 < a.arguments().size()) {
+        traceFile = a.arguments().at(traceArgument + 1);
+        makai::Tracer::instance().setEnabled(true);
+    }
+
+    // --stats-log file.jsonl writes the draw calls and state changes of every frame, a JSON object a line
+    int statsArgument = a.arguments().indexOf("--stats-log");
+    if (statsArgument >= 0 && statsArgument + 1 < a.arguments().size()) {
+        QString statsFile = a.arguments().at(statsArgument + 1);
+        if (!makai::RenderStats::instance().setLogFile(statsFile.toStdString()))
+            qDebug("Can't write render statistics to %s", statsFile.toLocal8Bit().constData());
+    }
+
     MainWindow w;
     w.resize(720, 720);
     w.show();
 
-    return a.exec();
+    int result = a.exec();
+    if (!traceFile.isEmpty() && !makai::Tracer::instance().write(traceFile.toStdString()))
+        qDebug("Can't write trace file %s", traceFile.toLocal8Bit().constData());
+    return result;
 }
@@ -2,6 +2,11 @@
 #include "ui_mainwindow.h"
 #include <QIcon>
 #include <QAction>
+#include <QMessageBox>
+#include <QFileDialog>
+#include <QInputDialog>
+#include "tracer.h"
+#include "memorytracker.h"
 
 MainWindow* MainWindow::instance = 0;
 
@@ -14,6 +19,10 @@ MainWindow::MainWindow(QWidget *parent) :
     setCentralWidget(ui->openGLWidget);
     createActionGroups();
     connections();
+
+    statusTimer = new QTimer(this);
+    statusTimer->start(1000);
+    connect(statusTimer, &QTimer::timeout, this, &MainWindow::updateStatusBar);
 }
 
 MainWindow::~MainWindow()
@@ -28,31 +37,50 @@ void MainWindow::createActionGroups()
     displayModeAG->addAction(ui->actionFilllines);
     displayModeAG->addAction(ui->actionWireframe);
     ui->actionFill->setChecked(true);
-    ui->openGLWidget->displayMode = OpenGLWidget::FILL;
+    ui->openGLWidget->frameRenderer().displayMode = Renderer::FILL;
 
     shadingModeAG = new QActionGroup(this);
     shadingModeAG->addAction(ui->actionGouraud);
     shadingModeAG->addAction(ui->actionPhong);
+    shadingModeAG->addAction(ui->actionDeferred);
 //    ui->actionGouraud->setChecked(true);
-//    ui->openGLWidget->shadingMode = OpenGLWidget::GOURAUD;
+//    ui->openGLWidget->frameRenderer().shadingMode = Renderer::GOURAUD;
     ui->actionPhong->setChecked(true);
-    ui->openGLWidget->shadingMode = OpenGLWidget::PHONG;
+    ui->openGLWidget->frameRenderer().shadingMode = Renderer::PHONG;
 
     flatShadingModeAG = new QActionGroup(this);
     flatShadingModeAG->addAction(ui->actionSmooth);
     flatShadingModeAG->addAction(ui->actionFlat);
 //    ui->actionFlat->setChecked(true);
-//    ui->openGLWidget->flat_flag = true;
+//    ui->openGLWidget->frameRenderer().flat_flag = true;
     ui->actionSmooth->setChecked(true);
-    ui->openGLWidget->flat_flag = false;
+    ui->openGLWidget->frameRenderer().flat_flag = false;
 
     textModeAG = new QActionGroup(this);
     textModeAG->addAction(ui->actionTexture);
     textModeAG->addAction(ui->actionColor);
 //    ui->actionColor->setChecked(true);
-//    ui->openGLWidget->textureMode = OpenGLWidget::COLOR;
+//    ui->openGLWidget->frameRenderer().textureMode = Renderer::COLOR;
     ui->actionTexture->setChecked(true);
-    ui->openGLWidget->textureMode = OpenGLWidget::TEXTURE;
+    ui->openGLWidget->frameRenderer().textureMode = Renderer::TEXTURE;
+
+    redrawPolicyAG = new QActionGroup(this);
+    redrawPolicyAG->addAction(ui->actionOnDemand);
+    redrawPolicyAG->addAction(ui->actionContinuous);
+    ui->actionOnDemand->setChecked(true);
+    ui->openGLWidget->frameScheduler().setPolicy(FrameScheduler::ONDEMAND);
+
+    pointLightsAG = new QActionGroup(this);
+    pointLightsAG->addAction(ui->actionLights1);
+    pointLightsAG->addAction(ui->actionLights100);
+    pointLightsAG->addAction(ui->actionLights1000);
+    pointLightsAG->addAction(ui->actionLights4000);
+    ui->actionLights1->setChecked(true);
+
+    ui->actionDepthPrepass->setChecked(ui->openGLWidget->frameRenderer().depthPrepass);
+    ui->actionGLValidation->setChecked(ui->openGLWidget->glValidation);
+    ui->actionDebugGroups->setChecked(ui->openGLWidget->glDebugGroups);
+    ui->actionSynchronousDebugOutput->setChecked(ui->openGLWidget->glSynchronousDebugOutput);
 }
 
 void MainWindow::connections()
@@ -62,4 +90,138 @@ void MainWindow::connections()
    connect(shadingModeAG, &QActionGroup::triggered, ui->openGLWidget, &OpenGLWidget::onShadingModeChanged);
    connect(flatShadingModeAG, &QActionGroup::triggered, ui->openGLWidget, &OpenGLWidget::onFlatShadingModeChanged);
    connect(textModeAG, &QActionGroup::triggered, ui->openGLWidget, &OpenGLWidget::onTextureModeChanged);
+   connect(redrawPolicyAG, &QActionGroup::triggered, ui->openGLWidget, &OpenGLWidget::onRedrawPolicyChanged);
+   connect(ui->actionRefineWhenIdle, &QAction::toggled, ui->openGLWidget, &OpenGLWidget::onRefineWhenIdleToggled);
+   connect(pointLightsAG, &QActionGroup::triggered, ui->openGLWidget, &OpenGLWidget::onPointLightsChanged);
+   connect(ui->actionDepthPrepass, &QAction::toggled, ui->openGLWidget, &OpenGLWidget::onDepthPrepassToggled);
+   connect(ui->actionGLValidation, &QAction::toggled, ui->openGLWidget, &OpenGLWidget::onGLValidationToggled);
+   connect(ui->actionDebugGroups, &QAction::toggled, ui->openGLWidget, &OpenGLWidget::onDebugGroupsToggled);
+   connect(ui->actionSynchronousDebugOutput, &QAction::toggled, ui->openGLWidget, &OpenGLWidget::onSynchronousDebugOutputToggled);
+   connect(ui->actionBenchmarkShading, &QAction::triggered, this, &MainWindow::runShadingBenchmark);
+   //--trace starts the program recording
+   ui->actionRecordTrace->setChecked(makai::Tracer::instance().isEnabled());
+   connect(ui->actionRecordTrace, &QAction::toggled, this, &MainWindow::onRecordTraceToggled);
+   connect(ui->actionRenderStats, &QAction::toggled, ui->openGLWidget, &OpenGLWidget::onRenderStatsToggled);
+   connect(ui->actionCaptureFrame, &QAction::triggered, this, &MainWindow::captureFrame);
+   //show a pick right away instead of with the next refresh
+   connect(ui->openGLWidget, &OpenGLWidget::objectPicked, this, [this]() { updateStatusBar(); });
+}
+
+void MainWindow::updateStatusBar()
+{
+    FrameScheduler::Statistics frames = ui->openGLWidget->frameScheduler().statistics();
+    const Renderer& renderer = ui->openGLWidget->frameRenderer();
+
+    QString status;
+    if (frames.idle)
+        status = tr("Idle");
+    else
+        status = QString("%1 fps").arg(frames.fps, 0, 'f', 1);
+    status += QString(" | CPU %1%").arg(frames.cpuPercent, 0, 'f', 1);
+    status += QString(" | %1 shaded fragments").arg(renderer.shadedFragments());
+    const LightClusters& clusters = renderer.lightClusters();
+    status += QString(" | %1 lights, binned in %2 ms").arg(clusters.pointLightCount())
+            .arg(clusters.binningMilliseconds(), 0, 'f', 2);
+    const TextureStreamer& textures = renderer.textureStreamer();
+    if (textures.arrayCount() > 0)
+        status += QString(" | textures %1/%2 MB").arg(textures.residentBytes() / 1048576.0, 0, 'f', 1)
+                .arg(textures.budget() / 1048576.0, 0, 'f', 0);
+
+    //what loaded models take, and the most they have taken
+    MemoryTracker::Totals memory = MemoryTracker::instance().totals();
+    status += QString(" | memory CPU %1 MB, GPU %2 MB (peak %3/%4 MB)").arg(memory.cpu / 1048576.0, 0, 'f', 1)
+            .arg(memory.gpu / 1048576.0, 0, 'f', 1).arg(memory.peakCpu / 1048576.0, 0, 'f', 1)
+            .arg(memory.peakGpu / 1048576.0, 0, 'f', 1);
+
+    //what the last click picked
+    const Picking::Hit& pick = ui->openGLWidget->lastPick();
+    if (pick.isHit())
+        status += QString(" | picked object %1, sub-mesh %2, triangle %3").arg(pick.objectIndex)
+                .arg(pick.subMesh).arg(pick.triangle);
+
+    Profiler::Statistics times = Profiler::instance().statistics();
+    status += QString(" | frame %1 ms, CPU %2 ms").arg(times.frame, 0, 'f', 2).arg(times.cpu, 0, 'f', 2);
+    if (Profiler::instance().hasGpuTimes())
+        status += QString(", GPU %1 ms").arg(times.gpu, 0, 'f', 2);
+
+    QString details;
+    for (int i = 0; i < MemoryTracker::RESOURCE_COUNT; i++)
+    {
+        MemoryTracker::Resource resource = (MemoryTracker::Resource)i;
+        details += QString("%1 (%2): %3 MB\n").arg(MemoryTracker::name(resource))
+                .arg(MemoryTracker::isGpu(resource) ? "GPU" : "CPU").arg(memory.bytes[i] / 1048576.0, 0, 'f', 2);
+    }
+    Mesh::MemoryUsage model = renderer.model().memoryUsage();
+    details += QString("model: geometry %1 MB, vertex buffers %2 MB, index buffers %3 MB, textures %4 MB\n")
+            .arg(model.geometry / 1048576.0, 0, 'f', 2).arg(model.vertexBuffers / 1048576.0, 0, 'f', 2)
+            .arg(model.indexBuffers / 1048576.0, 0, 'f', 2).arg(model.textures / 1048576.0, 0, 'f', 2);
+
+    //the triangle BVHs of the model, and the one over the objects
+    Bvh::Statistics triangles = renderer.model().bvhStatistics();
+    details += QString("model BVHs: %1 triangles, %2 nodes, depth %3, %4 per leaf, SAH cost %5, built in %6 ms\n")
+            .arg(triangles.primitives).arg(triangles.nodes).arg(triangles.maxDepth)
+            .arg(triangles.averageLeafSize, 0, 'f', 1).arg(triangles.sahCost, 0, 'f', 1)
+            .arg(triangles.buildMilliseconds, 0, 'f', 1);
+    Bvh::Statistics objects = renderer.sceneBvh().statistics();
+    details += QString("scene BVH: %1 objects, %2 nodes, depth %3, SAH cost %4, built in %5 ms, refit in %6 ms\n")
+            .arg(objects.primitives).arg(objects.nodes).arg(objects.maxDepth).arg(objects.sahCost, 0, 'f', 2)
+            .arg(objects.buildMilliseconds, 0, 'f', 3).arg(objects.refitMilliseconds, 0, 'f', 3);
+
+    //the zones of a frame, only compiled into profiling builds
+    QString zones;
+    for (const Profiler::Zone& zone : Profiler::instance().zones())
+    {
+        zones += QString("%1%2: CPU %3 ms").arg(QString(zone.depth * 2, ' ')).arg(zone.name)
+                .arg(zone.cpuMilliseconds, 0, 'f', 3);
+        if (zone.gpuMilliseconds >= 0.0)
+            zones += QString(", GPU %1 ms").arg(zone.gpuMilliseconds, 0, 'f', 3);
+        zones += "\n";
+    }
+    ui->statusBar->setToolTip((details + zones).trimmed());
+
+    ui->statusBar->showMessage(status);
+}
+
+void MainWindow::runShadingBenchmark()
+{
+    QString report = ui->openGLWidget->benchmarkShading();
+    QMessageBox::information(this, tr("Shading Benchmark"), report);
+}
+
+void MainWindow::onRecordTraceToggled(bool checked)
+{
+    makai::Tracer& tracer = makai::Tracer::instance();
+    tracer.setEnabled(checked);
+    if (checked)
+        return;
+
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Save Trace"), QDir::currentPath() + "/trace.json",
+                                                    tr("Chrome Trace (*.json)"));
+    if (fileName.isEmpty())
+        return;
+    if (!tracer.write(fileName.toStdString()))
+        QMessageBox::warning(this, tr("Save Trace"), tr("Can't write %1").arg(fileName));
+}
+
+void MainWindow::captureFrame()
+{
+    //in the order of FrameCapture::Geometry
+    QStringList geometries;
+    geometries << tr("Reference the model file")
+               << tr("Embed the geometry")
+               << tr("Embed anonymized geometry");
+    bool ok = false;
+    QString geometry = QInputDialog::getItem(this, tr("Capture Frame"), tr("Model:"), geometries, 0, false, &ok);
+    if (!ok)
+        return;
+
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Capture Frame"), QDir::currentPath() + "/frame.mkfc",
+                                                    tr("Frame Capture (*.mkfc)"));
+    if (fileName.isEmpty())
+        return;
+
+    FrameCapture capture = ui->openGLWidget->frameRenderer()
+            .captureFrame((FrameCapture::Geometry)geometries.indexOf(geometry));
+    if (!capture.save(fileName.toStdString()))
+        QMessageBox::warning(this, tr("Capture Frame"), tr("Can't write %1").arg(fileName));
 }
@@ -1,5 +1,13 @@
 #include "makaidebug.h"
 
+using namespace makai;
+
+bool GLDebug::s_supported = false;
+bool GLDebug::s_enabled = false;
+bool GLDebug::s_synchronous = false;
+bool GLDebug::s_debugGroups = false;
+GLenum GLDebug::s_minimumSeverity = GL_DEBUG_SEVERITY_LOW;
+
 void makai::CheckOpenGLError(const char* stmt, const char* fname, int line)
 {
     GLenum err = glGetError();
@@ -8,3 +16,139 @@ void makai::CheckOpenGLError(const char* stmt, const char* fname, int line)
         qDebug("OpenGL error %08x, at %s:%i - for %s\n", err, fname, line, stmt);
     }
 }
+
+static const char* debugSourceName(GLenum source)
+{
+    switch (source)
+    {
+    case GL_DEBUG_SOURCE_API:             return "API";
+    case GL_DEBUG_SOURCE_WINDOW_SYSTEM:   return "Window System";
+    case GL_DEBUG_SOURCE_SHADER_COMPILER: return "Shader Compiler";
+    case GL_DEBUG_SOURCE_THIRD_PARTY:     return "Third Party";
+    case GL_DEBUG_SOURCE_APPLICATION:     return "Application";
+    default:                              return "Other";
+    }
+}
+
+static const char* debugTypeName(GLenum type)
+{
+    switch (type)
+    {
+    case GL_DEBUG_TYPE_ERROR:               return "Error";
+    case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "Deprecated Behaviour";
+    case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:  return "Undefined Behaviour";
+    case GL_DEBUG_TYPE_PORTABILITY:         return "Portability";
+    case GL_DEBUG_TYPE_PERFORMANCE:         return "Performance";
+    case GL_DEBUG_TYPE_MARKER:              return "Marker";
+    case GL_DEBUG_TYPE_PUSH_GROUP:          return "Push Group";
+    case GL_DEBUG_TYPE_POP_GROUP:           return "Pop Group";
+    default:                                return "Other";
+    }
+}
+
+static const char* debugSeverityName(GLenum severity)
+{
+    switch (severity)
+    {
+    case GL_DEBUG_SEVERITY_HIGH:         return "high";
+    case GL_DEBUG_SEVERITY_MEDIUM:       return "medium";
+    case GL_DEBUG_SEVERITY_LOW:          return "low";
+    case GL_DEBUG_SEVERITY_NOTIFICATION: return "notification";
+    default:                             return "unknown";
+    }
+}
+
+static void GLAPIENTRY debugMessageCallback(GLenum source, GLenum type, GLuint id, GLenum severity,
+                                            GLsizei length, const GLchar* message, const void* userParam)
+{
+    (void)length;
+    (void)userParam;
+    qDebug("OpenGL %s [%s, %s] %u: %s", debugTypeName(type), debugSourceName(source),
+           debugSeverityName(severity), id, message);
+}
+
+void GLDebug::initialize()
+{
+    s_supported = GLEW_KHR_debug || GLEW_VERSION_4_3;
+    if (s_supported)
+    {
+        // the callback stays installed, switching validation only toggles GL_DEBUG_OUTPUT
+        glDebugMessageCallback(debugMessageCallback, nullptr);
+        applySeverityFilter();
+    }
+    setEnabled(s_enabled);
+}
+
+void GLDebug::setEnabled(bool enabled)
+{
+    s_enabled = enabled;
+    if (!s_supported)
+        return;
+
+    if (s_enabled)
+        glEnable(GL_DEBUG_OUTPUT);
+    else
+        glDisable(GL_DEBUG_OUTPUT);
+    setSynchronous(s_synchronous);
+}
+
+void GLDebug::setSynchronous(bool synchronous)
+{
+    s_synchronous = synchronous;
+    if (!s_supported)
+        return;
+
+    if (s_enabled && s_synchronous)
+        glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    else
+        glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+}
+
+void GLDebug::setMinimumSeverity(GLenum severity)
+{
+    s_minimumSeverity = severity;
+    if (s_supported)
+        applySeverityFilter();
+}
+
+void GLDebug::applySeverityFilter()
+{
+    // ordered from most to least severe
+    const GLenum severities[] = {
+        GL_DEBUG_SEVERITY_HIGH,
+        GL_DEBUG_SEVERITY_MEDIUM,
+        GL_DEBUG_SEVERITY_LOW,
+        GL_DEBUG_SEVERITY_NOTIFICATION
+    };
+
+    bool enabled = true;
+    for (GLenum severity : severities)
+    {
+        glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, severity, 0, nullptr, enabled ? GL_TRUE : GL_FALSE);
+        if (severity == s_minimumSeverity)
+            enabled = false;
+    }
+}
+
+void GLDebug::setDebugGroupsEnabled(bool enabled)
+{
+    s_debugGroups = enabled;
+}
+
+void GLDebug::pushGroup(const char* name)
+{
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+}
+
+void GLDebug::popGroup()
+{
+    glPopDebugGroup();
+}
+
+void GLDebug::setObjectLabel(GLenum identifier, GLuint name, const std::string &label)
+{
+    if (!s_enabled || !s_supported || name == 0)
+        return;
+
+    glObjectLabel(identifier, name, (GLsizei)label.size(), label.c_str());
+}
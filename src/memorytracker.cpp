@@ -0,0 +1,86 @@
+#include "memorytracker.h"
+
+using namespace makai;
+
+static void raiseTo(std::atomic<size_t> &peak, size_t value)
+{
+    size_t current = peak.load(std::memory_order_relaxed);
+    while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+MemoryTracker::MemoryTracker() : m_cpu(0), m_gpu(0), m_peakCpu(0), m_peakGpu(0)
+{
+    for (std::atomic<size_t>& bytes : m_bytes)
+        bytes.store(0, std::memory_order_relaxed);
+}
+
+MemoryTracker &MemoryTracker::instance()
+{
+    static MemoryTracker tracker;
+    return tracker;
+}
+
+bool MemoryTracker::isGpu(Resource resource)
+{
+    return resource == VERTEX_BUFFERS || resource == INDEX_BUFFERS || resource == TEXTURES;
+}
+
+const char *MemoryTracker::name(Resource resource)
+{
+    switch (resource)
+    {
+    case GEOMETRY: return "geometry";
+    case TEXTURE_STAGING: return "texture staging";
+    case VERTEX_BUFFERS: return "vertex buffers";
+    case INDEX_BUFFERS: return "index buffers";
+    case TEXTURES: return "textures";
+    default: return "";
+    }
+}
+
+void MemoryTracker::allocate(Resource resource, size_t bytes)
+{
+    if (bytes == 0)
+        return;
+    m_bytes[resource].fetch_add(bytes, std::memory_order_relaxed);
+    if (isGpu(resource))
+        raiseTo(m_peakGpu, m_gpu.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+    else
+        raiseTo(m_peakCpu, m_cpu.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+}
+
+void MemoryTracker::release(Resource resource, size_t bytes)
+{
+    if (bytes == 0)
+        return;
+    m_bytes[resource].fetch_sub(bytes, std::memory_order_relaxed);
+    (isGpu(resource) ? m_gpu : m_cpu).fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+void MemoryTracker::resize(Resource resource, size_t oldBytes, size_t newBytes)
+{
+    if (newBytes > oldBytes)
+        allocate(resource, newBytes - oldBytes);
+    else
+        release(resource, oldBytes - newBytes);
+}
+
+MemoryTracker::Totals MemoryTracker::totals() const
+{
+    Totals totals;
+    for (int i = 0; i < RESOURCE_COUNT; i++)
+        totals.bytes[i] = m_bytes[i].load(std::memory_order_relaxed);
+    totals.cpu = m_cpu.load(std::memory_order_relaxed);
+    totals.gpu = m_gpu.load(std::memory_order_relaxed);
+    totals.peakCpu = m_peakCpu.load(std::memory_order_relaxed);
+    totals.peakGpu = m_peakGpu.load(std::memory_order_relaxed);
+    return totals;
+}
+
+void MemoryTracker::resetPeaks()
+{
+    m_peakCpu.store(m_cpu.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_peakGpu.store(m_gpu.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
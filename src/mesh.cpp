@@ -1,12 +1,29 @@
 #include "mesh.h"
+#include "texturecache.h"
+#include "texturestreamer.h"
+#include "threadpool.h"
+#include "tracer.h"
+#include "memorytracker.h"
+#include "renderstats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <tuple>
 
 using namespace makai;
 
-Mesh::Mesh() : m_meshes(), directoryOfTex(), m_textures()
+Mesh::TextureArrayPolicy Mesh::s_textureArrayPolicy = Mesh::RESIZE;
+
+Mesh::Mesh() : m_name(), m_meshes(), directoryOfTex(), m_textures(), m_textureArrays(),
+    m_streamer(nullptr), m_boundingCenter(0.0f), m_boundingRadius(0.0f), m_bvhs(), m_sceneGraph(),
+    m_subMeshNodes(), m_bvhStatistics()
 {
     typeMap = std::map<int, int>();
     typeMap.insert(std::pair<int, int>(aiTextureType_DIFFUSE, TextureType::diffuse));
     typeMap.insert(std::pair<int, int>(aiTextureType_SPECULAR, TextureType::specular));
+    typeMap.insert(std::pair<int, int>(aiTextureType_NORMALS, TextureType::normal));
 }
 
 Mesh::~Mesh()
@@ -16,29 +33,55 @@ Mesh::~Mesh()
 
 bool Mesh::loadModelFromFile(const std::string &path)
 {
+    TRACE_SCOPE_DETAIL("Mesh::loadModelFromFile", path.c_str());
     // Read file via ASSIMP
     Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate |
-                                                   aiProcess_FlipUVs     |
-                                                   aiProcess_GenNormals);
+    const aiScene* scene;
+    {
+        TRACE_SCOPE("Assimp::Importer::ReadFile");
+        scene = importer.ReadFile(path, aiProcess_Triangulate |
+                                        aiProcess_FlipUVs     |
+                                        aiProcess_GenNormals);
+    }
+    // Retrieve the directory path of the filepath
+    if (!loadModelFromScene(scene, path.substr(0, path.find_last_of('/'))))
+        return false;
+    m_name = path;
+
+    // We're done. Everything will be cleaned up by the importer destructor
+    return true;
+}
+
+bool Mesh::loadModelFromScene(const aiScene *scene, const std::string &directory)
+{
     // Check for errors
     if(!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
     {
         return false;
     }
-    // Retrieve the directory path of the filepath
-    directoryOfTex = path.substr(0, path.find_last_of('/'));
+    directoryOfTex = directory;
 
     // Process ASSIMP's root node recursively
-    this->processNode(scene->mRootNode, scene);
-
-    // We're done. Everything will be cleaned up by the importer destructor
+    TRACE_SCOPE("Mesh::processNode");
+    this->processNode(scene->mRootNode, scene, -1);
     return true;
 }
 
-void Mesh::addSubMesh(const SubMesh &subMesh)
+std::string Mesh::name() const
+{
+    return m_name;
+}
+
+void Mesh::setName(const std::string &name)
+{
+    m_name = name;
+}
+
+void Mesh::addSubMesh(const SubMesh &subMesh, int node)
 {
     m_meshes.push_back(subMesh);
+    m_subMeshNodes.push_back(node >= 0 && node < (int)m_sceneGraph.nodeCount() ? node : -1);
+    MemoryTracker::instance().allocate(MemoryTracker::GEOMETRY, m_meshes.back().cpuBytes());
 }
 
 void Mesh::addTexture(const Texture &texture)
@@ -46,78 +89,464 @@ void Mesh::addTexture(const Texture &texture)
     m_textures.push_back(texture);
 }
 
-void Mesh::paint(ShaderProgram *shader, const std::vector<Light> &lights)
+const std::vector<SubMesh> &Mesh::subMeshes() const
+{
+    return m_meshes;
+}
+
+const std::vector<Texture> &Mesh::textures() const
 {
+    return m_textures;
+}
+
+void Mesh::setTextureArrayPolicy(TextureArrayPolicy policy)
+{
+    s_textureArrayPolicy = policy;
+}
 
-    shader->setUniform("numLights", (int)lights.size());
-    for (unsigned i = 0; i < lights.size(); i++)
+Mesh::TextureArrayPolicy Mesh::textureArrayPolicy()
+{
+    return s_textureArrayPolicy;
+}
+
+void Mesh::paint(ShaderProgram *shader, const glm::mat4 &model)
+{
+    //untextured shader variants have no samplers, skip the texture bindings
+    bool textured = shader->hasUniform("texture_diffuse1"_u) || shader->hasUniform("texture_specular1"_u);
+
+    RenderStats& stats = RenderStats::instance();
+    GLuint boundArrays[TEXTURE_TYPE_COUNT] = {};
+    Uniform layerUniforms[TEXTURE_TYPE_COUNT];
+    if (textured)
     {
-        shader->setArrayUniform("allLights", i, lights.at(i).intensity(), "intensity");
-        shader->setArrayUniform("allLights", i, lights.at(i).position(), "position");
-        shader->setArrayUniform("allLights", i, 0.01f, "attenuation");
+        shader->setUniform("texture_diffuse1"_u, (int)TextureType::diffuse);
+        shader->setUniform("texture_specular1"_u, (int)TextureType::specular);
+        layerUniforms[TextureType::diffuse] = shader->uniform("layer_diffuse1"_u);
+        layerUniforms[TextureType::specular] = shader->uniform("layer_specular1"_u);
+        if (shader->hasUniform("texture_normal1"_u))
+        {
+            shader->setUniform("texture_normal1"_u, (int)TextureType::normal);
+            layerUniforms[TextureType::normal] = shader->uniform("layer_normal1"_u);
+        }
     }
 
+    //the sub-meshes of a node are next to each other, the matrix only changes with the node
+    const Uniform modelUniform = shader->uniform("model"_u);
+    int currentNode = -2;
     for (size_t i = 0; i < m_meshes.size(); i++)
     {
-        // Bind appropriate textures
-        for(GLuint j = 0; j < m_meshes.at(i).texIndices.size(); j++)
+        const int node = m_subMeshNodes.at(i);
+        if (node != currentNode)
+        {
+            shader->setUniform(modelUniform, node >= 0 ? model * m_sceneGraph.worldTransform(node) : model);
+            currentNode = node;
+        }
+
+        if (textured)
         {
-            GLuint index = m_meshes.at(i).texIndices.at(j);
-            // Active proper texture unit before binding
-            GL_CHECK ( glActiveTexture(GL_TEXTURE0 + j) );
-
-            // Retrieve texture number (the N in diffuse_textureN)
-            // here, i assume N is always 1
-            std::string nameAttr;
-            if (m_textures.at(index).type == TextureType::diffuse)
-                nameAttr = "texture_diffuse1";
-            else if (m_textures.at(index).type == TextureType::specular)
-                nameAttr = "texture_specular1";
-
-            shader->setUniform(nameAttr.c_str(), (int)j);
-
-            // And finally bind the texture
-            GL_CHECK ( glBindTexture(GL_TEXTURE_2D, m_textures.at(index).objectId) );
+            // -1 tells the shader the sub-mesh has no map of that type
+            GLint layers[TEXTURE_TYPE_COUNT] = { -1, -1, -1 };
+            for (GLuint index : m_meshes.at(i).texIndices)
+            {
+                const Texture& t = m_textures.at(index);
+                // only the first map of each type is used, the shaders have one sampler per type
+                if (t.layer < 0 || layers[t.type] >= 0)
+                    continue;
+                layers[t.type] = t.layer;
+
+                // most sub-meshes of a model share their arrays, only a change of array costs a bind
+                if (boundArrays[t.type] != t.objectId)
+                {
+                    GL_CHECK( glActiveTexture(GL_TEXTURE0 + t.type) );
+                    GL_CHECK( glBindTexture(GL_TEXTURE_2D_ARRAY, t.objectId) );
+                    stats.countTextureBind();
+                    boundArrays[t.type] = t.objectId;
+                }
+            }
+            for (unsigned type = 0; type < TEXTURE_TYPE_COUNT; type++)
+                shader->setUniform(layerUniforms[type], layers[type]);
         }
 
         GL_CHECK( glBindVertexArray(m_meshes.at(i).VAO) );
         GL_CHECK( glDrawElements(GL_TRIANGLES, m_meshes.at(i).indices.size(), GL_UNSIGNED_INT, 0) );
-        GL_CHECK( glBindVertexArray(0) );
+        stats.countVaoBind();
+        stats.countDraw(GL_TRIANGLES, m_meshes.at(i).indices.size());
+    }
+    GL_CHECK( glBindVertexArray(0) );
+    stats.countVaoBind();
+
+    // Always good practice to set everything back to defaults once configured.
+    for (unsigned type = 0; type < TEXTURE_TYPE_COUNT; type++)
+    {
+        if (boundArrays[type] == 0)
+            continue;
+        GL_CHECK( glActiveTexture(GL_TEXTURE0 + type) );
+        GL_CHECK( glBindTexture(GL_TEXTURE_2D_ARRAY, 0) );
+        stats.countTextureBind();
+    }
+    GL_CHECK( glActiveTexture(GL_TEXTURE0) );
+}
 
-        // Always good practice to set everything back to defaults once configured.
-        for (GLuint j = 0; j < m_meshes.at(i).texIndices.size(); j++)
+void Mesh::paintDepth(ShaderProgram *shader, const glm::mat4 &model)
+{
+    RenderStats& stats = RenderStats::instance();
+    const Uniform modelUniform = shader->uniform("model"_u);
+    int currentNode = -2;
+    for (size_t i = 0; i < m_meshes.size(); i++)
+    {
+        const int node = m_subMeshNodes.at(i);
+        if (node != currentNode)
         {
-            GL_CHECK( glActiveTexture(GL_TEXTURE0 + j) );
-            GL_CHECK( glBindTexture(GL_TEXTURE_2D, 0) );
+            shader->setUniform(modelUniform, node >= 0 ? model * m_sceneGraph.worldTransform(node) : model);
+            currentNode = node;
         }
-        // always good practice to set everything back to defaults once configured.
-        //GL_CHECK( glActiveTexture(GL_TEXTURE0) );
-
+        GL_CHECK( glBindVertexArray(m_meshes.at(i).depthVAO) );
+        GL_CHECK( glDrawElements(GL_TRIANGLES, m_meshes.at(i).indices.size(), GL_UNSIGNED_INT, 0) );
+        stats.countVaoBind();
+        stats.countDraw(GL_TRIANGLES, m_meshes.at(i).indices.size());
     }
+    GL_CHECK( glBindVertexArray(0) );
+    stats.countVaoBind();
 }
 
-void Mesh::genBuffers()
+void Mesh::genBuffers(TextureStreamer *streamer)
 {
+    TRACE_SCOPE_DETAIL("Mesh::genBuffers", m_name.c_str());
+    m_streamer = streamer;
     for (size_t i = 0; i < m_meshes.size(); i++) {
-        genVertexBuffers(m_meshes.at(i));
+        genVertexBuffers(m_meshes.at(i), m_name + " submesh " + std::to_string(i));
+    }
+    computeBounds();
+    buildBvhs();
+    genTextures();
+}
+
+glm::vec3 Mesh::boundingCenter() const
+{
+    return m_boundingCenter;
+}
+
+float Mesh::boundingRadius() const
+{
+    return m_boundingRadius;
+}
+
+Aabb Mesh::bounds() const
+{
+    Aabb box;
+    for (size_t i = 0; i < m_bvhs.size(); i++)
+        box.grow(m_subMeshNodes.at(i) >= 0 ? m_bvhs[i].bounds().transformed(subMeshTransform(i)) : m_bvhs[i].bounds());
+    return box;
+}
+
+SceneGraph &Mesh::sceneGraph()
+{
+    return m_sceneGraph;
+}
+
+const SceneGraph &Mesh::sceneGraph() const
+{
+    return m_sceneGraph;
+}
+
+glm::mat4 Mesh::subMeshTransform(size_t subMesh) const
+{
+    const int node = m_subMeshNodes.at(subMesh);
+    return node >= 0 ? m_sceneGraph.worldTransform(node) : glm::mat4(1.0f);
+}
+
+uint64_t Mesh::boundsRevision() const
+{
+    return m_bvhRevision + m_sceneGraph.revision();
+}
+
+const std::vector<Bvh> &Mesh::bvhs() const
+{
+    return m_bvhs;
+}
+
+Bvh::Statistics Mesh::bvhStatistics() const
+{
+    return m_bvhStatistics;
+}
+
+Mesh::MemoryUsage Mesh::memoryUsage() const
+{
+    MemoryUsage usage = { 0, 0, 0, 0 };
+    for (const Bvh& bvh : m_bvhs)
+        usage.geometry += bvh.byteSize();
+    for (const SubMesh& mesh : m_meshes)
+    {
+        usage.geometry += mesh.cpuBytes();
+        if (mesh.VAO != 0)
+        {
+            usage.vertexBuffers += mesh.vertexBufferBytes();
+            usage.indexBuffers += mesh.indexBufferBytes();
+        }
+    }
+    for (const TextureArray& array : m_textureArrays)
+        usage.textures += array.bytes + (m_streamer ? m_streamer->residentBytes(array.texture) : 0);
+    return usage;
+}
+
+void Mesh::requestTextureDetail(TextureStreamer &streamer, float pixelDiameter) const
+{
+    for (const TextureArray& array : m_textureArrays)
+    {
+        // level 0 is sharp when a texel covers a pixel, every level down halves that
+        float texels = (float)std::max(array.width, array.height);
+        streamer.request(array.texture, std::log2(texels / std::max(pixelDiameter, 1.0f)));
+    }
+}
+
+void Mesh::computeBounds()
+{
+    //in model space, with the nodes where they are now
+    m_sceneGraph.updateWorldTransforms();
+    auto position = [this](size_t subMesh, size_t i) {
+        const SubMesh& mesh = m_meshes[subMesh];
+        glm::vec3 p(mesh.vertices[i], mesh.vertices[i + 1], mesh.vertices[i + 2]);
+        const int node = m_subMeshNodes[subMesh];
+        return node >= 0 ? glm::vec3(m_sceneGraph.worldTransform(node) * glm::vec4(p, 1.0f)) : p;
+    };
+
+    glm::vec3 low(std::numeric_limits<float>::max()), high(-std::numeric_limits<float>::max());
+    for (size_t subMesh = 0; subMesh < m_meshes.size(); subMesh++)
+    {
+        const SubMesh& mesh = m_meshes[subMesh];
+        for (size_t i = 0; i + 2 < mesh.vertices.size(); i += mesh.step)
+        {
+            low = glm::min(low, position(subMesh, i));
+            high = glm::max(high, position(subMesh, i));
+        }
+    }
+    if (low.x > high.x)
+    {
+        m_boundingCenter = glm::vec3(0.0f);
+        m_boundingRadius = 0.0f;
+        return;
+    }
+
+    m_boundingCenter = (low + high) * 0.5f;
+    float radius2 = 0.0f;
+    for (size_t subMesh = 0; subMesh < m_meshes.size(); subMesh++)
+    {
+        const SubMesh& mesh = m_meshes[subMesh];
+        for (size_t i = 0; i + 2 < mesh.vertices.size(); i += mesh.step)
+        {
+            glm::vec3 offset = position(subMesh, i) - m_boundingCenter;
+            radius2 = std::max(radius2, glm::dot(offset, offset));
+        }
+    }
+    m_boundingRadius = std::sqrt(radius2);
+}
+
+void Mesh::buildBvhs()
+{
+    TRACE_SCOPE_DETAIL("Mesh::buildBvhs", m_name.c_str());
+    for (const Bvh& bvh : m_bvhs)
+        MemoryTracker::instance().release(MemoryTracker::GEOMETRY, bvh.byteSize());
+    m_bvhs.assign(m_meshes.size(), Bvh());
+    m_bvhRevision++;
+
+    //big sub-meshes build on the pool themselves, small ones keep the other threads busy meanwhile
+    auto start = std::chrono::steady_clock::now();
+    ThreadPool::instance().parallelFor(0, m_meshes.size(), 1, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++)
+            m_bvhs[i].buildTriangles(m_meshes[i].vertices, m_meshes[i].step, m_meshes[i].indices);
+    });
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    Bvh::Statistics total;
+    double weightedCost = 0.0;
+    size_t bytes = 0;
+    for (const Bvh& bvh : m_bvhs)
+    {
+        Bvh::Statistics statistics = bvh.statistics();
+        total.primitives += statistics.primitives;
+        total.nodes += statistics.nodes;
+        total.leaves += statistics.leaves;
+        total.maxDepth = std::max(total.maxDepth, statistics.maxDepth);
+        weightedCost += statistics.sahCost * statistics.primitives;
+        bytes += bvh.byteSize();
+    }
+    total.averageLeafSize = total.leaves > 0 ? (double)total.primitives / total.leaves : 0.0;
+    total.sahCost = total.primitives > 0 ? weightedCost / total.primitives : 0.0;
+    total.buildMilliseconds = ms;
+    m_bvhStatistics = total;
+    MemoryTracker::instance().allocate(MemoryTracker::GEOMETRY, bytes);
+
+    if (total.primitives > 0)
+        qDebug("%s: BVHs over %zu triangles in %.1f ms, %zu nodes, depth %d, %.1f triangles per leaf, SAH cost %.1f, %.1f MB",
+               m_name.c_str(), total.primitives, ms, total.nodes, total.maxDepth, total.averageLeafSize,
+               total.sahCost, bytes / 1048576.0);
+}
+
+void Mesh::genTextures()
+{
+    if (m_textures.empty())
+        return;
+    TRACE_SCOPE("Mesh::genTextures");
+
+    auto start = std::chrono::steady_clock::now();
+    const size_t count = m_textures.size();
+    // with a streamer, the fine levels of cached textures stay on disk until the widget asks for them
+    const int maxLevelSize = m_streamer ? TextureStreamer::INITIAL_LEVEL_SIZE : 0;
+
+    // reading and encoding run on the pool, only the uploads need this thread
+    std::vector<TextureData> data(count);
+    std::vector<char> loaded(count, 0);
+    std::vector<std::pair<int, int>> sizes(count, std::make_pair(0, 0));
+    auto load = [&](const std::vector<size_t>& which) {
+        ThreadPool::instance().parallelFor(0, which.size(), 1, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+            {
+                const Texture& t = m_textures[which[i]];
+                TextureCache::Usage usage = t.type == TextureType::normal ? TextureCache::NORMAL : TextureCache::COLOR;
+                loaded[which[i]] = TextureCache::load(t.fileName, usage, data[which[i]],
+                                                      sizes[which[i]].first, sizes[which[i]].second, maxLevelSize);
+            }
+        });
+    };
+    std::vector<size_t> all(count);
+    for (size_t i = 0; i < count; i++)
+        all[i] = i;
+    load(all);
+
+    // the loaded levels stay in memory until the uploads are done
+    auto stagingBytes = [&]() {
+        size_t bytes = 0;
+        for (const TextureData& texture : data)
+            bytes += texture.byteSize();
+        return bytes;
+    };
+    size_t staging = stagingBytes();
+    MemoryTracker::instance().allocate(MemoryTracker::TEXTURE_STAGING, staging);
+
+    if (s_textureArrayPolicy == RESIZE)
+    {
+        // per format, the size most textures have wins, ties go to the larger one
+        std::map<GLenum, std::map<std::pair<int, int>, int>> sizeCounts;
+        for (size_t i = 0; i < count; i++)
+            if (loaded[i])
+                sizeCounts[data[i].internalFormat][std::make_pair(data[i].width, data[i].height)]++;
+
+        std::vector<size_t> resized;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!loaded[i])
+                continue;
+            std::pair<int, int> best(0, 0);
+            int bestCount = 0;
+            for (const auto& size : sizeCounts[data[i].internalFormat])
+            {
+                if (size.second > bestCount ||
+                    (size.second == bestCount && size.first.first * size.first.second > best.first * best.second))
+                {
+                    best = size.first;
+                    bestCount = size.second;
+                }
+            }
+            if (best != std::make_pair(data[i].width, data[i].height))
+            {
+                sizes[i] = best;
+                resized.push_back(i);
+            }
+        }
+        load(resized);
+        size_t resizedStaging = stagingBytes();
+        MemoryTracker::instance().resize(MemoryTracker::TEXTURE_STAGING, staging, resizedStaging);
+        staging = resizedStaging;
     }
-    for (auto& t : m_textures) {
-        t.objectId = textureFromFile(t.fileName);
+
+    // one array per format and size, each texture is a layer of one
+    std::map<std::tuple<GLenum, int, int>, std::vector<size_t>> groups;
+    for (size_t i = 0; i < count; i++)
+    {
+        m_textures[i].objectId = 0;
+        m_textures[i].layer = -1;
+        if (loaded[i])
+            groups[std::make_tuple(data[i].internalFormat, data[i].width, data[i].height)].push_back(i);
+        else
+            qDebug() << "Can't load texture" << m_textures[i].fileName.c_str();
     }
+
+    size_t videoMemory = 0, uncompressedMemory = 0;
+    int streamed = 0;
+    for (const auto& group : groups)
+    {
+        std::vector<const TextureData*> layers;
+        for (size_t i : group.second)
+            layers.push_back(&data[i]);
+
+        // uncompressed and uncached layers have all their levels already, there's nothing to stream
+        std::vector<std::string> layerFiles;
+        for (size_t i : group.second)
+            if (!data[i].cacheFile.empty() && data[i].internalFormat != GL_RGBA8)
+                layerFiles.push_back(data[i].cacheFile);
+        const bool streamable = m_streamer && layerFiles.size() == group.second.size();
+
+        const TextureData& first = data[group.second.front()];
+        GLuint array = TextureCache::uploadArray(layers, m_name + " textures " + std::to_string(first.width) +
+                                                         "x" + std::to_string(first.height), streamable);
+        size_t arrayBytes = 0;
+        for (const TextureData* layer : layers)
+            arrayBytes += layer->byteSize();
+        m_textureArrays.push_back({ array, first.width, first.height, streamable ? 0 : arrayBytes });
+        MemoryTracker::instance().allocate(MemoryTracker::TEXTURES, m_textureArrays.back().bytes);
+
+        if (streamable)
+        {
+            m_streamer->add(array, first.internalFormat, first.width, first.height,
+                            (int)first.levels.size(), first.baseLevel(), layerFiles);
+            streamed++;
+        }
+
+        for (size_t layer = 0; layer < group.second.size(); layer++)
+        {
+            Texture& t = m_textures[group.second[layer]];
+            t.objectId = array;
+            t.layer = (GLint)layer;
+            videoMemory += data[group.second[layer]].byteSize();
+            // RGBA8 with a mip chain, what the texture takes with compression off
+            uncompressedMemory += (size_t)first.width * first.height * 4 * 4 / 3;
+        }
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    qDebug("%s: %d textures in %d arrays (%d streamed) in %.0f ms, %.1f MB of VRAM (%.1f MB uncompressed)%s",
+           m_name.c_str(), (int)count, (int)m_textureArrays.size(), streamed, ms, videoMemory / 1048576.0,
+           uncompressedMemory / 1048576.0, TextureCache::isEnabled() ? "" : ", compression off");
+    MemoryTracker::instance().release(MemoryTracker::TEXTURE_STAGING, staging);
 }
 
 void Mesh::deleteBuffers()
 {
 
     for (size_t i = 0; i < m_meshes.size(); i++) {
-        GL_CHECK (glDeleteBuffersARB(1, &(m_meshes.at(i).VBO)) );
-        GL_CHECK (glDeleteBuffersARB(1, &(m_meshes.at(i).EBO)) );
-        GL_CHECK (glDeleteVertexArrays(1, &(m_meshes.at(i).VAO)) );
+        SubMesh& mesh = m_meshes.at(i);
+        //never uploaded, there may not even be a context
+        if (mesh.VAO == 0)
+            continue;
+        MemoryTracker::instance().release(MemoryTracker::VERTEX_BUFFERS, mesh.vertexBufferBytes());
+        MemoryTracker::instance().release(MemoryTracker::INDEX_BUFFERS, mesh.indexBufferBytes());
+        GL_CHECK (glDeleteBuffersARB(1, &mesh.VBO) );
+        GL_CHECK (glDeleteBuffersARB(1, &mesh.EBO) );
+        GL_CHECK (glDeleteVertexArrays(1, &mesh.VAO) );
+        GL_CHECK (glDeleteBuffersARB(1, &mesh.positionVBO) );
+        GL_CHECK (glDeleteVertexArrays(1, &mesh.depthVAO) );
+        mesh.VAO = mesh.VBO = mesh.EBO = mesh.depthVAO = mesh.positionVBO = 0;
     }
 
-    for (size_t i = 0; i < m_textures.size(); i++) {
-        GL_CHECK( glDeleteTextures(1, &(m_textures.at(i).objectId)) );
+    for (const TextureArray& array : m_textureArrays)
+    {
+        if (m_streamer)
+            m_streamer->remove(array.texture);
+        GL_CHECK( glDeleteTextures(1, &array.texture) );
+        MemoryTracker::instance().release(MemoryTracker::TEXTURES, array.bytes);
     }
+    m_textureArrays.clear();
+    m_streamer = nullptr;
 
 
 
@@ -126,13 +555,22 @@ void Mesh::deleteBuffers()
 void Mesh::clear()
 {
     deleteBuffers();
+    for (const SubMesh& mesh : m_meshes)
+        MemoryTracker::instance().release(MemoryTracker::GEOMETRY, mesh.cpuBytes());
+    for (const Bvh& bvh : m_bvhs)
+        MemoryTracker::instance().release(MemoryTracker::GEOMETRY, bvh.byteSize());
     m_meshes.clear();
+    m_subMeshNodes.clear();
+    m_sceneGraph.clear();
+    m_bvhs.clear();
+    m_bvhStatistics = Bvh::Statistics();
     directoryOfTex.clear();
     m_textures.clear();
 }
 
-void Mesh::genVertexBuffers(SubMesh &mesh)
+void Mesh::genVertexBuffers(SubMesh &mesh, const std::string &label)
 {
+    TRACE_SCOPE("Mesh::genVertexBuffers");
     // Create buffers/arrays
     glGenVertexArrays(1, &mesh.VAO);
     glGenBuffers(1, &mesh.VBO);
@@ -163,66 +601,75 @@ void Mesh::genVertexBuffers(SubMesh &mesh)
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, mesh.step * sizeof(float), (GLvoid*)(sizeof(float) * 6));
 
     glBindVertexArray(0);
-}
 
-GLuint Mesh::textureFromFile(const std::string &fileName)
-{
-//    return SOIL_load_OGL_texture(fileName.c_str(), SOIL_LOAD_RGB,
-//                                 SOIL_CREATE_NEW_ID,
-//                                 SOIL_FLAG_MIPMAPS);
+    // Position-only stream for the depth pre-pass, a third of the bandwidth of the interleaved VBO
+    std::vector<float> positions;
+    positions.reserve(mesh.vertices.size() / mesh.step * 3);
+    for (size_t i = 0; i + 2 < mesh.vertices.size(); i += mesh.step)
+    {
+        positions.push_back(mesh.vertices[i]);
+        positions.push_back(mesh.vertices[i + 1]);
+        positions.push_back(mesh.vertices[i + 2]);
+    }
 
-    //Generate texture ID and load texture data
-   GLuint textureID;
-   glGenTextures(1, &textureID);
-   int width,height, channel;
-   unsigned char* image = SOIL_load_image(fileName.c_str(), &width, &height, &channel, SOIL_LOAD_AUTO);
-   GLenum format;
-   if (channel == 1)
-        format = GL_RED;
-   else if (channel == 3)
-        format = GL_RGB;
-   else if (channel == 4)
-        format = GL_RGBA;
+    glGenVertexArrays(1, &mesh.depthVAO);
+    glGenBuffers(1, &mesh.positionVBO);
 
-   // Assign texture to ID
-   glBindTexture(GL_TEXTURE_2D, textureID);
+    glBindVertexArray(mesh.depthVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.positionVBO);
+    glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(float), positions.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
 
-   glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, image);
-   glGenerateMipmap(GL_TEXTURE_2D);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (GLvoid*)0);
 
-   // Parameters
-   glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-   glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-   glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-   glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindVertexArray(0);
 
-   GL_CHECK( glBindTexture(GL_TEXTURE_2D, 0) );
-   SOIL_free_image_data(image);
+    GLDebug::setObjectLabel(GL_VERTEX_ARRAY, mesh.VAO, label + " VAO");
+    GLDebug::setObjectLabel(GL_BUFFER, mesh.VBO, label + " VBO");
+    GLDebug::setObjectLabel(GL_BUFFER, mesh.EBO, label + " EBO");
+    GLDebug::setObjectLabel(GL_VERTEX_ARRAY, mesh.depthVAO, label + " depth VAO");
+    GLDebug::setObjectLabel(GL_BUFFER, mesh.positionVBO, label + " position VBO");
 
-   return textureID;
+    MemoryTracker::instance().allocate(MemoryTracker::VERTEX_BUFFERS, mesh.vertexBufferBytes());
+    MemoryTracker::instance().allocate(MemoryTracker::INDEX_BUFFERS, mesh.indexBufferBytes());
 }
 
 /* functions for load Mesh using Assimp */
 
-void Mesh::processNode(const aiNode *node, const aiScene *scene)
+void Mesh::processNode(const aiNode *node, const aiScene *scene, int parent)
 {
-    // Process each mesh located at the current node
+    // assimp's matrices are row major, glm's column major: a column of local is a column of
+    // assimp's, its rows a to d. Read by name, aiMatrix4x4 is packed and its operator[] indexes past a1
+    const aiMatrix4x4& t = node->mTransformation;
+    const glm::mat4 local(t.a1, t.b1, t.c1, t.d1,
+                          t.a2, t.b2, t.c2, t.d2,
+                          t.a3, t.b3, t.c3, t.d3,
+                          t.a4, t.b4, t.c4, t.d4);
+    const int index = m_sceneGraph.addNode(node->mName.C_Str(), parent, local);
+
+    // Process each mesh located at the current node, they are in the node's space
+    const uint32_t first = (uint32_t)m_meshes.size();
     for(GLuint i = 0; i < node->mNumMeshes; i++)
     {
         // The node object only contains indices to index the actual objects in the scene.
         // The scene contains all the data, node is just to keep stuff organized (like relations between nodes).
         aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
         m_meshes.push_back(this->processMesh(mesh, scene));
+        m_subMeshNodes.push_back(index);
+        MemoryTracker::instance().allocate(MemoryTracker::GEOMETRY, m_meshes.back().cpuBytes());
     }
+    m_sceneGraph.setSubMeshes(index, first, (uint32_t)m_meshes.size() - first);
     // After we've processed all of the meshes (if any) we then recursively process each of the children nodes
     for(GLuint i = 0; i < node->mNumChildren; i++)
     {
-        this->processNode(node->mChildren[i], scene);
+        this->processNode(node->mChildren[i], scene, index);
     }
 }
 
 SubMesh Mesh::processMesh(const aiMesh *mesh, const aiScene *scene)
 {
+    TRACE_SCOPE("Mesh::processMesh");
     // Data to fill
     std::vector<float> vertices;
     std::vector<GLuint> indices;
@@ -283,10 +730,13 @@ SubMesh Mesh::processMesh(const aiMesh *mesh, const aiScene *scene)
         // 2. Specular maps
         std::vector<GLuint> specularMaps = this->loadMaterialTextures(material, aiTextureType_SPECULAR);
         texIndices.insert(texIndices.end(), specularMaps.begin(), specularMaps.end());
+        // 3. Normal maps
+        std::vector<GLuint> normalMaps = this->loadMaterialTextures(material, aiTextureType_NORMALS);
+        texIndices.insert(texIndices.end(), normalMaps.begin(), normalMaps.end());
     }
 
     // Return a mesh object created from the extracted mesh data
-    return SubMesh(vertices, indices, texIndices, 8);
+    return SubMesh(vertices, indices, texIndices, SubMesh::VERTEX_STEP);
 }
 
 std::vector<GLuint> Mesh::loadMaterialTextures(const aiMaterial *mat, aiTextureType type)
@@ -311,6 +761,7 @@ std::vector<GLuint> Mesh::loadMaterialTextures(const aiMaterial *mat, aiTextureT
         {   // If texture hasn't been loaded already, load it
             Texture texture;
             texture.objectId = 0;
+            texture.layer = -1;
             texture.type = (TextureType)typeMap.at(type);
             texture.fileName = directoryOfTex + '/' + std::string(str.C_Str());
             texIndices.push_back(m_textures.size());
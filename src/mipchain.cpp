@@ -0,0 +1,244 @@
+#include "mipchain.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MAKAI_MIP_SSE
+#include <xmmintrin.h>
+#endif
+
+using namespace makai;
+
+namespace
+{
+    // half the width of the filter in texels of the smaller level, and the Kaiser shape
+    const double FILTER_RADIUS = 2.0;
+    const double KAISER_BETA = 4.0;
+
+    // one RGBA texel of linear values
+#ifdef MAKAI_MIP_SSE
+    struct Texel
+    {
+        __m128 v;
+    };
+
+    inline Texel zero() { return { _mm_setzero_ps() }; }
+    inline Texel load(const float *p) { return { _mm_loadu_ps(p) }; }
+    inline void store(float *p, Texel t) { _mm_storeu_ps(p, t.v); }
+    inline Texel madd(Texel acc, float weight, Texel t) { return { _mm_add_ps(acc.v, _mm_mul_ps(_mm_set1_ps(weight), t.v)) }; }
+#else
+    struct Texel
+    {
+        float v[4];
+    };
+
+    inline Texel zero() { return { { 0.0f, 0.0f, 0.0f, 0.0f } }; }
+    inline Texel load(const float *p) { return { { p[0], p[1], p[2], p[3] } }; }
+    inline void store(float *p, Texel t) { std::copy(t.v, t.v + 4, p); }
+    inline Texel madd(Texel acc, float weight, Texel t)
+    {
+        for (int c = 0; c < 4; c++)
+            acc.v[c] += weight * t.v[c];
+        return acc;
+    }
+#endif
+
+    // the source texels and weights of each texel of the smaller level along one axis, count per texel
+    struct Taps
+    {
+        int count;
+        std::vector<int> index;
+        std::vector<float> weight;
+    };
+
+    double besselI0(double x)
+    {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 25; k++)
+        {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    // t in texels of the smaller level
+    double kaiserSinc(double t)
+    {
+        if (std::abs(t) >= FILTER_RADIUS)
+            return 0.0;
+        const double pi = 3.14159265358979323846;
+        double sinc = t == 0.0 ? 1.0 : std::sin(pi * t) / (pi * t);
+        double r = t / FILTER_RADIUS;
+        return sinc * besselI0(KAISER_BETA * std::sqrt(1.0 - r * r)) / besselI0(KAISER_BETA);
+    }
+
+    Taps taps(int size, int newSize)
+    {
+        const double ratio = (double)size / newSize;
+        Taps result;
+        result.count = (int)std::ceil(2.0 * FILTER_RADIUS * ratio) + 1;
+        result.index.resize((size_t)newSize * result.count);
+        result.weight.resize((size_t)newSize * result.count);
+        for (int i = 0; i < newSize; i++)
+        {
+            double center = (i + 0.5) * ratio;
+            int first = (int)std::floor(center - FILTER_RADIUS * ratio);
+            double sum = 0.0;
+            for (int k = 0; k < result.count; k++)
+            {
+                int j = first + k;
+                double weight = kaiserSinc((j + 0.5 - center) / ratio);
+                result.index[i * result.count + k] = ((j % size) + size) % size;
+                result.weight[i * result.count + k] = (float)weight;
+                sum += weight;
+            }
+            for (int k = 0; k < result.count; k++)
+                result.weight[i * result.count + k] = (float)(result.weight[i * result.count + k] / sum);
+        }
+        return result;
+    }
+
+    const std::array<float, 256>& srgbToLinear()
+    {
+        static const std::array<float, 256> table = [] {
+            std::array<float, 256> t;
+            for (int i = 0; i < 256; i++)
+            {
+                double s = i / 255.0;
+                t[i] = (float)(s <= 0.04045 ? s / 12.92 : std::pow((s + 0.055) / 1.055, 2.4));
+            }
+            return t;
+        }();
+        return table;
+    }
+
+    // 4096 steps are finer than 8 bits of sRGB everywhere but the darkest few values
+    unsigned char linearToSrgb(float value)
+    {
+        static const std::array<unsigned char, 4096> table = [] {
+            std::array<unsigned char, 4096> t;
+            for (int i = 0; i < 4096; i++)
+            {
+                double l = i / 4095.0;
+                double s = l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+                t[i] = (unsigned char)(s * 255.0 + 0.5);
+            }
+            return t;
+        }();
+        return table[(int)(std::min(std::max(value, 0.0f), 1.0f) * 4095.0f + 0.5f)];
+    }
+
+    unsigned char unorm(float value)
+    {
+        return (unsigned char)(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+
+    void decodeRow(MipChain::Content content, const unsigned char *rgba, int width, float *out)
+    {
+        const std::array<float, 256>& linear = srgbToLinear();
+        for (int x = 0; x < width * 4; x += 4)
+        {
+            for (int c = 0; c < 3; c++)
+                out[x + c] = content == MipChain::COLOR ? linear[rgba[x + c]] : rgba[x + c] / 127.5f - 1.0f;
+            out[x + 3] = rgba[x + 3] / 255.0f;
+        }
+    }
+
+    // clamps the filter's overshoot, or renormalizes, then writes the texel as RGBA8
+    void encodeTexel(MipChain::Content content, float *texel, unsigned char *out)
+    {
+        if (content == MipChain::COLOR)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                texel[c] = std::min(std::max(texel[c], 0.0f), 1.0f);
+                out[c] = linearToSrgb(texel[c]);
+            }
+        }
+        else
+        {
+            float length = std::sqrt(texel[0] * texel[0] + texel[1] * texel[1] + texel[2] * texel[2]);
+            for (int c = 0; c < 3; c++)
+            {
+                // opposite normals can cancel out, straight up is the least wrong answer
+                texel[c] = length > 1e-6f ? texel[c] / length : (c == 2 ? 1.0f : 0.0f);
+                out[c] = unorm(texel[c] * 0.5f + 0.5f);
+            }
+        }
+        texel[3] = std::min(std::max(texel[3], 0.0f), 1.0f);
+        out[3] = unorm(texel[3]);
+    }
+}
+
+std::vector<std::vector<unsigned char>> MipChain::build(Content content, const unsigned char *rgba, int width, int height)
+{
+    std::vector<std::vector<unsigned char>> levels;
+    levels.emplace_back(rgba, rgba + (size_t)width * height * 4);
+
+    // the previous level as linear values; level 0 is decoded a row at a time instead
+    std::vector<float> source;
+    while (width > 1 || height > 1)
+    {
+        const int w = std::max(width / 2, 1);
+        const int h = std::max(height / 2, 1);
+        const Taps tapsX = taps(width, w);
+        const Taps tapsY = taps(height, h);
+        const std::vector<unsigned char>& sourceBytes = levels.back();
+
+        // horizontal pass, full height
+        std::vector<float> rows((size_t)w * height * 4);
+        ThreadPool::instance().parallelFor(0, height, 16, [&](size_t firstRow, size_t lastRow) {
+            std::vector<float> decoded(source.empty() ? (size_t)width * 4 : 0);
+            for (size_t y = firstRow; y < lastRow; y++)
+            {
+                const float* in;
+                if (source.empty())
+                {
+                    decodeRow(content, &sourceBytes[y * width * 4], width, decoded.data());
+                    in = decoded.data();
+                }
+                else
+                {
+                    in = &source[y * width * 4];
+                }
+
+                for (int x = 0; x < w; x++)
+                {
+                    Texel sum = zero();
+                    for (int k = 0; k < tapsX.count; k++)
+                        sum = madd(sum, tapsX.weight[x * tapsX.count + k], load(in + tapsX.index[x * tapsX.count + k] * 4));
+                    store(&rows[(y * w + x) * 4], sum);
+                }
+            }
+        });
+
+        // vertical pass, a weighted sum of whole rows
+        std::vector<float> next((size_t)w * h * 4);
+        std::vector<unsigned char> bytes((size_t)w * h * 4);
+        ThreadPool::instance().parallelFor(0, h, 16, [&](size_t firstRow, size_t lastRow) {
+            for (size_t y = firstRow; y < lastRow; y++)
+            {
+                float* out = &next[y * w * 4];
+                for (int k = 0; k < tapsY.count; k++)
+                {
+                    const float weight = tapsY.weight[y * tapsY.count + k];
+                    const float* in = &rows[(size_t)tapsY.index[y * tapsY.count + k] * w * 4];
+                    for (int x = 0; x < w * 4; x += 4)
+                        store(out + x, madd(k == 0 ? zero() : load(out + x), weight, load(in + x)));
+                }
+                for (int x = 0; x < w; x++)
+                    encodeTexel(content, out + x * 4, &bytes[(y * w + x) * 4]);
+            }
+        });
+
+        levels.push_back(std::move(bytes));
+        source.swap(next);
+        width = w;
+        height = h;
+    }
+    return levels;
+}
@@ -1,32 +1,42 @@
 #include "openglwidget.h"
+#include "tracer.h"
+#include "renderstats.h"
 
+#include <QApplication>
+
+#include <cstdlib>
 
 OpenGLWidget::OpenGLWidget(QWidget* parent) : QOpenGLWidget(parent),
-    phongShader(0), gourandShader(0), curShader(0), lightProgram(0),
-    camera(glm::vec3(0.0f, 0.0f, 6.0f)),
-    lights(), builtInMeshes(), builtInObjects()
+    scheduler(this), renderer(), shaderReloader(scheduler)
 {
-    Light light;
-    light.setPosition(2.0f, 2.0f, 2.0f);
-    lights.push_back(light);
 
 }
 
 OpenGLWidget::~OpenGLWidget() {
     makeCurrent();
+    renderer.destroy();
+    doneCurrent();
+}
 
-    curShader = 0;
-    delete phongShader;
-    delete gourandShader;
-    delete lightProgram;
+Renderer &OpenGLWidget::frameRenderer()
+{
+    return renderer;
+}
 
-    for (unsigned i = 0; i< builtInMeshes.size(); i++)
-        delete builtInMeshes.at(i);
+const Picking::Hit &OpenGLWidget::lastPick() const
+{
+    return m_lastPick;
+}
 
-    for (unsigned i = 0; i < builtInObjects.size(); i++)
-        delete builtInObjects.at(i);
+FrameScheduler &OpenGLWidget::frameScheduler()
+{
+    return scheduler;
+}
 
-    doneCurrent();
+void OpenGLWidget::scatterLights(unsigned count)
+{
+    renderer.scatterLights(count);
+    scheduler.requestRedraw();
 }
 
 void OpenGLWidget::initializeGL() {
@@ -45,54 +55,20 @@ void OpenGLWidget::initializeGL() {
     }
 #endif
 
-    phongShader = new ShaderProgram();
-    if (!phongShader->addShaderFromFile(Shader::Vertex, "shaders/shader.vert"))
-        qDebug() << phongShader->log().data();
-    if (!phongShader->addShaderFromFile(Shader::Fragment, "shaders/shader.frag"))
-        qDebug() << phongShader->log().data();
-    if (!phongShader->link())
-        qDebug() << phongShader->log().data();
-
-    gourandShader = new ShaderProgram();
-    if (!gourandShader->addShaderFromFile(Shader::Vertex, "shaders/gourandshader.vert"))
-        qDebug() << gourandShader->log().data();
-    if (! gourandShader->addShaderFromFile(Shader::Fragment, "shaders/gourandshader.frag"))
-        qDebug() << gourandShader->log().data();
-    if (!gourandShader->link())
-        qDebug() << gourandShader->log().data();
-
-    lightProgram = new ShaderProgram();
-    if (!lightProgram->addShaderFromSourceCode(Shader::Vertex, lightVertShaderSource))
-        qDebug() << lightProgram->log().data();
-    if (!lightProgram->addShaderFromSourceCode(Shader::Fragment, lightFraShaderSource))
-        qDebug() << lightProgram->log().data();
-    if (!lightProgram->link())
-        qDebug() << lightProgram->log().data();
-
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_TEXTURE_2D);
-    glClearColor(100 / 255.0f, 100 / 255.0f, 200 / 255.0f, 1.0f);
-
-    //for debug
-    // sphere.dae nanosuit/nanosuit.obj
-    Mesh* mesh = new Mesh();
-    GameObject* gameObject = new GameObject();
-    //mesh->loadModelFromFile((QDir::currentPath() + "/models/nanosuit/nanosuit.obj").toStdString());
-    //mesh->genBuffers();
-    gameObject->setMesh(mesh);
-    builtInMeshes.push_back(mesh);
-    builtInObjects.push_back(gameObject);
-
-    setBuiltInObject();
+    GLDebug::setEnabled(glValidation);
+    GLDebug::setSynchronous(glSynchronousDebugOutput);
+    GLDebug::setDebugGroupsEnabled(glDebugGroups);
+    GLDebug::initialize();
+
+    renderer.initialize();
+
+    //editing a shader file rebuilds its variants while the old ones keep drawing
+    for (ShaderPermutations* permutations : renderer.shaderPermutations())
+        shaderReloader.watch(permutations);
 }
 
 void OpenGLWidget::resizeGL(int w, int h) {
     glViewport(0, 0, w, h);
-
-    matrixProjection.setToIdentity();
-    matrixModel.setToIdentity();
-
-    matrixProjection.perspective(camera.fiewOfView, (float)this->width() / this->height(), 0.1f, 100.0f);
 }
 
 void OpenGLWidget::openfile()
@@ -114,9 +90,10 @@ void OpenGLWidget::openfile()
 
     if (!modelFilename.isEmpty()) {
         makeCurrent();
-        builtInMeshes.at(0)->clear();
-        builtInMeshes.at(0)->loadModelFromFile(modelFilename.toStdString());
-        builtInMeshes.at(0)->genBuffers();
+        if (!renderer.loadModel(modelFilename.toStdString()))
+            qDebug() << "Can't load model" << modelFilename;
+        doneCurrent();
+        scheduler.requestRedraw();
     }
 }
 
@@ -124,131 +101,163 @@ void OpenGLWidget::onDisplayModeChanged(QAction *mode)
 {
     QString actionName = mode->objectName();
     if (actionName.compare(tr("actionFill")) == 0) {
-        displayMode = FILL;
+        renderer.displayMode = Renderer::FILL;
     } else if (actionName.compare(tr("actionFilllines")) == 0) {
-        displayMode = FILLLINES;
+        renderer.displayMode = Renderer::FILLLINES;
     } else if (actionName.compare(tr("actionWireframe")) == 0) {
-        displayMode = WIREFRAME;
+        renderer.displayMode = Renderer::WIREFRAME;
     } else {
-        displayMode = FILL;
+        renderer.displayMode = Renderer::FILL;
     }
+    scheduler.requestRedraw();
 }
 
 void OpenGLWidget::onShadingModeChanged(QAction *mode)
 {
     QString actionName = mode->objectName();
     if (actionName.compare(tr("actionGouraud")) == 0) {
-        shadingMode = GOURAUD;
+        renderer.shadingMode = Renderer::GOURAUD;
     } else if (actionName.compare(tr("actionPhong")) == 0) {
-        shadingMode = PHONG;
+        renderer.shadingMode = Renderer::PHONG;
+    } else if (actionName.compare(tr("actionDeferred")) == 0) {
+        renderer.shadingMode = Renderer::DEFERRED;
     } else {
-        shadingMode = PHONG;
+        renderer.shadingMode = Renderer::PHONG;
     }
+    scheduler.requestRedraw();
 }
 
 void OpenGLWidget::onFlatShadingModeChanged(QAction *mode)
 {
     QString actionName = mode->objectName();
     if (actionName.compare(tr("actionFlat")) == 0)
-        flat_flag = true;
+        renderer.flat_flag = true;
     else if (actionName.compare(tr("actionSmooth")) == 0)
-        flat_flag = false;
+        renderer.flat_flag = false;
     else
-        flat_flag = true;
+        renderer.flat_flag = true;
+    scheduler.requestRedraw();
 }
 
 void OpenGLWidget::onTextureModeChanged(QAction *mode)
 {
     QString actionName = mode->objectName();
     if (actionName.compare(tr("actionTexture")) == 0)
-        textureMode = TEXTURE;
+        renderer.textureMode = Renderer::TEXTURE;
     else if (actionName.compare(tr("actionColor")) == 0)
-        textureMode = COLOR;
+        renderer.textureMode = Renderer::COLOR;
     else
-        textureMode = COLOR;
+        renderer.textureMode = Renderer::COLOR;
+    scheduler.requestRedraw();
 }
 
-void OpenGLWidget::paintGL() {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    switch (shadingMode)
-    {
-        case GOURAUD:
-            curShader = gourandShader;
-            break;
-        case PHONG:
-            curShader = phongShader;
-            break;
-        default:
-            curShader = phongShader;
-            break;
-    }
+void OpenGLWidget::onGLValidationToggled(bool checked)
+{
+    glValidation = checked;
+    makeCurrent();
+    GLDebug::setEnabled(glValidation);
+    doneCurrent();
+}
 
-    paintLights();
+void OpenGLWidget::onDebugGroupsToggled(bool checked)
+{
+    glDebugGroups = checked;
+    GLDebug::setDebugGroupsEnabled(glDebugGroups);
+}
 
-    curShader->bind();
+void OpenGLWidget::onSynchronousDebugOutputToggled(bool checked)
+{
+    glSynchronousDebugOutput = checked;
+    makeCurrent();
+    GLDebug::setSynchronous(glSynchronousDebugOutput);
+    doneCurrent();
+}
 
-    uploadMatrices();
+void OpenGLWidget::onRedrawPolicyChanged(QAction *policy)
+{
+    QString actionName = policy->objectName();
+    if (actionName.compare(tr("actionContinuous")) == 0)
+        scheduler.setPolicy(FrameScheduler::CONTINUOUS);
+    else
+        scheduler.setPolicy(FrameScheduler::ONDEMAND);
+}
 
-    //upload ambient
-    curShader->setUniform("ambientLight", lightAmbient.x(), lightAmbient.y(),
-                          lightAmbient.z());
+void OpenGLWidget::onRefineWhenIdleToggled(bool checked)
+{
+    scheduler.setRefineWhenIdle(checked);
+}
 
-    //texture or color
-    bool texture_flag = false;
-    if (textureMode == TEXTURE)
-        texture_flag = true;
-    else if (textureMode == COLOR)
-        texture_flag = false;
+void OpenGLWidget::onDepthPrepassToggled(bool checked)
+{
+    renderer.depthPrepass = checked;
+    scheduler.requestRedraw();
+}
 
-    curShader->setUniform("texture_flag", texture_flag);
-    curShader->setUniform("material.diffuse", 1.0f, 1.0f, 1.0f);
+void OpenGLWidget::onRenderStatsToggled(bool checked)
+{
+    if (statsOverlay == nullptr)
+    {
+        statsOverlay = new QLabel(this);
+        statsOverlay->setStyleSheet("QLabel { color: white; background-color: rgba(0, 0, 0, 160); padding: 4px; }");
+        statsOverlay->setAttribute(Qt::WA_TransparentForMouseEvents);
+        statsOverlay->move(8, 8);
+    }
+    statsOverlay->setVisible(checked);
+    if (checked)
+        updateStatsOverlay();
+}
 
-    //flat or smooth
-    curShader->setUniform("flat_flag", flat_flag);
+void OpenGLWidget::onPointLightsChanged(QAction *count)
+{
+    QString actionName = count->objectName();
+    if (actionName.compare(tr("actionLights100")) == 0)
+        scatterLights(100);
+    else if (actionName.compare(tr("actionLights1000")) == 0)
+        scatterLights(1000);
+    else if (actionName.compare(tr("actionLights4000")) == 0)
+        scatterLights(4000);
+    else
+        scatterLights(1);
+}
 
+void OpenGLWidget::paintGL() {
+    TRACE_SCOPE("OpenGLWidget::paintGL");
+    Profiler::instance().beginFrame();
 
-    //fill, wireFrame or fillLine
-    switch (displayMode)
     {
-        case FILL:
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-            for (unsigned i = 0; i < builtInObjects.size(); i++)
-            {
-                builtInObjects.at(i)->setShaderProgram(curShader);
-                builtInObjects.at(i)->paint(lights);
-            }
-            break;
-        case FILLLINES: //draw twice : FILL and LINE
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-            for (unsigned i = 0; i < builtInObjects.size(); i++)
-            {
-                builtInObjects.at(i)->setShaderProgram(curShader);
-                builtInObjects.at(i)->paint(lights);
-            }
+        PROFILE_ZONE("shader reload");
+        shaderReloader.poll();
+    }
 
-            curShader->setUniform("texture_flag", false);
-            curShader->setUniform("material.diffuse", 0.0f, 0.0f, 0.0f);
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-            for (unsigned i = 0; i < builtInObjects.size(); i++)
-            {
-                builtInObjects.at(i)->paint(lights);
-            }
-            break;
-        case WIREFRAME:
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-            for (unsigned i = 0; i < builtInObjects.size(); i++)
-            {
-                builtInObjects.at(i)->setShaderProgram(curShader);
-                builtInObjects.at(i)->paint(lights);
-            }
-            break;
-        default:
-            break;
+    renderer.render(defaultFramebufferObject(), this->width(), this->height(), scheduler.isInteractiveFrame());
+
+    //keep frames coming while texture levels are read, they are uploaded by the frames after
+    bool streaming = renderer.isStreamingTextures();
+    if (streaming != texturesStreaming)
+    {
+        if (streaming)
+            scheduler.beginLoad();
+        else
+            scheduler.endLoad();
+        texturesStreaming = streaming;
     }
-    curShader->release();
 
-    update();
+    Profiler::instance().endFrame();
+    scheduler.frameRendered();
+
+    if (statsOverlay != nullptr && statsOverlay->isVisible())
+        updateStatsOverlay();
+}
+
+void OpenGLWidget::updateStatsOverlay()
+{
+    const RenderStats::Counters& frame = RenderStats::instance().lastFrame();
+    statsOverlay->setText(QString("draw calls %1\ntriangles %2\nvertices %3\n"
+                                  "program binds %4\ntexture binds %5\nVAO binds %6\nuniform calls %7")
+                          .arg(frame.drawCalls).arg(frame.triangles).arg(frame.vertices)
+                          .arg(frame.programBinds).arg(frame.textureBinds).arg(frame.vaoBinds)
+                          .arg(frame.uniformCalls));
+    statsOverlay->adjustSize();
 }
 
 void OpenGLWidget::keyPressEvent(QKeyEvent* event)
@@ -259,27 +268,28 @@ void OpenGLWidget::keyPressEvent(QKeyEvent* event)
     {
     case Qt::Key_Up:
     case Qt::Key_Space:
-        camera.move(Camera::UP, deltaTime);
+        renderer.camera.move(Camera::UP, deltaTime);
         break;
     case Qt::Key_Down:
     case Qt::Key_Control:
-        camera.move(Camera::DOWN, deltaTime);
+        renderer.camera.move(Camera::DOWN, deltaTime);
         break;
     case Qt::Key_W:
-        camera.move(Camera::FORWARD, deltaTime);
+        renderer.camera.move(Camera::FORWARD, deltaTime);
         break;
     case Qt::Key_S:
-        camera.move(Camera::BACKWARD, deltaTime);
+        renderer.camera.move(Camera::BACKWARD, deltaTime);
         break;
     case Qt::Key_A:
-        camera.move(Camera::LEFT, deltaTime);
+        renderer.camera.move(Camera::LEFT, deltaTime);
         break;
     case Qt::Key_D:
-        camera.move(Camera::RIGHT, deltaTime);
+        renderer.camera.move(Camera::RIGHT, deltaTime);
         break;
     default:
         return;
     }
+    scheduler.interact();
     event->accept();
 }
 
@@ -310,7 +320,8 @@ void OpenGLWidget::mouseMoveEvent(QMouseEvent *event)
         lastX = event->x();
         lastY = event->y();
 
-        camera.rotate(yoffset * camRotSensitivity, xoffset * camRotSensitivity);
+        renderer.camera.rotate(yoffset * camRotSensitivity, xoffset * camRotSensitivity);
+        scheduler.interact();
         event->accept();
     }
 //    else if (isControlPressing && mouseButton == Qt::RightButton)
@@ -335,7 +346,10 @@ void OpenGLWidget::mousePressEvent(QMouseEvent *event)
 {
     qDebug() << "Mouse Press in" << this->objectName();
     mouseButton = event->button();
-
+    if (mouseButton == Qt::LeftButton) {
+        pressX = event->x();
+        pressY = event->y();
+    }
     event->accept();
 }
 
@@ -343,6 +357,20 @@ void OpenGLWidget::mouseReleaseEvent(QMouseEvent *event)
 {
     qDebug() << "Mouse Release in" << this->objectName();
     isFirstMouseClick = true;
+
+    //a drag turned the camera, only a click picks
+    const int moved = std::abs(event->x() - pressX) + std::abs(event->y() - pressY);
+    if (event->button() == Qt::LeftButton && moved <= QApplication::startDragDistance()) {
+        m_lastPick = renderer.pick(event->x(), event->y());
+        const Picking::Hit& hit = m_lastPick;
+        if (hit.isHit())
+            qDebug("Picked object %d, sub-mesh %d, triangle %d at (%.3f, %.3f), %.3f away, in %.3f ms",
+                   hit.objectIndex, hit.subMesh, hit.triangle, hit.barycentrics.x, hit.barycentrics.y,
+                   hit.distance, hit.milliseconds);
+        else
+            qDebug("Picked nothing in %.3f ms", hit.milliseconds);
+        emit objectPicked(m_lastPick);
+    }
     event->accept();
 }
 
@@ -356,159 +384,65 @@ void OpenGLWidget::wheelEvent(QWheelEvent *event)
 //    }
 }
 
-void OpenGLWidget::uploadMatrices()
-{
-    //update matrix
-    matrixProjection.setToIdentity();
-    matrixProjection.perspective(camera.fiewOfView, (float)this->width() / this->height(), 0.1f, 100);
-    matrixModel.setToIdentity();
-    matrixModel.scale(QVector3D(scaler, scaler, scaler));
-    matrixModel.translate(QVector3D(transX, transY, 0.0f));
-    matrixModel.rotate(rotationAroundY, QVector3D(0, 1, 0));
-
-    //upload matrix
-    curShader->setUniformMatrix4("view", glm::value_ptr(camera.GetViewMatrix()), 1, GL_FALSE);
-    curShader->setUniformMatrix4("view_inv", glm::value_ptr(glm::inverse(camera.GetViewMatrix())), 1, GL_FALSE);
-    curShader->setUniformMatrix4("projection", matrixProjection.data(), 1, GL_FALSE);
-    curShader->setUniformMatrix4("model", matrixModel.data(), 1, GL_FALSE);
-}
-
-void OpenGLWidget::setBuiltInObject()
+QString OpenGLWidget::benchmarkShading(unsigned frames)
 {
-    float vertices[] = {
-        // positions          // normals           // texture coords
-        -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
-         0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  0.0f,
-         0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  1.0f,
-         0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  1.0f,
-        -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  1.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
-
-        -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  0.0f,
-         0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  0.0f,
-         0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  1.0f,
-         0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  1.0f,
-        -0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  1.0f,
-        -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  0.0f,
-
-        -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-        -0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
-        -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-        -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-        -0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
-        -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-
-         0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-         0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
-         0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-         0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-         0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
-         0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-
-        -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  1.0f,
-         0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  1.0f,
-         0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  0.0f,
-         0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  0.0f,
-        -0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  0.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  1.0f,
-
-        -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  1.0f,
-         0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  1.0f,
-         0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  0.0f,
-         0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  0.0f,
-        -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  0.0f,
-        -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  1.0f
-    };
-
-    int size = sizeof(vertices) / sizeof(float);
-    std::vector<float> v(vertices, vertices + size);
-    unsigned indSize = size / 8;
-    std::vector<unsigned> indices(indSize);
-    for (unsigned i = 0; i < indSize; i++) indices[i] = i;
-    std::vector<unsigned> texIndices;
-    texIndices.push_back(0);
-    texIndices.push_back(1);
-    SubMesh sm(v, indices, texIndices, 8);
-
-    initLightVAO(v);
-
-    Mesh* m = new Mesh();
-    m->addSubMesh(sm);
-    Texture t;
-    t.fileName = "models/textures/container2.png";
-    t.type = TextureType::diffuse;
-    m->addTexture(t);
-    t.fileName = "models/textures/container2_specular.png";
-    t.type = TextureType::specular;
-    m->addTexture(t);
-    builtInMeshes.push_back(m);
-
-    for(unsigned i = 0; i < builtInMeshes.size(); i++)
-        builtInMeshes.at(i)->genBuffers();
-
-
-    // positions all containers
-    glm::vec3 cubePositions[] = {
-        glm::vec3( 0.0f,  0.0f,  0.0f),
-        glm::vec3( 2.0f,  5.0f, -15.0f),
-        glm::vec3(-1.5f, -2.2f, -2.5f),
-        glm::vec3(-3.8f, -2.0f, -12.3f),
-        glm::vec3( 2.4f, -0.4f, -3.5f),
-        glm::vec3(-1.7f,  3.0f, -7.5f),
-        glm::vec3( 1.3f, -2.0f, -2.5f),
-        glm::vec3( 1.5f,  2.0f, -2.5f),
-        glm::vec3( 1.5f,  0.2f, -1.5f),
-        glm::vec3(-1.3f,  1.0f, -1.5f)
-    };
-
-
-    for (unsigned int i = 0; i < 10; i++)
-    {
-        GameObject* gameObject = new GameObject();
-        gameObject->setMesh(builtInMeshes.back());
-        gameObject->setPosition(cubePositions[i]);
-        float angle = 20.0f * i;
-        gameObject->rotate(angle, glm::vec3(1.0f, 0.3f, 0.5f));
-        builtInObjects.push_back(gameObject);
-    }
-
+    const unsigned lightCounts[] = { 1, 10, 100, 1000 };
+    const Renderer::SHADINGMODE modes[] = { Renderer::PHONG, Renderer::DEFERRED };
 
-}
+    std::vector<Light> savedLights = renderer.lights();
+    Renderer::SHADINGMODE savedMode = renderer.shadingMode;
+    //time the shading alone, not the cubes drawn at the lights
+    bool savedMarkers = renderer.lightMarkers;
+    renderer.lightMarkers = false;
 
-void OpenGLWidget::initLightVAO(const std::vector<float> &v)
-{
-    unsigned int VBO;
-    glGenVertexArrays(1, &lightVAO);
-    glGenBuffers(1, &VBO);
-
-    glBindVertexArray(lightVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-
-    glBufferData(GL_ARRAY_BUFFER, v.size() * sizeof(float), &v[0], GL_STATIC_DRAW);
+    //the widget's own framebuffer, bound by makeCurrent(), at the size paintGL() draws
+    makeCurrent();
+    const GLuint framebuffer = defaultFramebufferObject();
+    const int frameWidth = width(), frameHeight = height();
+    std::vector<GLuint> queries(frames);
+    glGenQueries(frames, queries.data());
 
-    // note that we update the lamp's position attribute's stride to reflect the updated buffer data
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    QString report = tr("GPU ms per frame at %1x%2\nlights\tphong\tdeferred\n").arg(frameWidth).arg(frameHeight);
+    for (unsigned count : lightCounts)
+    {
+        renderer.scatterLights(count);
+        report += QString::number(count);
+        for (Renderer::SHADINGMODE mode : modes)
+        {
+            renderer.shadingMode = mode;
+            //warm up, this also allocates the g-buffer
+            renderer.render(framebuffer, frameWidth, frameHeight);
+            glFinish();
+
+            //a query per frame, read once the run is done so the reads don't stall the frames
+            for (unsigned frame = 0; frame < frames; frame++)
+            {
+                glBeginQuery(GL_TIME_ELAPSED, queries[frame]);
+                renderer.render(framebuffer, frameWidth, frameHeight);
+                glEndQuery(GL_TIME_ELAPSED);
+            }
+            GLuint64 total = 0;
+            for (GLuint query : queries)
+            {
+                GLuint64 elapsed = 0;
+                glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+                total += elapsed;
+            }
+            report += QString("\t%1").arg(total / 1000000.0 / frames, 0, 'f', 3);
+        }
+        report += "\n";
+    }
 
-    glBindVertexArray(0);
-}
+    glDeleteQueries(frames, queries.data());
+    doneCurrent();
 
-void OpenGLWidget::paintLights()
-{
-    lightProgram->bind();
-    lightProgram->setUniformMatrix4("projection", matrixProjection.data(), 1, GL_FALSE);
-    lightProgram->setUniform("view", camera.GetViewMatrix());
-    glBindVertexArray(lightVAO);
-    for (unsigned i = 0 ; i < lights.size(); i++) {
-        glm::mat4 model;
-        model = glm::translate(model, glm::vec3(lights.at(i).position()));
-        model = glm::scale(model, glm::vec3(1.0f)); // a smaller cube
-        lightProgram->setUniform("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-    }
+    renderer.setLights(savedLights);
+    renderer.shadingMode = savedMode;
+    renderer.lightMarkers = savedMarkers;
+    scheduler.requestRedraw();
 
-    glBindVertexArray(0);
-    lightProgram->release();
+    qDebug().noquote() << report;
+    return report;
 }
 
 
@@ -0,0 +1,299 @@
+#include "picking.h"
+#include "gameobject.h"
+#include "mesh.h"
+#include "tracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MAKAI_PICKING_SSE
+#include <xmmintrin.h>
+#endif
+
+using namespace makai;
+
+namespace
+{
+    const float MISS = std::numeric_limits<float>::infinity();
+    // smaller determinants are rays parallel to the triangle
+    const float PARALLEL_EPSILON = 1e-12f;
+    // nearer hits are the surface the ray starts on
+    const float MIN_DISTANCE = 1e-6f;
+
+    struct SlabRay {
+        glm::vec3 origin;
+        glm::vec3 inverseDirection;
+    };
+
+    SlabRay slabRay(const Picking::Ray &ray)
+    {
+        SlabRay slab;
+        slab.origin = ray.origin;
+        //a huge inverse instead of infinity keeps 0 * inf out of the slab test
+        for (int axis = 0; axis < 3; axis++)
+            slab.inverseDirection[axis] = 1.0f / (ray.direction[axis] != 0.0f ? ray.direction[axis] : 1e-30f);
+        return slab;
+    }
+
+    // where the ray enters the box, MISS if it doesn't before maxDistance
+    float enter(const SlabRay &ray, const Bvh::Node &node, float maxDistance)
+    {
+        float entry = 0.0f, exit = maxDistance;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float t0 = (node.boundsMin[axis] - ray.origin[axis]) * ray.inverseDirection[axis];
+            float t1 = (node.boundsMax[axis] - ray.origin[axis]) * ray.inverseDirection[axis];
+            entry = std::max(entry, std::min(t0, t1));
+            exit = std::min(exit, std::max(t0, t1));
+        }
+        return entry <= exit ? entry : MISS;
+    }
+
+    // four triangles side by side as [axis][lane], unused lanes are zero and never hit
+    struct TrianglePacket {
+        float v0[3][4];
+        float edge1[3][4];
+        float edge2[3][4];
+    };
+
+    // Möller-Trumbore on all four lanes, both faces. The lane of the nearest hit closer than distance,
+    // which then holds its distance with u and v, the weights of the second and third corner; -1 if none.
+    int intersect4(const TrianglePacket &packet, const Picking::Ray &ray, float &distance, float &u, float &v)
+    {
+        float t[4], us[4], vs[4];
+        int hits = 0;
+#ifdef MAKAI_PICKING_SSE
+        const __m128 dx = _mm_set1_ps(ray.direction.x), dy = _mm_set1_ps(ray.direction.y), dz = _mm_set1_ps(ray.direction.z);
+        const __m128 e1x = _mm_loadu_ps(packet.edge1[0]), e1y = _mm_loadu_ps(packet.edge1[1]), e1z = _mm_loadu_ps(packet.edge1[2]);
+        const __m128 e2x = _mm_loadu_ps(packet.edge2[0]), e2y = _mm_loadu_ps(packet.edge2[1]), e2z = _mm_loadu_ps(packet.edge2[2]);
+
+        //p = d x e2, det = e1 . p
+        const __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+        const __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+        const __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+        const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+        const __m128 inverseDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+        //s = o - v0, u = s . p / det
+        const __m128 sx = _mm_sub_ps(_mm_set1_ps(ray.origin.x), _mm_loadu_ps(packet.v0[0]));
+        const __m128 sy = _mm_sub_ps(_mm_set1_ps(ray.origin.y), _mm_loadu_ps(packet.v0[1]));
+        const __m128 sz = _mm_sub_ps(_mm_set1_ps(ray.origin.z), _mm_loadu_ps(packet.v0[2]));
+        const __m128 uu = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inverseDet);
+
+        //q = s x e1, v = d . q / det, t = e2 . q / det
+        const __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+        const __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+        const __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+        const __m128 vv = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inverseDet);
+        const __m128 tt = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverseDet);
+
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+        __m128 mask = _mm_cmpgt_ps(absDet, _mm_set1_ps(PARALLEL_EPSILON));
+        mask = _mm_and_ps(mask, _mm_cmpge_ps(uu, zero));
+        mask = _mm_and_ps(mask, _mm_cmpge_ps(vv, zero));
+        mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(uu, vv), _mm_set1_ps(1.0f)));
+        mask = _mm_and_ps(mask, _mm_cmpgt_ps(tt, _mm_set1_ps(MIN_DISTANCE)));
+        mask = _mm_and_ps(mask, _mm_cmplt_ps(tt, _mm_set1_ps(distance)));
+        hits = _mm_movemask_ps(mask);
+        if (hits == 0)
+            return -1;
+        _mm_storeu_ps(t, tt);
+        _mm_storeu_ps(us, uu);
+        _mm_storeu_ps(vs, vv);
+#else
+        for (int lane = 0; lane < 4; lane++)
+        {
+            glm::vec3 e1(packet.edge1[0][lane], packet.edge1[1][lane], packet.edge1[2][lane]);
+            glm::vec3 e2(packet.edge2[0][lane], packet.edge2[1][lane], packet.edge2[2][lane]);
+            glm::vec3 p = glm::cross(ray.direction, e2);
+            float det = glm::dot(e1, p);
+            if (std::abs(det) <= PARALLEL_EPSILON)
+                continue;
+            float inverseDet = 1.0f / det;
+            glm::vec3 s = ray.origin - glm::vec3(packet.v0[0][lane], packet.v0[1][lane], packet.v0[2][lane]);
+            glm::vec3 q = glm::cross(s, e1);
+            us[lane] = glm::dot(s, p) * inverseDet;
+            vs[lane] = glm::dot(ray.direction, q) * inverseDet;
+            t[lane] = glm::dot(e2, q) * inverseDet;
+            if (us[lane] >= 0.0f && vs[lane] >= 0.0f && us[lane] + vs[lane] <= 1.0f &&
+                t[lane] > MIN_DISTANCE && t[lane] < distance)
+                hits |= 1 << lane;
+        }
+        if (hits == 0)
+            return -1;
+#endif
+        int nearest = -1;
+        for (int lane = 0; lane < 4; lane++)
+        {
+            if ((hits & (1 << lane)) && (nearest < 0 || t[lane] < t[nearest]))
+                nearest = lane;
+        }
+        distance = t[nearest];
+        u = us[nearest];
+        v = vs[nearest];
+        return nearest;
+    }
+
+    glm::vec3 corner(const SubMesh &mesh, unsigned index)
+    {
+        size_t offset = (size_t)index * mesh.step;
+        if (offset + 2 >= mesh.vertices.size())
+            return glm::vec3(0.0f);
+        return glm::vec3(mesh.vertices[offset], mesh.vertices[offset + 1], mesh.vertices[offset + 2]);
+    }
+
+    // a node to visit and where the ray enters it, skipped if a nearer hit turned up since it was pushed
+    struct StackEntry {
+        uint32_t node;
+        float distance;
+    };
+
+    // Front to back through the tree, calling leaf(node, distance) with the nearest hit so far,
+    // which leaf() lowers when it finds a nearer one.
+    template <typename Leaf>
+    void traverse(const Bvh &bvh, const SlabRay &ray, float &distance, std::vector<StackEntry> &stack, Leaf leaf)
+    {
+        const std::vector<Bvh::Node>& nodes = bvh.nodes();
+        if (nodes.empty())
+            return;
+        float root = enter(ray, nodes[0], distance);
+        if (root == MISS)
+            return;
+        stack.clear();
+        stack.push_back(StackEntry{ 0, root });
+        while (!stack.empty())
+        {
+            const StackEntry entry = stack.back();
+            stack.pop_back();
+            if (entry.distance > distance)
+                continue;
+            const Bvh::Node& node = nodes[entry.node];
+            if (node.isLeaf()) {
+                leaf(node, distance);
+                continue;
+            }
+
+            StackEntry first = { node.leftOrFirst, enter(ray, nodes[node.leftOrFirst], distance) };
+            StackEntry second = { node.leftOrFirst + 1, enter(ray, nodes[node.leftOrFirst + 1], distance) };
+            if (second.distance < first.distance)
+                std::swap(first, second);
+            //the nearer child goes on top
+            if (second.distance != MISS)
+                stack.push_back(second);
+            if (first.distance != MISS)
+                stack.push_back(first);
+        }
+    }
+}
+
+Picking::Ray Picking::rayThroughPixel(const glm::mat4 &view, const glm::mat4 &projection,
+                                      float x, float y, int width, int height)
+{
+    const glm::mat4 inverse = glm::inverse(projection * view);
+    const float ndcX = 2.0f * (x + 0.5f) / std::max(width, 1) - 1.0f;
+    const float ndcY = 1.0f - 2.0f * (y + 0.5f) / std::max(height, 1);
+    glm::vec4 nearPoint = inverse * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+    glm::vec4 farPoint = inverse * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+
+    Ray ray;
+    ray.origin = glm::vec3(nearPoint) / nearPoint.w;
+    ray.direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - ray.origin);
+    return ray;
+}
+
+Picking::Hit Picking::pick(const Bvh &sceneBvh, const std::vector<GameObject *> &objects, const Ray &ray)
+{
+    TRACE_SCOPE("Picking::pick");
+    auto start = std::chrono::steady_clock::now();
+    Hit hit;
+    float distance = MISS;
+
+    std::vector<StackEntry> stack;
+    stack.reserve(64);
+    traverse(sceneBvh, slabRay(ray), distance, stack, [&](const Bvh::Node &leaf, float &nearest) {
+        for (uint32_t i = leaf.leftOrFirst; i < leaf.leftOrFirst + leaf.count; i++)
+        {
+            const uint32_t index = sceneBvh.primitives()[i];
+            GameObject* object = index < objects.size() ? objects[index] : nullptr;
+            if (!object || !object->mesh())
+                continue;
+            //in model space the ray keeps its parameter, distances stay comparable between objects
+            const glm::mat4 toModel = glm::inverse(object->modelMatrix());
+            Ray local;
+            local.origin = glm::vec3(toModel * glm::vec4(ray.origin, 1.0f));
+            local.direction = glm::vec3(toModel * glm::vec4(ray.direction, 0.0f));
+            if (intersect(*object->mesh(), local, nearest, hit)) {
+                hit.object = object;
+                hit.objectIndex = (int)index;
+            }
+        }
+    });
+
+    if (hit.isHit()) {
+        hit.distance = distance;
+        hit.position = ray.origin + ray.direction * distance;
+    }
+    hit.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return hit;
+}
+
+bool Picking::intersect(const Mesh &mesh, const Ray &ray, float &distance, Hit &hit)
+{
+    const std::vector<SubMesh>& subMeshes = mesh.subMeshes();
+    const std::vector<Bvh>& bvhs = mesh.bvhs();
+    std::vector<StackEntry> stack;
+    stack.reserve(64);
+
+    bool found = false;
+    for (size_t s = 0; s < subMeshes.size() && s < bvhs.size(); s++)
+    {
+        //sub-meshes are in the space of their scene graph node, the ray keeps its parameter there too
+        Ray local = ray;
+        const glm::mat4 transform = mesh.subMeshTransform(s);
+        if (transform != glm::mat4(1.0f)) {
+            const glm::mat4 toSubMesh = glm::inverse(transform);
+            local.origin = glm::vec3(toSubMesh * glm::vec4(ray.origin, 1.0f));
+            local.direction = glm::vec3(toSubMesh * glm::vec4(ray.direction, 0.0f));
+        }
+
+        const SubMesh& subMesh = subMeshes[s];
+        const std::vector<uint32_t>& triangles = bvhs[s].primitives();
+        traverse(bvhs[s], slabRay(local), distance, stack, [&](const Bvh::Node &leaf, float &nearest) {
+            for (uint32_t first = 0; first < leaf.count; first += 4)
+            {
+                TrianglePacket packet = {};
+                uint32_t ids[4] = { 0, 0, 0, 0 };
+                const uint32_t lanes = std::min<uint32_t>(4, leaf.count - first);
+                for (uint32_t lane = 0; lane < lanes; lane++)
+                {
+                    const uint32_t triangle = triangles[leaf.leftOrFirst + first + lane];
+                    const unsigned* index = &subMesh.indices[(size_t)triangle * 3];
+                    const glm::vec3 a = corner(subMesh, index[0]);
+                    const glm::vec3 edge1 = corner(subMesh, index[1]) - a;
+                    const glm::vec3 edge2 = corner(subMesh, index[2]) - a;
+                    for (int axis = 0; axis < 3; axis++)
+                    {
+                        packet.v0[axis][lane] = a[axis];
+                        packet.edge1[axis][lane] = edge1[axis];
+                        packet.edge2[axis][lane] = edge2[axis];
+                    }
+                    ids[lane] = triangle;
+                }
+
+                float u = 0.0f, v = 0.0f;
+                int lane = intersect4(packet, local, nearest, u, v);
+                if (lane >= 0) {
+                    hit.subMesh = (int)s;
+                    hit.triangle = (int)ids[lane];
+                    hit.barycentrics = glm::vec2(u, v);
+                    found = true;
+                }
+            }
+        });
+    }
+    return found;
+}
@@ -0,0 +1,211 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace makai;
+
+static double milliseconds(std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+static double queryMilliseconds(GLuint beginQuery, GLuint endQuery)
+{
+    GLuint64 begin = 0, end = 0;
+    glGetQueryObjectui64v(beginQuery, GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(endQuery, GL_QUERY_RESULT, &end);
+    return end > begin ? (end - begin) / 1.0e6 : 0.0;
+}
+
+static double average(const double *history, int samples)
+{
+    int count = std::min(samples, (int)Profiler::FRAME_HISTORY);
+    if (count == 0)
+        return 0.0;
+    double sum = 0.0;
+    for (int i = 0; i < count; i++)
+        sum += history[i];
+    return sum / count;
+}
+
+Profiler::Profiler() : m_timerQueries(false), m_inFrame(false), m_openZones(0), m_frameIndex(0),
+    m_frameStart(), m_lastFrameStart(), m_frameSamples(0), m_resolvedSamples(0), m_zones()
+{
+    std::fill(m_frameHistory, m_frameHistory + FRAME_HISTORY, 0.0);
+    std::fill(m_cpuHistory, m_cpuHistory + FRAME_HISTORY, 0.0);
+    std::fill(m_gpuHistory, m_gpuHistory + FRAME_HISTORY, 0.0);
+}
+
+Profiler &Profiler::instance()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+void Profiler::initialize()
+{
+    m_timerQueries = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+    if (!m_timerQueries)
+        qDebug("No timer queries, the profiler measures CPU times only");
+}
+
+void Profiler::destroy()
+{
+    for (FrameSlot& slot : m_slots)
+    {
+        if (!slot.queries.empty())
+            glDeleteQueries((GLsizei)slot.queries.size(), slot.queries.data());
+        slot = FrameSlot();
+    }
+    m_timerQueries = false;
+    m_inFrame = false;
+}
+
+bool Profiler::hasGpuTimes() const
+{
+    return m_timerQueries;
+}
+
+void Profiler::beginFrame()
+{
+    FrameSlot& slot = currentSlot();
+    resolve(slot);
+    slot.zones.clear();
+    slot.usedQueries = 0;
+
+    Clock::time_point now = Clock::now();
+    if (m_frameIndex > 0)
+    {
+        // a longer gap means the viewport was idle, not that the frame was slow
+        double interval = milliseconds(now - m_lastFrameStart);
+        if (interval < 1000.0)
+            m_frameHistory[m_frameSamples++ % FRAME_HISTORY] = interval;
+    }
+    m_lastFrameStart = now;
+    m_frameStart = now;
+
+    slot.beginQuery = timestamp(slot);
+    m_inFrame = true;
+    m_openZones = 0;
+}
+
+void Profiler::endFrame()
+{
+    if (!m_inFrame)
+        return;
+    FrameSlot& slot = currentSlot();
+    slot.endQuery = timestamp(slot);
+    slot.cpuMilliseconds = milliseconds(Clock::now() - m_frameStart);
+    slot.recorded = true;
+    m_inFrame = false;
+    m_frameIndex++;
+}
+
+int Profiler::beginZone(const char *name, bool gpu)
+{
+    if (!m_inFrame)
+        return -1;
+    FrameSlot& slot = currentSlot();
+    ZoneRecord zone;
+    zone.name = name;
+    zone.depth = m_openZones++;
+    zone.beginQuery = gpu ? timestamp(slot) : 0;
+    zone.endQuery = 0;
+    zone.begin = Clock::now();
+    slot.zones.push_back(zone);
+    return (int)slot.zones.size() - 1;
+}
+
+void Profiler::endZone(int zone)
+{
+    if (zone < 0 || !m_inFrame)
+        return;
+    FrameSlot& slot = currentSlot();
+    ZoneRecord& record = slot.zones[zone];
+    record.end = Clock::now();
+    if (record.beginQuery != 0)
+        record.endQuery = timestamp(slot);
+    m_openZones--;
+}
+
+Profiler::Statistics Profiler::statistics() const
+{
+    Statistics statistics;
+    statistics.frame = average(m_frameHistory, m_frameSamples);
+    statistics.cpu = average(m_cpuHistory, m_resolvedSamples);
+    statistics.gpu = average(m_gpuHistory, m_resolvedSamples);
+    return statistics;
+}
+
+std::vector<Profiler::Zone> Profiler::zones() const
+{
+    return m_zones;
+}
+
+Profiler::FrameSlot &Profiler::currentSlot()
+{
+    return m_slots[m_frameIndex % 2];
+}
+
+GLuint Profiler::timestamp(FrameSlot &slot)
+{
+    if (!m_timerQueries)
+        return 0;
+    if (slot.usedQueries == slot.queries.size())
+    {
+        GLuint query;
+        glGenQueries(1, &query);
+        slot.queries.push_back(query);
+    }
+    GLuint query = slot.queries[slot.usedQueries++];
+    glQueryCounter(query, GL_TIMESTAMP);
+    return query;
+}
+
+void Profiler::resolve(FrameSlot &slot)
+{
+    if (!slot.recorded)
+        return;
+    slot.recorded = false;
+
+    // the end of the frame is the last query of the slot, once it is there the others are too
+    double gpu = 0.0;
+    if (m_timerQueries)
+    {
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(slot.endQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return;
+        gpu = queryMilliseconds(slot.beginQuery, slot.endQuery);
+    }
+    m_cpuHistory[m_resolvedSamples % FRAME_HISTORY] = slot.cpuMilliseconds;
+    m_gpuHistory[m_resolvedSamples % FRAME_HISTORY] = gpu;
+    m_resolvedSamples++;
+
+    std::vector<Zone> zones;
+    for (const ZoneRecord& record : slot.zones)
+    {
+        Zone zone;
+        zone.name = record.name;
+        zone.depth = record.depth;
+        zone.cpuMilliseconds = milliseconds(record.end - record.begin);
+        zone.gpuMilliseconds = record.beginQuery != 0 ? queryMilliseconds(record.beginQuery, record.endQuery) : -1.0;
+        zones.push_back(zone);
+    }
+
+    // the same passes as last time, smooth them so the readout doesn't flicker
+    bool same = zones.size() == m_zones.size();
+    for (size_t i = 0; same && i < zones.size(); i++)
+        same = std::strcmp(zones[i].name, m_zones[i].name) == 0 && zones[i].depth == m_zones[i].depth;
+    if (same)
+    {
+        for (size_t i = 0; i < zones.size(); i++)
+        {
+            zones[i].cpuMilliseconds = m_zones[i].cpuMilliseconds * 0.9 + zones[i].cpuMilliseconds * 0.1;
+            if (zones[i].gpuMilliseconds >= 0.0)
+                zones[i].gpuMilliseconds = m_zones[i].gpuMilliseconds * 0.9 + zones[i].gpuMilliseconds * 0.1;
+        }
+    }
+    m_zones.swap(zones);
+}
@@ -0,0 +1,881 @@
+#include "renderer.h"
+#include "tracer.h"
+#include "renderstats.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+using namespace makai;
+
+Renderer::Renderer() :
+    camera(glm::vec3(0.0f, 0.0f, 6.0f)),
+    m_projection(1.0f),
+    phongVariants("phong"), gourandVariants("gouraud"), gbufferVariants("g-buffer"),
+    depthVariants("depth"), deferredVariants("deferred lighting"),
+    curShader(0), m_lights(), clusters(), streamer(), builtInMeshes(), builtInObjects(), lightProgram(0)
+{
+    Light light;
+    light.setPosition(2.0f, 2.0f, 2.0f);
+    m_lights.push_back(light);
+}
+
+void Renderer::initialize()
+{
+    if (TextureCache::isEnabled() && !TextureCache::isSupported()) {
+        qDebug("No S3TC or RGTC support, textures are loaded uncompressed");
+        TextureCache::setEnabled(false);
+    }
+    Profiler::instance().initialize();
+
+    //variants are only compiled when a frame first needs them
+    phongVariants.addShaderFile(Shader::Vertex, "shaders/shader.vert");
+    phongVariants.addShaderFile(Shader::Geometry, "shaders/shader.geom", ShaderPermutations::WIREFRAME_OVERLAY);
+    phongVariants.addShaderFile(Shader::Fragment, "shaders/shader.frag");
+
+    gourandVariants.addShaderFile(Shader::Vertex, "shaders/gourandshader.vert");
+    gourandVariants.addShaderFile(Shader::Geometry, "shaders/gourandshader.geom", ShaderPermutations::WIREFRAME_OVERLAY);
+    gourandVariants.addShaderFile(Shader::Fragment, "shaders/gourandshader.frag");
+
+    gbufferVariants.addShaderFile(Shader::Vertex, "shaders/shader.vert");
+    gbufferVariants.addShaderFile(Shader::Geometry, "shaders/shader.geom", ShaderPermutations::WIREFRAME_OVERLAY);
+    gbufferVariants.addShaderFile(Shader::Fragment, "shaders/gbuffer.frag");
+
+    depthVariants.addShaderFile(Shader::Vertex, "shaders/depth.vert");
+    depthVariants.addShaderFile(Shader::Fragment, "shaders/depth.frag");
+
+    deferredVariants.addShaderFile(Shader::Vertex, "shaders/deferred.vert");
+    deferredVariants.addShaderFile(Shader::Fragment, "shaders/deferred.frag");
+
+    lightProgram = new ShaderProgram();
+    if (!lightProgram->addShaderFromSourceCode(Shader::Vertex, lightVertShaderSource))
+        qDebug() << lightProgram->log().data();
+    if (!lightProgram->addShaderFromSourceCode(Shader::Fragment, lightFraShaderSource))
+        qDebug() << lightProgram->log().data();
+    if (!lightProgram->link())
+        qDebug() << lightProgram->log().data();
+
+    glGenQueries(2, samplesQueries);
+    clusters.initialize();
+
+    glGenVertexArrays(1, &screenVAO);
+    GLDebug::setObjectLabel(GL_VERTEX_ARRAY, screenVAO, "full-screen triangle VAO");
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_TEXTURE_2D);
+    glClearColor(100 / 255.0f, 100 / 255.0f, 200 / 255.0f, 1.0f);
+
+    //the model loadModel() fills, empty until then
+    Mesh* mesh = new Mesh();
+    GameObject* gameObject = new GameObject();
+    gameObject->setMesh(mesh);
+    builtInMeshes.push_back(mesh);
+    builtInObjects.push_back(gameObject);
+
+    setBuiltInObject();
+}
+
+void Renderer::destroy()
+{
+    curShader = 0;
+    phongVariants.clear();
+    gourandVariants.clear();
+    gbufferVariants.clear();
+    depthVariants.clear();
+    deferredVariants.clear();
+    delete lightProgram;
+    lightProgram = 0;
+
+    clusters.destroy();
+    gbuffer.destroy();
+    glDeleteVertexArrays(1, &screenVAO);
+    glDeleteVertexArrays(1, &lightVAO);
+    glDeleteBuffers(1, &lightInstanceVBO);
+    glDeleteQueries(2, samplesQueries);
+    Profiler::instance().destroy();
+
+    for (unsigned i = 0; i< builtInMeshes.size(); i++)
+        delete builtInMeshes.at(i);
+    builtInMeshes.clear();
+
+    for (unsigned i = 0; i < builtInObjects.size(); i++)
+        delete builtInObjects.at(i);
+    builtInObjects.clear();
+    objectBvh.clear();
+    objectBounds.clear();
+    objectRevisions.clear();
+}
+
+bool Renderer::loadModel(const std::string &path, LoadTimes *times)
+{
+    TRACE_SCOPE_DETAIL("Renderer::loadModel", path.c_str());
+    auto start = std::chrono::steady_clock::now();
+    Mesh& mesh = model();
+    mesh.clear();
+    if (!mesh.loadModelFromFile(path))
+        return false;
+    auto imported = std::chrono::steady_clock::now();
+
+    mesh.genBuffers(&streamer);
+    if (times) {
+        //the uploads are only queued so far
+        glFinish();
+        auto uploaded = std::chrono::steady_clock::now();
+        times->importMilliseconds = std::chrono::duration<double, std::milli>(imported - start).count();
+        times->uploadMilliseconds = std::chrono::duration<double, std::milli>(uploaded - imported).count();
+    }
+    return true;
+}
+
+Mesh &Renderer::model()
+{
+    return *builtInMeshes.at(0);
+}
+
+const Mesh &Renderer::model() const
+{
+    return *builtInMeshes.at(0);
+}
+
+const std::vector<GameObject *> &Renderer::objects() const
+{
+    return builtInObjects;
+}
+
+const Bvh &Renderer::sceneBvh() const
+{
+    return objectBvh;
+}
+
+Picking::Hit Renderer::pick(int x, int y)
+{
+    updateSceneBvh();
+    updateMatrices();
+    Picking::Ray ray = Picking::rayThroughPixel(camera.GetViewMatrix(), m_projection, (float)x, (float)y, m_width, m_height);
+    return Picking::pick(objectBvh, builtInObjects, ray);
+}
+
+const std::vector<Light> &Renderer::lights() const
+{
+    return m_lights;
+}
+
+void Renderer::setLights(const std::vector<Light> &lights)
+{
+    m_lights = lights;
+}
+
+void Renderer::scatterLights(unsigned count)
+{
+    //fixed seed, so a given count always gives the same scene to compare against
+    std::mt19937 random(5489u);
+    std::uniform_real_distribution<float> x(-6.0f, 6.0f), y(-5.0f, 7.0f), z(-17.0f, 3.0f);
+    std::uniform_real_distribution<float> hue(0.0f, 1.0f);
+
+    m_lights.resize(std::min<size_t>(m_lights.size(), 1));
+    for (unsigned i = 1; i < count; i++)
+    {
+        Light light;
+        light.setPosition(x(random), y(random), z(random));
+        float h = hue(random) * 6.0f;
+        light.setColor(glm::clamp(std::abs(h - 3.0f) - 1.0f, 0.0f, 1.0f),
+                       glm::clamp(2.0f - std::abs(h - 2.0f), 0.0f, 1.0f),
+                       glm::clamp(2.0f - std::abs(h - 4.0f), 0.0f, 1.0f));
+        light.setAttenuation(1.0f);
+        light.setRange(2.5f);
+        m_lights.push_back(light);
+    }
+}
+
+GLuint Renderer::shadedFragments() const
+{
+    return lastShadedFragments;
+}
+
+const LightClusters &Renderer::lightClusters() const
+{
+    return clusters;
+}
+
+const TextureStreamer &Renderer::textureStreamer() const
+{
+    return streamer;
+}
+
+bool Renderer::isStreamingTextures() const
+{
+    return texturesStreaming;
+}
+
+std::vector<ShaderPermutations *> Renderer::shaderPermutations()
+{
+    return { &phongVariants, &gourandVariants, &gbufferVariants, &depthVariants, &deferredVariants };
+}
+
+void Renderer::render(GLuint framebuffer, int width, int height, bool interactive)
+{
+    TRACE_SCOPE("Renderer::render");
+    RenderStats::instance().beginFrame();
+    renderFrame(framebuffer, width, height, interactive);
+    RenderStats::instance().endFrame();
+}
+
+void Renderer::renderFrame(GLuint framebuffer, int width, int height, bool interactive)
+{
+    m_width = std::max(width, 1);
+    m_height = std::max(height, 1);
+    m_interactive = interactive;
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, m_width, m_height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    uint32_t features = shaderFeatures();
+    uint32_t lightFeatures = ShaderPermutations::lightBucket(directionalLightCount());
+    switch (shadingMode)
+    {
+        case GOURAUD:
+            curShader = gourandVariants.program(features | lightFeatures);
+            break;
+        case PHONG:
+            //per-vertex lighting is good enough while the camera is moving
+            if (interactive)
+                curShader = gourandVariants.program(features | lightFeatures);
+            else
+                curShader = phongVariants.program(features | lightFeatures);
+            break;
+        case DEFERRED:
+            curShader = gbufferVariants.program(features);
+            break;
+        default:
+            curShader = phongVariants.program(features | lightFeatures);
+            break;
+    }
+    //the variant doesn't compile, ShaderPermutations has logged why
+    if (curShader == nullptr)
+        return;
+
+    updateSceneBvh();
+    updateMatrices();
+
+    {
+        GL_DEBUG_GROUP("texture streaming");
+        PROFILE_GPU_ZONE("texture streaming");
+        streamTextures();
+    }
+
+    {
+        GL_DEBUG_GROUP("light binning");
+        PROFILE_GPU_ZONE("light binning");
+        clusters.update(m_lights, camera.GetViewMatrix(), camera.fiewOfView,
+                        (float)m_width / m_height, zNear, zFar);
+        clusters.upload();
+    }
+
+    if (lightMarkers)
+        paintLights();
+
+    //the deferred geometry pass is cheap already, lighting runs once per pixel anyway
+    bool deferred = shadingMode == DEFERRED;
+    if (deferred) {
+        gbuffer.resize(m_width, m_height);
+        gbuffer.bindForWriting();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    //wireframe rasterizes lines, which a filled depth pass would hide
+    bool prepass = depthPrepass && displayMode != WIREFRAME && !deferred;
+    if (prepass)
+        prepass = paintDepthPrepass();
+
+    curShader->bind();
+
+    {
+        PROFILE_GPU_ZONE("uniform upload");
+        uploadMatrices();
+        if (!deferred)
+            uploadLights(curShader);
+    }
+
+    //texture or color, textured variants don't have the material color
+    if (textureMode == COLOR)
+        curShader->setUniform("material.diffuse"_u, 1.0f, 1.0f, 1.0f);
+
+    if (prepass) {
+        //depth is final already, only the nearest fragment of each pixel passes
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+    }
+
+    //count what the shading pass actually shades, the result is read one frame later
+    GLuint samplesQuery = samplesQueries[samplesQueryFrame % 2];
+    GLuint availableQuery = samplesQueries[(samplesQueryFrame + 1) % 2];
+    if (samplesQueryFrame > 0) {
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(availableQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+            glGetQueryObjectuiv(availableQuery, GL_QUERY_RESULT, &lastShadedFragments);
+    }
+    glBeginQuery(GL_SAMPLES_PASSED, samplesQuery);
+
+    //fill, wireFrame or fillLine
+    switch (displayMode)
+    {
+        case FILL:
+        {
+            GL_DEBUG_GROUP("fill pass");
+            PROFILE_GPU_ZONE("fill pass");
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            for (unsigned i = 0; i < builtInObjects.size(); i++)
+            {
+                builtInObjects.at(i)->setShaderProgram(curShader);
+                builtInObjects.at(i)->paint();
+            }
+            break;
+        }
+        case FILLLINES: //single pass: fill, with the edges blended in by the fragment shader
+        {
+            GL_DEBUG_GROUP("fill lines pass");
+            PROFILE_GPU_ZONE("fill lines pass");
+            curShader->setUniform("wire_color"_u, 0.0f, 0.0f, 0.0f);
+            curShader->setUniform("wire_width"_u, 1.0f);
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            for (unsigned i = 0; i < builtInObjects.size(); i++)
+            {
+                builtInObjects.at(i)->setShaderProgram(curShader);
+                builtInObjects.at(i)->paint();
+            }
+            break;
+        }
+        case WIREFRAME:
+        {
+            GL_DEBUG_GROUP("wireframe pass");
+            PROFILE_GPU_ZONE("wireframe pass");
+            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+            for (unsigned i = 0; i < builtInObjects.size(); i++)
+            {
+                builtInObjects.at(i)->setShaderProgram(curShader);
+                builtInObjects.at(i)->paint();
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    curShader->release();
+
+    glEndQuery(GL_SAMPLES_PASSED);
+    samplesQueryFrame++;
+
+    if (prepass) {
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
+
+    if (deferred)
+        paintDeferredLighting(framebuffer);
+}
+
+FrameCapture Renderer::captureFrame(FrameCapture::Geometry geometry) const
+{
+    FrameCapture capture;
+    capture.displayMode = displayMode;
+    capture.shadingMode = shadingMode;
+    capture.textureMode = textureMode;
+    capture.flat = flat_flag;
+    capture.depthPrepass = depthPrepass;
+    capture.interactive = m_interactive;
+    capture.width = m_width;
+    capture.height = m_height;
+
+    capture.camera.position = camera.position;
+    capture.camera.up = camera.givenCamUp;
+    capture.camera.yaw = camera.yaw;
+    capture.camera.pitch = camera.pitch;
+    capture.camera.fieldOfView = camera.fiewOfView;
+
+    for (const Light& light : m_lights)
+        capture.lights.push_back({ light.type(), light.position(), light.direction(), light.intensity(),
+                                   light.attenuation(), light.range() });
+    for (const GameObject* object : builtInObjects)
+        capture.objects.push_back({ object->position(), object->scalar(), object->rotation() });
+
+    //an empty model has no file, there is nothing to embed either
+    const Mesh& mesh = model();
+    capture.geometry = geometry;
+    capture.modelPath = mesh.name();
+    if (geometry != FrameCapture::REFERENCE)
+    {
+        for (size_t i = 0; i < mesh.subMeshes().size(); i++)
+        {
+            const SubMesh& subMesh = mesh.subMeshes().at(i);
+            capture.subMeshes.push_back({ subMesh.step, mesh.subMeshTransform(i), subMesh.vertices, subMesh.indices,
+                                          subMesh.texIndices });
+        }
+        for (const Texture& texture : mesh.textures())
+            capture.textures.push_back({ texture.type, texture.fileName });
+        if (geometry == FrameCapture::ANONYMIZE)
+        {
+            capture.anonymize();
+            capture.modelPath = "anonymized model";
+        }
+    }
+    return capture;
+}
+
+bool Renderer::replayFrame(const FrameCapture &capture)
+{
+    displayMode = (DISPLAYMODE)capture.displayMode;
+    shadingMode = (SHADINGMODE)capture.shadingMode;
+    textureMode = (TEXTUREMODE)capture.textureMode;
+    flat_flag = capture.flat;
+    depthPrepass = capture.depthPrepass;
+
+    camera.position = capture.camera.position;
+    camera.givenCamUp = capture.camera.up;
+    camera.yaw = capture.camera.yaw;
+    camera.pitch = capture.camera.pitch;
+    camera.fiewOfView = capture.camera.fieldOfView;
+    //recomputes the camera vectors from the angles
+    camera.rotate(0.0f, 0.0f);
+
+    m_lights.clear();
+    for (const FrameCapture::Light& captured : capture.lights)
+    {
+        Light light;
+        light.setType((Light::LightType)captured.type);
+        light.setPosition(captured.position);
+        light.setDirection(captured.direction);
+        light.setColor(captured.intensity.x, captured.intensity.y, captured.intensity.z);
+        light.setAttenuation(captured.attenuation);
+        light.setRange(captured.range);
+        m_lights.push_back(light);
+    }
+
+    if (capture.objects.size() != builtInObjects.size())
+        qDebug("The capture has %d objects, the scene %d", (int)capture.objects.size(), (int)builtInObjects.size());
+    for (size_t i = 0; i < std::min(capture.objects.size(), builtInObjects.size()); i++)
+    {
+        builtInObjects.at(i)->setPosition(capture.objects.at(i).position);
+        builtInObjects.at(i)->setScalar(capture.objects.at(i).scale);
+        builtInObjects.at(i)->setRotation(capture.objects.at(i).rotation);
+    }
+
+    Mesh& mesh = model();
+    if (capture.geometry == FrameCapture::REFERENCE)
+    {
+        if (!capture.modelPath.empty())
+            return loadModel(capture.modelPath);
+        mesh.clear();
+        return true;
+    }
+
+    mesh.clear();
+    mesh.setName(capture.modelPath);
+    for (const FrameCapture::Texture& captured : capture.textures)
+    {
+        Texture texture;
+        texture.objectId = 0;
+        texture.layer = -1;
+        texture.type = (TextureType)captured.type;
+        texture.fileName = captured.fileName;
+        mesh.addTexture(texture);
+    }
+    for (const FrameCapture::SubMesh& captured : capture.subMeshes)
+    {
+        //a damaged file mustn't index past the vertices or the textures; genBuffers() reads whole
+        //vertices of the fixed layout, so any other step would have the GPU read past the buffer
+        if (captured.step != SubMesh::VERTEX_STEP || captured.vertices.size() % captured.step != 0)
+        {
+            qDebug("Skipping a captured sub-mesh with %d floats at a step of %d, the layout has %d",
+                   (int)captured.vertices.size(), (int)captured.step, (int)SubMesh::VERTEX_STEP);
+            continue;
+        }
+        const size_t vertexCount = captured.vertices.size() / captured.step;
+        if (std::any_of(captured.indices.begin(), captured.indices.end(),
+                        [&](uint32_t index) { return index >= vertexCount; }))
+        {
+            qDebug("Skipping a captured sub-mesh with indices past its %d vertices", (int)vertexCount);
+            continue;
+        }
+        std::vector<unsigned> texIndices;
+        for (uint32_t index : captured.texIndices)
+            if (index < capture.textures.size())
+                texIndices.push_back(index);
+        //the hierarchy isn't captured, a node per sub-mesh puts each where it was
+        const int node = mesh.sceneGraph().addNode("sub-mesh " + std::to_string(mesh.subMeshes().size()), -1,
+                                                   captured.transform);
+        mesh.sceneGraph().setSubMeshes(node, (uint32_t)mesh.subMeshes().size(), 1);
+        mesh.addSubMesh(SubMesh(captured.vertices, captured.indices, texIndices, captured.step), node);
+    }
+    mesh.genBuffers(&streamer);
+    return true;
+}
+
+void Renderer::updateMatrices()
+{
+    m_projection = glm::perspective(glm::radians(camera.fiewOfView), (float)m_width / m_height, zNear, zFar);
+}
+
+void Renderer::uploadMatrices()
+{
+    //upload matrix, objects set their own model matrix when they paint
+    curShader->setUniformMatrix4("view"_u, glm::value_ptr(camera.GetViewMatrix()), 1, GL_FALSE);
+    curShader->setUniformMatrix4("view_inv"_u, glm::value_ptr(glm::inverse(camera.GetViewMatrix())), 1, GL_FALSE);
+    curShader->setUniform("projection"_u, m_projection);
+    curShader->setUniform("model"_u, glm::mat4(1.0f));
+}
+
+void Renderer::streamTextures()
+{
+    //untextured frames ask for nothing, so the streamer drops back to the small levels
+    if (textureMode == TEXTURE)
+    {
+        //pixels a unit long object covers at distance one
+        float pixelsPerUnit = m_height / (2.0f * std::tan(glm::radians(camera.fiewOfView) * 0.5f));
+        glm::mat4 view = camera.GetViewMatrix();
+        for (GameObject* object : builtInObjects)
+        {
+            Mesh* mesh = object->mesh();
+            if (mesh == nullptr)
+                continue;
+            glm::mat4 model = object->modelMatrix();
+            float scale = std::max(glm::length(glm::vec3(model[0])),
+                                   std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+            float radius = mesh->boundingRadius() * scale;
+            float distance = -(view * model * glm::vec4(mesh->boundingCenter(), 1.0f)).z;
+            //entirely behind the camera
+            if (distance + radius < zNear)
+                continue;
+            mesh->requestTextureDetail(streamer, 2.0f * radius * pixelsPerUnit / std::max(distance, zNear));
+        }
+    }
+
+    //frames should keep coming while levels are read, they are uploaded by the frames after
+    texturesStreaming = streamer.update();
+}
+
+void Renderer::uploadLights(ShaderProgram *program)
+{
+    program->setUniform("ambientLight"_u, lightAmbient.x, lightAmbient.y, lightAmbient.z);
+
+    //directional lights go through the uniform array, point lights through the clusters;
+    //variants built for no directional lights don't have the array at all
+    const unsigned maxDirectionalLights = 10; //the largest MAX_LIGHTS bucket
+    unsigned numDirectional = 0;
+    for (unsigned i = 0; program->hasUniform("numLights"_u) && i < m_lights.size() && numDirectional < maxDirectionalLights; i++)
+    {
+        if (m_lights.at(i).position().w != 0.0f)
+            continue;
+        program->setArrayUniform("allLights", numDirectional, m_lights.at(i).intensity(), "intensity");
+        program->setArrayUniform("allLights", numDirectional, m_lights.at(i).position(), "position");
+        program->setArrayUniform("allLights", numDirectional, m_lights.at(i).attenuation(), "attenuation");
+        numDirectional++;
+    }
+    if (program->hasUniform("numLights"_u))
+        program->setUniform("numLights"_u, (int)numDirectional);
+
+    clusters.bind(program, clusterTextureUnit);
+}
+
+unsigned Renderer::directionalLightCount() const
+{
+    unsigned count = 0;
+    for (unsigned i = 0; i < m_lights.size(); i++)
+        if (m_lights.at(i).position().w == 0.0f)
+            count++;
+    return count;
+}
+
+uint32_t Renderer::shaderFeatures() const
+{
+    uint32_t features = 0;
+    if (flat_flag)
+        features |= ShaderPermutations::FLAT;
+    if (textureMode == TEXTURE)
+        features |= ShaderPermutations::TEXTURED;
+    //fill-lines draws the wireframe in the same pass, with the geometry shader variants
+    if (displayMode == FILLLINES)
+        features |= ShaderPermutations::WIREFRAME_OVERLAY;
+    return features;
+}
+
+void Renderer::updateSceneBvh()
+{
+    TRACE_SCOPE("Renderer::updateSceneBvh");
+    auto revisionOf = [](const GameObject* object) {
+        const Mesh* mesh = object->mesh();
+        return ObjectRevision{ object->revision(), mesh, mesh ? mesh->boundsRevision() : 0 };
+    };
+    auto boundsOf = [](const GameObject* object) {
+        return object->mesh() ? object->mesh()->bounds().transformed(object->modelMatrix()) : Aabb();
+    };
+
+    //objects came or went, start over
+    if (objectRevisions.size() != builtInObjects.size())
+    {
+        objectRevisions.resize(builtInObjects.size());
+        objectBounds.resize(builtInObjects.size());
+        for (size_t i = 0; i < builtInObjects.size(); i++)
+        {
+            objectRevisions[i] = revisionOf(builtInObjects[i]);
+            objectBounds[i] = boundsOf(builtInObjects[i]);
+        }
+        objectBvh.build(objectBounds);
+        objectBvhBuildCost = objectBvh.statistics().sahCost;
+        return;
+    }
+
+    changedObjects.clear();
+    for (size_t i = 0; i < builtInObjects.size(); i++)
+    {
+        ObjectRevision revision = revisionOf(builtInObjects[i]);
+        if (revision != objectRevisions[i])
+        {
+            objectRevisions[i] = revision;
+            objectBounds[i] = boundsOf(builtInObjects[i]);
+            changedObjects.push_back((uint32_t)i);
+        }
+    }
+    if (changedObjects.empty())
+        return;
+
+    objectBvh.refit(objectBounds, changedObjects);
+    if (objectBvh.statistics().sahCost <= objectBvhBuildCost * REBUILD_COST)
+        return;
+    objectBvh.build(objectBounds);
+    objectBvhBuildCost = objectBvh.statistics().sahCost;
+}
+
+void Renderer::setBuiltInObject()
+{
+    float vertices[] = {
+        // positions          // normals           // texture coords
+        -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
+         0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  0.0f,
+         0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  1.0f,
+         0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  1.0f,
+        -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  1.0f,
+        -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
+
+        -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  0.0f,
+         0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  0.0f,
+         0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  1.0f,
+         0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  1.0f,
+        -0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  1.0f,
+        -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  0.0f,
+
+        -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
+        -0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
+        -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
+        -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
+        -0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
+        -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
+
+         0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
+         0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
+         0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
+         0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
+         0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
+         0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
+
+        -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  1.0f,
+         0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  1.0f,
+         0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  0.0f,
+         0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  0.0f,
+        -0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  0.0f,
+        -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  1.0f,
+
+        -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  1.0f,
+         0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  1.0f,
+         0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  0.0f,
+         0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  0.0f,
+        -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  0.0f,
+        -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  1.0f
+    };
+
+    int size = sizeof(vertices) / sizeof(float);
+    std::vector<float> v(vertices, vertices + size);
+    unsigned indSize = size / 8;
+    std::vector<unsigned> indices(indSize);
+    for (unsigned i = 0; i < indSize; i++) indices[i] = i;
+    std::vector<unsigned> texIndices;
+    texIndices.push_back(0);
+    texIndices.push_back(1);
+    SubMesh sm(v, indices, texIndices, 8);
+
+    initLightVAO(v);
+
+    Mesh* m = new Mesh();
+    m->setName("built-in cube");
+    m->addSubMesh(sm);
+    Texture t;
+    t.objectId = 0;
+    t.layer = -1;
+    t.fileName = "models/textures/container2.png";
+    t.type = TextureType::diffuse;
+    m->addTexture(t);
+    t.fileName = "models/textures/container2_specular.png";
+    t.type = TextureType::specular;
+    m->addTexture(t);
+    builtInMeshes.push_back(m);
+
+    for(unsigned i = 0; i < builtInMeshes.size(); i++)
+        builtInMeshes.at(i)->genBuffers(&streamer);
+
+
+    // positions all containers
+    glm::vec3 cubePositions[] = {
+        glm::vec3( 0.0f,  0.0f,  0.0f),
+        glm::vec3( 2.0f,  5.0f, -15.0f),
+        glm::vec3(-1.5f, -2.2f, -2.5f),
+        glm::vec3(-3.8f, -2.0f, -12.3f),
+        glm::vec3( 2.4f, -0.4f, -3.5f),
+        glm::vec3(-1.7f,  3.0f, -7.5f),
+        glm::vec3( 1.3f, -2.0f, -2.5f),
+        glm::vec3( 1.5f,  2.0f, -2.5f),
+        glm::vec3( 1.5f,  0.2f, -1.5f),
+        glm::vec3(-1.3f,  1.0f, -1.5f)
+    };
+
+
+    for (unsigned int i = 0; i < 10; i++)
+    {
+        GameObject* gameObject = new GameObject();
+        gameObject->setMesh(builtInMeshes.back());
+        gameObject->setPosition(cubePositions[i]);
+        float angle = 20.0f * i;
+        gameObject->rotate(angle, glm::vec3(1.0f, 0.3f, 0.5f));
+        builtInObjects.push_back(gameObject);
+    }
+
+
+}
+
+void Renderer::initLightVAO(const std::vector<float> &v)
+{
+    unsigned int VBO;
+    glGenVertexArrays(1, &lightVAO);
+    glGenBuffers(1, &VBO);
+
+    glBindVertexArray(lightVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+
+    glBufferData(GL_ARRAY_BUFFER, v.size() * sizeof(float), &v[0], GL_STATIC_DRAW);
+
+    // note that we update the lamp's position attribute's stride to reflect the updated buffer data
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    //one (position, scale) per instance
+    glGenBuffers(1, &lightInstanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, lightInstanceVBO);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+
+    glBindVertexArray(0);
+
+    GLDebug::setObjectLabel(GL_VERTEX_ARRAY, lightVAO, "light cube VAO");
+    GLDebug::setObjectLabel(GL_BUFFER, VBO, "light cube VBO");
+    GLDebug::setObjectLabel(GL_BUFFER, lightInstanceVBO, "light instance VBO");
+}
+
+bool Renderer::paintDepthPrepass()
+{
+    ShaderProgram* depthProgram = depthVariants.program(0);
+    if (depthProgram == nullptr)
+        return false;
+
+    GL_DEBUG_GROUP("depth pre-pass");
+    PROFILE_GPU_ZONE("depth pre-pass");
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+    depthProgram->bind();
+    depthProgram->setUniform("projection"_u, m_projection);
+    depthProgram->setUniform("view"_u, camera.GetViewMatrix());
+    for (unsigned i = 0; i < builtInObjects.size(); i++)
+        builtInObjects.at(i)->paintDepth(depthProgram);
+    depthProgram->release();
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    return true;
+}
+
+void Renderer::paintDeferredLighting(GLuint framebuffer)
+{
+    ShaderProgram* deferredLightingShader =
+            deferredVariants.program(ShaderPermutations::lightBucket(directionalLightCount()));
+    if (deferredLightingShader == nullptr)
+        return;
+
+    GL_DEBUG_GROUP("deferred lighting pass");
+    PROFILE_GPU_ZONE("deferred lighting pass");
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, gbuffer.width(), gbuffer.height());
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    glm::mat4 view = camera.GetViewMatrix();
+    glm::mat4 projection = m_projection;
+
+    deferredLightingShader->bind();
+    gbuffer.bindTextures(0);
+    deferredLightingShader->setUniform("gbuffer_albedoSpecular"_u, (int)GBuffer::ALBEDO_SPECULAR);
+    deferredLightingShader->setUniform("gbuffer_normal"_u, (int)GBuffer::NORMAL);
+    deferredLightingShader->setUniform("gbuffer_depth"_u, (int)GBuffer::DEPTH);
+    deferredLightingShader->setUniform("view"_u, view);
+    deferredLightingShader->setUniform("view_inv"_u, glm::inverse(view));
+    deferredLightingShader->setUniform("projection"_u, projection);
+    deferredLightingShader->setUniform("viewProjection_inv"_u, glm::inverse(projection * view));
+    uploadLights(deferredLightingShader);
+
+    //the light cubes are in the depth buffer already, the pass writes the g-buffer depth against them
+    glBindVertexArray(screenVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    RenderStats& stats = RenderStats::instance();
+    stats.countVaoBind();
+    stats.countDraw(GL_TRIANGLES, 3);
+    stats.countVaoBind();
+
+    //the next geometry pass renders into these
+    for (unsigned i = 0; i < GBuffer::TARGET_COUNT; i++)
+    {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        stats.countTextureBind();
+    }
+    glActiveTexture(GL_TEXTURE0);
+    deferredLightingShader->release();
+}
+
+void Renderer::paintLights()
+{
+    GL_DEBUG_GROUP("lights pass");
+    PROFILE_GPU_ZONE("lights pass");
+    lightProgram->bind();
+    lightProgram->setUniform("projection"_u, m_projection);
+    lightProgram->setUniform("view"_u, camera.GetViewMatrix());
+    RenderStats& stats = RenderStats::instance();
+
+    //every light in one draw, a smaller cube for lights with a short reach
+    lightInstances.clear();
+    for (const Light& light : m_lights)
+        lightInstances.push_back(glm::vec4(glm::vec3(light.position()), std::min(1.0f, light.range() * 0.05f)));
+    glBindBuffer(GL_ARRAY_BUFFER, lightInstanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, lightInstances.size() * sizeof(glm::vec4), lightInstances.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindVertexArray(lightVAO);
+    stats.countVaoBind();
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 36, (GLsizei)lightInstances.size());
+    stats.countDraw(GL_TRIANGLES, 36 * lightInstances.size());
+
+    glBindVertexArray(0);
+    stats.countVaoBind();
+    lightProgram->release();
+}
@@ -0,0 +1,46 @@
+#include "renderstats.h"
+
+using namespace makai;
+
+RenderStats::RenderStats() : m_current(), m_lastFrame(), m_frameCount(0)
+{
+
+}
+
+RenderStats &RenderStats::instance()
+{
+    static RenderStats stats;
+    return stats;
+}
+
+void RenderStats::beginFrame()
+{
+    m_current = Counters();
+}
+
+void RenderStats::endFrame()
+{
+    m_lastFrame = m_current;
+    m_frameCount++;
+
+    if (!m_log.is_open())
+        return;
+    m_log << "{\"frame\":" << m_frameCount
+          << ",\"draw_calls\":" << m_lastFrame.drawCalls
+          << ",\"triangles\":" << m_lastFrame.triangles
+          << ",\"vertices\":" << m_lastFrame.vertices
+          << ",\"program_binds\":" << m_lastFrame.programBinds
+          << ",\"texture_binds\":" << m_lastFrame.textureBinds
+          << ",\"vao_binds\":" << m_lastFrame.vaoBinds
+          << ",\"uniform_calls\":" << m_lastFrame.uniformCalls << "}\n";
+}
+
+bool RenderStats::setLogFile(const std::string &fileName)
+{
+    if (m_log.is_open())
+        m_log.close();
+    if (fileName.empty())
+        return true;
+    m_log.open(fileName, std::ios::out | std::ios::trunc);
+    return m_log.is_open();
+}
@@ -0,0 +1,83 @@
+#include "scenegraph.h"
+
+#include <algorithm>
+
+using namespace makai;
+
+int SceneGraph::addNode(const std::string &name, int parent, const glm::mat4 &local)
+{
+    const int index = (int)m_parents.size();
+    if (parent >= index)
+        parent = -1;
+    m_names.push_back(name);
+    m_parents.push_back(parent);
+    m_subtreeEnds.push_back(index + 1);
+    m_firstSubMeshes.push_back(0);
+    m_subMeshCounts.push_back(0);
+    m_locals.push_back(local);
+    m_worlds.push_back(local);
+    m_dirty.push_back(1);
+
+    //the new node ends the subtrees of all its ancestors
+    for (int ancestor = parent; ancestor >= 0; ancestor = m_parents[ancestor])
+        m_subtreeEnds[ancestor] = index + 1;
+    return index;
+}
+
+void SceneGraph::setSubMeshes(int node, uint32_t first, uint32_t count)
+{
+    m_firstSubMeshes[node] = first;
+    m_subMeshCounts[node] = count;
+}
+
+int SceneGraph::find(const std::string &name) const
+{
+    auto found = std::find(m_names.begin(), m_names.end(), name);
+    return found != m_names.end() ? (int)(found - m_names.begin()) : -1;
+}
+
+void SceneGraph::setLocalTransform(int node, const glm::mat4 &local)
+{
+    m_locals[node] = local;
+    m_revision++;
+    //a dirty node has a dirty subtree already
+    if (m_dirty[node])
+        return;
+    std::fill(m_dirty.begin() + node, m_dirty.begin() + m_subtreeEnds[node], 1);
+}
+
+const glm::mat4 &SceneGraph::worldTransform(int node) const
+{
+    if (m_dirty[node]) {
+        const int parent = m_parents[node];
+        m_worlds[node] = parent >= 0 ? worldTransform(parent) * m_locals[node] : m_locals[node];
+        m_dirty[node] = 0;
+    }
+    return m_worlds[node];
+}
+
+void SceneGraph::updateWorldTransforms() const
+{
+    //parents come first, their worlds are current by the time their children need them
+    for (size_t node = 0; node < m_parents.size(); node++)
+    {
+        if (!m_dirty[node])
+            continue;
+        const int parent = m_parents[node];
+        m_worlds[node] = parent >= 0 ? m_worlds[parent] * m_locals[node] : m_locals[node];
+        m_dirty[node] = 0;
+    }
+}
+
+void SceneGraph::clear()
+{
+    m_names.clear();
+    m_parents.clear();
+    m_subtreeEnds.clear();
+    m_firstSubMeshes.clear();
+    m_subMeshCounts.clear();
+    m_locals.clear();
+    m_worlds.clear();
+    m_dirty.clear();
+    m_revision++;
+}
@@ -1,9 +1,13 @@
 #include "shader.h"
+#include "makaidebug.h"
+
+#include <algorithm>
 
 using namespace makai;
 
 Shader::Shader(ShaderType type) : m_type(type), m_isCompiled(false),
-    m_log(), m_id(0), m_code()
+    m_log(), m_id(0), m_code(), m_fileName(),
+    m_compileStart(), m_compileMilliseconds(0.0), m_compileDone(false)
 {
 
 }
@@ -13,25 +17,75 @@ Shader::~Shader()
     glDeleteShader(m_id);
 }
 
-bool Shader::compileSourceCode(const std::string &source)
+bool Shader::compileSourceCode(const std::string &source, const std::vector<std::string> &defines)
+{
+    return beginCompile(source, defines) && finishCompile();
+}
+
+bool Shader::compileSourceFile(const std::string &fileName, const std::vector<std::string> &defines)
+{
+    return beginCompileFile(fileName, defines) && finishCompile();
+}
+
+bool Shader::beginCompile(const std::string &source, const std::vector<std::string> &defines)
 {
     if (m_type == ShaderType::Vertex)
         m_id = glCreateShader(GL_VERTEX_SHADER);
     else if (m_type == ShaderType::Fragment)
         m_id = glCreateShader(GL_FRAGMENT_SHADER);
+    else if (m_type == ShaderType::Geometry)
+        m_id = glCreateShader(GL_GEOMETRY_SHADER);
 
     if (m_id == 0) {
         m_log += "glCreateShader failed";
         return false;
     }
 
-    const GLchar* code = source.c_str();
+    m_compileStart = std::chrono::steady_clock::now();
+    m_compileDone = false;
+
+    std::string fullSource = insertDefines(source, defines);
+    const GLchar* code = fullSource.c_str();
     glShaderSource(m_id, 1, &code, NULL);
     glCompileShader(m_id);
+    return true;
+}
+
+bool Shader::beginCompileFile(const std::string &fileName, const std::vector<std::string> &defines)
+{
+    m_fileName = fileName;
+
+    if (!readSourceFile(fileName, m_code, m_log))
+        return false;
+
+    return beginCompile(m_code, defines);
+}
+
+bool Shader::isCompileComplete()
+{
+    if (m_compileDone)
+        return true;
+
+    if (GLEW_ARB_parallel_shader_compile)
+    {
+        GLint done = GL_FALSE;
+        glGetShaderiv(m_id, GL_COMPLETION_STATUS_ARB, &done);
+        if (!done)
+            return false;
+    }
+    stampCompileDone();
+    return true;
+}
+
+bool Shader::finishCompile()
+{
+    if (m_id == 0)
+        return false;
 
     // Print compile errors if any
     GLint success;
     glGetShaderiv(m_id, GL_COMPILE_STATUS, &success);
+    stampCompileDone();
     if (!success)
     {
         GLint infoLogLength;
@@ -47,11 +101,41 @@ bool Shader::compileSourceCode(const std::string &source)
         return false;
     }
 
+    GLDebug::setObjectLabel(GL_SHADER, m_id, m_fileName.empty() ? std::string("inline shader") : m_fileName);
+
     m_isCompiled = true;
     return true;
 }
 
-bool Shader::compileSourceFile(const std::string &fileName)
+double Shader::compileMilliseconds() const
+{
+    return m_compileMilliseconds;
+}
+
+void Shader::stampCompileDone()
+{
+    if (m_compileDone)
+        return;
+    m_compileDone = true;
+    m_compileMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_compileStart).count();
+}
+
+bool Shader::readSourceFile(const std::string &fileName, std::string &source, std::string &log,
+                            std::vector<std::string> *includedFiles)
+{
+    if (!readFile(fileName, source, log))
+        return false;
+
+    std::vector<std::string> included;
+    if (!expandIncludes(fileName, source, log, included))
+        return false;
+
+    if (includedFiles)
+        includedFiles->insert(includedFiles->end(), included.begin(), included.end());
+    return true;
+}
+
+bool Shader::readFile(const std::string &fileName, std::string &source, std::string &log)
 {
     std::ifstream shaderFile;
     std::stringstream shaderStream;
@@ -59,6 +143,12 @@ bool Shader::compileSourceFile(const std::string &fileName)
     {
         // Open files
         shaderFile.open(fileName);
+        if (!shaderFile.is_open())
+        {
+            log += __FUNCTION__;
+            log += ": cannot open " + fileName + "\n";
+            return false;
+        }
         // Read file's buffer contents into streams
         shaderStream << shaderFile.rdbuf();
         // close file handlers
@@ -67,16 +157,87 @@ bool Shader::compileSourceFile(const std::string &fileName)
     }
     catch (std::ifstream::failure e)
     {
-        m_log += __FUNCTION__;
-        m_log += ": ";
-        m_log += e.what();
-        m_log += "\n";
+        log += __FUNCTION__;
+        log += ": ";
+        log += e.what();
+        log += "\n";
         return false;
     }
 
-    m_code = shaderStream.str();
+    source = shaderStream.str();
+    return true;
+}
+
+bool Shader::expandIncludes(const std::string &fileName, std::string &source, std::string &log,
+                            std::vector<std::string> &included)
+{
+    const std::string directive = "#include";
+    size_t slash = fileName.find_last_of("/\\");
+    std::string directory = slash == std::string::npos ? std::string() : fileName.substr(0, slash + 1);
+
+    std::string result;
+    size_t lineStart = 0;
+    while (lineStart < source.size())
+    {
+        size_t lineEnd = source.find('\n', lineStart);
+        if (lineEnd == std::string::npos)
+            lineEnd = source.size();
+        std::string line = source.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+
+        size_t first = line.find_first_not_of(" \t");
+        if (first == std::string::npos || line.compare(first, directive.size(), directive) != 0)
+        {
+            result += line + "\n";
+            continue;
+        }
 
-    return compileSourceCode(m_code);
+        size_t open = line.find('"', first + directive.size());
+        size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+        if (close == std::string::npos)
+        {
+            log += fileName + ": malformed " + line + "\n";
+            return false;
+        }
+
+        // once per file, which also ends include cycles
+        std::string includeName = directory + line.substr(open + 1, close - open - 1);
+        if (std::find(included.begin(), included.end(), includeName) != included.end())
+            continue;
+        included.push_back(includeName);
+
+        std::string includeSource;
+        if (!readFile(includeName, includeSource, log) ||
+            !expandIncludes(includeName, includeSource, log, included))
+            return false;
+        result += includeSource;
+        if (!includeSource.empty() && includeSource.back() != '\n')
+            result += "\n";
+    }
+
+    source = result;
+    return true;
+}
+
+std::string Shader::insertDefines(const std::string &source, const std::vector<std::string> &defines)
+{
+    if (defines.empty())
+        return source;
+
+    std::string defineLines;
+    for (const std::string& define : defines)
+        defineLines += "#define " + define + "\n";
+
+    // #version has to stay the first statement
+    size_t versionPos = source.find("#version");
+    if (versionPos == std::string::npos)
+        return defineLines + source;
+
+    size_t lineEnd = source.find('\n', versionPos);
+    if (lineEnd == std::string::npos)
+        return source + "\n" + defineLines;
+
+    return source.substr(0, lineEnd + 1) + defineLines + source.substr(lineEnd + 1);
 }
 
 bool Shader::isCompiled() const
@@ -103,3 +264,8 @@ std::string Shader::sourceCode() const
 {
     return m_code;
 }
+
+std::string Shader::fileName() const
+{
+    return m_fileName;
+}
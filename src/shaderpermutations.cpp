@@ -0,0 +1,192 @@
+#include "shaderpermutations.h"
+
+#include <QElapsedTimer>
+
+#include <algorithm>
+
+using namespace makai;
+
+const unsigned ShaderPermutations::LIGHT_BUCKETS[LIGHT_BUCKET_COUNT] = { 0, 1, 4, 10 };
+
+uint32_t ShaderPermutations::lightBucket(unsigned lightCount)
+{
+    for (unsigned i = 0; i < LIGHT_BUCKET_COUNT; i++)
+        if (lightCount <= LIGHT_BUCKETS[i])
+            return i << LIGHT_BUCKET_SHIFT;
+    //more lights than the largest bucket, the caller uploads only that many
+    return (LIGHT_BUCKET_COUNT - 1) << LIGHT_BUCKET_SHIFT;
+}
+
+std::vector<std::string> ShaderPermutations::defines(uint32_t features)
+{
+    std::vector<std::string> result;
+    if (features & FLAT)
+        result.push_back("FLAT");
+    if (features & TEXTURED)
+        result.push_back("TEXTURED");
+    if (features & WIREFRAME_OVERLAY)
+        result.push_back("WIREFRAME_OVERLAY");
+    unsigned bucket = (features & LIGHT_BUCKET_MASK) >> LIGHT_BUCKET_SHIFT;
+    result.push_back("MAX_LIGHTS " + std::to_string(LIGHT_BUCKETS[bucket]));
+    return result;
+}
+
+ShaderPermutations::ShaderPermutations(const std::string &name) : m_name(name), m_stages(), m_programs(), m_reloads()
+{
+
+}
+
+ShaderPermutations::~ShaderPermutations()
+{
+    clear();
+}
+
+void ShaderPermutations::addShaderFile(Shader::ShaderType type, const std::string &fileName, uint32_t requiredFeatures)
+{
+    Stage stage;
+    stage.type = type;
+    stage.fileName = fileName;
+    stage.requiredFeatures = requiredFeatures;
+    m_stages.push_back(stage);
+}
+
+ShaderProgram *ShaderPermutations::program(uint32_t features)
+{
+    auto it = m_programs.find(features);
+    if (it != m_programs.end())
+        return it->second;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    bool success = true;
+    ShaderProgram* program = createVariant(features, success);
+    success = success && program->link();
+
+    if (!success)
+    {
+        qDebug("%s failed:", variantName(features).c_str());
+        qDebug() << program->log().data();
+        delete program;
+        program = nullptr;
+    }
+    else
+    {
+        qDebug("%s ready in %lld ms%s", variantName(features).c_str(), timer.elapsed(),
+               program->isFromBinaryCache() ? " (binary cache)" : "");
+    }
+
+    m_programs[features] = program;
+    return program;
+}
+
+void ShaderPermutations::reload()
+{
+    for (auto& pending : m_reloads)
+        delete pending.second;
+    m_reloads.clear();
+
+    for (auto& variant : m_programs)
+    {
+        bool success = true;
+        ShaderProgram* program = createVariant(variant.first, success);
+        if (!success || !program->beginLink())
+        {
+            qDebug("%s reload failed, keeping the old program:", variantName(variant.first).c_str());
+            qDebug() << program->log().data();
+            delete program;
+            continue;
+        }
+        m_reloads[variant.first] = program;
+    }
+}
+
+bool ShaderPermutations::pollReload()
+{
+    bool changed = false;
+    for (auto it = m_reloads.begin(); it != m_reloads.end(); )
+    {
+        ShaderProgram* program = it->second;
+        ShaderProgram::LinkStatus status = program->pollLink();
+        if (status == ShaderProgram::LINK_PENDING)
+        {
+            ++it;
+            continue;
+        }
+
+        if (status == ShaderProgram::LINK_DONE)
+        {
+            qDebug("%s reloaded%s", variantName(it->first).c_str(),
+                   program->isFromBinaryCache() ? " (binary cache)" : "");
+            delete m_programs[it->first];
+            m_programs[it->first] = program;
+            changed = true;
+        }
+        else
+        {
+            qDebug("%s reload failed, keeping the old program:", variantName(it->first).c_str());
+            qDebug() << program->log().data();
+            delete program;
+        }
+        it = m_reloads.erase(it);
+    }
+    return changed;
+}
+
+bool ShaderPermutations::isReloading() const
+{
+    return !m_reloads.empty();
+}
+
+std::vector<std::string> ShaderPermutations::files() const
+{
+    std::vector<std::string> result;
+    for (const Stage& stage : m_stages)
+    {
+        //the files it includes, which change the programs just the same
+        std::vector<std::string> stageFiles(1, stage.fileName);
+        std::string source, log;
+        Shader::readSourceFile(stage.fileName, source, log, &stageFiles);
+        for (const std::string& file : stageFiles)
+            if (std::find(result.begin(), result.end(), file) == result.end())
+                result.push_back(file);
+    }
+    return result;
+}
+
+size_t ShaderPermutations::size() const
+{
+    return m_programs.size();
+}
+
+void ShaderPermutations::clear()
+{
+    for (auto& pending : m_reloads)
+        delete pending.second;
+    m_reloads.clear();
+
+    for (auto& variant : m_programs)
+        delete variant.second;
+    m_programs.clear();
+}
+
+ShaderProgram *ShaderPermutations::createVariant(uint32_t features, bool &success) const
+{
+    std::vector<std::string> variantDefines = defines(features);
+    ShaderProgram* program = new ShaderProgram();
+    for (const Stage& stage : m_stages)
+    {
+        if ((features & stage.requiredFeatures) != stage.requiredFeatures)
+            continue;
+        success = program->addShaderFromFile(stage.type, stage.fileName, variantDefines) && success;
+    }
+    return program;
+}
+
+std::string ShaderPermutations::variantName(uint32_t features) const
+{
+    std::string name = m_name + " variant";
+    for (const std::string& define : defines(features))
+        name += " " + define;
+    return name;
+}
@@ -1,13 +1,39 @@
 #include "shaderprogram.h"
+#include "makaidebug.h"
+#include "renderstats.h"
+
+#include <cassert>
+#include <cstdio>
 
 using namespace makai;
 
+GLuint ShaderProgram::s_boundProgram = 0;
+std::string ShaderProgram::s_binaryCacheDirectory;
+
+// cache file header, bump the version when the layout or the key changes
+static const uint32_t BINARY_CACHE_MAGIC = 0x42504b4d; // "MKPB"
+static const uint32_t BINARY_CACHE_VERSION = 1;
+
+// 64-bit FNV-1a, for the binary cache key
+static uint64_t hashBytes(const std::string &bytes, uint64_t hash = 14695981039346656037ull)
+{
+    for (unsigned char c : bytes)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
 ShaderProgram::ShaderProgram()
 {
     m_program = 0;
     m_log = std::string();
     m_shaders = std::vector<Shader*>();
     addedShaders = std::vector<Shader*>();
+    m_fromBinaryCache = false;
+    m_linkStatus = LINK_FAILED;
+    m_linkPolls = 0;
 }
 
 ShaderProgram::~ShaderProgram()
@@ -28,36 +54,52 @@ bool ShaderProgram::addShader(Shader *shader)
     return true;
 }
 
-bool ShaderProgram::addShaderFromFile(Shader::ShaderType type, const std::string &fileName)
+bool ShaderProgram::addShaderFromFile(Shader::ShaderType type, const std::string &fileName,
+                                      const std::vector<std::string> &defines)
 {
+    PendingShader pending;
+    pending.type = type;
+    pending.fileName = fileName;
+    pending.defines = defines;
+    appendLabel(fileName);
+    if (!Shader::readSourceFile(fileName, pending.source, m_log))
+        return false;
 
-    Shader* shader = new Shader(type);
-    bool success = shader->compileSourceFile(fileName);
-
-    if (success)
-    {
-        m_shaders.push_back(shader);
-    }
-    else
-    {
-        m_log += shader->log();
-    }
-    return success;
+    m_pendingShaders.push_back(pending);
+    return true;
 }
 
 bool ShaderProgram::addShaderFromSourceCode(Shader::ShaderType type, const char *sourceCode)
 {
-    Shader* shader = new Shader(type);
-    bool success = shader->compileSourceCode(sourceCode);
+    PendingShader pending;
+    pending.type = type;
+    pending.source = sourceCode;
+    appendLabel(type == Shader::Vertex ? "inline vertex" : type == Shader::Fragment ? "inline fragment" : "inline geometry");
 
-    if (success)
-    {
-        m_shaders.push_back(shader);
-    }
-    else
+    m_pendingShaders.push_back(pending);
+    return true;
+}
+
+bool ShaderProgram::beginCompilePendingShaders()
+{
+    bool success = true;
+    for (const PendingShader& pending : m_pendingShaders)
     {
-        m_log += shader->log();
+        Shader* shader = new Shader(pending.type);
+        bool submitted = pending.fileName.empty() ? shader->beginCompile(pending.source, pending.defines)
+                                                  : shader->beginCompileFile(pending.fileName, pending.defines);
+        if (submitted)
+        {
+            m_shaders.push_back(shader);
+        }
+        else
+        {
+            m_log += shader->log();
+            delete shader;
+            success = false;
+        }
     }
+    m_pendingShaders.clear();
     return success;
 }
 
@@ -72,9 +114,42 @@ void ShaderProgram::removeShader(Shader *shader)
 }
 
 bool ShaderProgram::link()
+{
+    if (!beginLink())
+        return false;
+
+    return m_linkStatus == LINK_DONE || finishLink();
+}
+
+bool ShaderProgram::beginLink()
 {
     // Shader Program
     m_program = glCreateProgram();
+    m_fromBinaryCache = false;
+    m_linkPolls = 0;
+
+    m_cacheFile = binaryCacheFile();
+    if (!m_cacheFile.empty() && loadBinary(m_cacheFile))
+    {
+        m_fromBinaryCache = true;
+        m_pendingShaders.clear();
+        GLDebug::setObjectLabel(GL_PROGRAM, m_program, m_label);
+        buildUniformTable();
+        m_linkStatus = LINK_DONE;
+        return true;
+    }
+
+    // the first program to compile lets the driver use as many threads as it likes
+    isParallelCompileSupported();
+
+    if (!beginCompilePendingShaders())
+    {
+        failLink();
+        return false;
+    }
+
+    if (!m_cacheFile.empty())
+        glProgramParameteri(m_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 
     for (unsigned i = 0; i < addedShaders.size(); i++)
         glAttachShader(m_program, addedShaders.at(i)->shaderId());
@@ -82,43 +157,298 @@ bool ShaderProgram::link()
     for (unsigned i = 0; i < m_shaders.size(); i++)
         glAttachShader(m_program, m_shaders.at(i)->shaderId());
 
+    // linking right away is allowed before the compiles are done, the driver queues it behind them
+    m_linkStart = std::chrono::steady_clock::now();
     glLinkProgram(m_program);
 
+    m_linkStatus = LINK_PENDING;
+    return true;
+}
+
+ShaderProgram::LinkStatus ShaderProgram::pollLink()
+{
+    if (m_linkStatus != LINK_PENDING)
+        return m_linkStatus;
+
+    if (isParallelCompileSupported())
+    {
+        // also stamps the compile time of each shader as it finishes
+        for (unsigned i = 0; i < m_shaders.size(); i++)
+            m_shaders.at(i)->isCompileComplete();
+
+        GLint done = GL_FALSE;
+        glGetProgramiv(m_program, GL_COMPLETION_STATUS_ARB, &done);
+        if (!done)
+            return LINK_PENDING;
+    }
+    else if (m_linkPolls++ == 0)
+    {
+        return LINK_PENDING;
+    }
+
+    finishLink();
+    return m_linkStatus;
+}
+
+bool ShaderProgram::isParallelCompileSupported()
+{
+    static const bool supported = [] {
+        if (!GLEW_ARB_parallel_shader_compile)
+            return false;
+        // 0xFFFFFFFF: as many threads as the implementation wants
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+        return true;
+    }();
+    return supported;
+}
+
+bool ShaderProgram::finishLink()
+{
+    bool compiled = true;
+    for (unsigned i = 0; i < m_shaders.size(); i++)
+    {
+        Shader* shader = m_shaders.at(i);
+        if (!shader->finishCompile())
+        {
+            m_log += shader->log();
+            compiled = false;
+        }
+        else
+        {
+            qDebug("  %s compiled in %.1f ms",
+                   shader->fileName().empty() ? "inline shader" : shader->fileName().c_str(),
+                   shader->compileMilliseconds());
+        }
+    }
+
     // Print linking errors if any
-    GLint success;
+    GLint success = GL_FALSE;
     glGetProgramiv(m_program, GL_LINK_STATUS, &success);
-    if (!success)
-    {
-        GLint infoLogLength;
-        glGetProgramiv(m_program, GL_INFO_LOG_LENGTH, &infoLogLength);
-        GLchar* infoLog = new GLchar[infoLogLength + 1];
-        glGetProgramInfoLog(m_program, infoLogLength, NULL, infoLog);
-        m_log += "ERROR::SHADER::PROGRAM::LINKING_FAILED\n";
-        m_log += infoLog;
-
-        delete[] infoLog;
-        glDeleteProgram(m_program);
-        m_program = 0;
+    if (!compiled || !success)
+    {
+        if (compiled)
+        {
+            GLint infoLogLength;
+            glGetProgramiv(m_program, GL_INFO_LOG_LENGTH, &infoLogLength);
+            GLchar* infoLog = new GLchar[infoLogLength + 1];
+            glGetProgramInfoLog(m_program, infoLogLength, NULL, infoLog);
+            m_log += "ERROR::SHADER::PROGRAM::LINKING_FAILED\n";
+            m_log += infoLog;
+            delete[] infoLog;
+        }
+        failLink();
         return false;
     }
 
+    qDebug("  %s linked in %.1f ms", m_label.c_str(),
+           std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_linkStart).count());
+
     for (unsigned i = 0; i < addedShaders.size(); i++)
         glDetachShader(m_program, addedShaders.at(i)->shaderId());
 
     for (unsigned i = 0; i < m_shaders.size(); i++)
         glDetachShader(m_program, m_shaders.at(i)->shaderId());
 
+    if (!m_cacheFile.empty())
+        saveBinary(m_cacheFile);
+
+    GLDebug::setObjectLabel(GL_PROGRAM, m_program, m_label);
+    buildUniformTable();
+
+    m_linkStatus = LINK_DONE;
     return true;
 }
 
+void ShaderProgram::failLink()
+{
+    glDeleteProgram(m_program);
+    m_program = 0;
+    m_linkStatus = LINK_FAILED;
+}
+
+bool ShaderProgram::isFromBinaryCache() const
+{
+    return m_fromBinaryCache;
+}
+
+void ShaderProgram::setBinaryCacheDirectory(const std::string &directory)
+{
+    s_binaryCacheDirectory = directory;
+}
+
+std::string ShaderProgram::binaryCacheDirectory()
+{
+    return s_binaryCacheDirectory;
+}
+
+std::string ShaderProgram::binaryCacheFile() const
+{
+    // shaders added as objects have no source to key on
+    if (s_binaryCacheDirectory.empty() || !addedShaders.empty() || m_pendingShaders.empty())
+        return std::string();
+
+    static const bool supported = [] {
+        if (!GLEW_ARB_get_program_binary && !GLEW_VERSION_4_1)
+            return false;
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }();
+    if (!supported)
+        return std::string();
+
+    // a driver update invalidates every binary, so the driver strings are part of the key
+    uint64_t hash = hashBytes(std::to_string(BINARY_CACHE_VERSION));
+    for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+    {
+        const GLubyte* value = glGetString(name);
+        hash = hashBytes(value ? reinterpret_cast<const char*>(value) : "", hash);
+    }
+    for (const PendingShader& pending : m_pendingShaders)
+    {
+        hash = hashBytes(std::to_string(pending.type), hash);
+        hash = hashBytes(pending.source, hash);
+        for (const std::string& define : pending.defines)
+            hash = hashBytes(define, hash);
+    }
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(hash));
+    return s_binaryCacheDirectory + "/" + name;
+}
+
+bool ShaderProgram::loadBinary(const std::string &cacheFile)
+{
+    std::ifstream file(cacheFile, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    uint32_t header[3] = {0, 0, 0};
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!file || header[0] != BINARY_CACHE_MAGIC || header[2] == 0)
+        return false;
+
+    std::vector<char> binary(header[2]);
+    file.read(&binary[0], binary.size());
+    if (!file)
+        return false;
+
+    glProgramBinary(m_program, header[1], &binary[0], (GLsizei)binary.size());
+
+    // the driver may refuse a binary it wrote itself, e.g. after an update with the same strings
+    GLint success = GL_FALSE;
+    glGetProgramiv(m_program, GL_LINK_STATUS, &success);
+    return success == GL_TRUE;
+}
+
+void ShaderProgram::saveBinary(const std::string &cacheFile)
+{
+    GLint length = 0;
+    glGetProgramiv(m_program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(m_program, length, NULL, &format, &binary[0]);
+
+    std::ofstream file(cacheFile, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        qDebug() << "Can't write program binary" << cacheFile.c_str();
+        return;
+    }
+
+    uint32_t header[3] = { BINARY_CACHE_MAGIC, format, static_cast<uint32_t>(length) };
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    file.write(&binary[0], binary.size());
+}
+
+void ShaderProgram::buildUniformTable()
+{
+    m_uniforms.clear();
+    m_uniformBlocks.clear();
+
+    GLint numUniforms = 0;
+    GLint maxNameLength = 0;
+    glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS, &numUniforms);
+    glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+    std::vector<GLchar> nameBuffer(maxNameLength + 1);
+    for (GLint i = 0; i < numUniforms; i++)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(m_program, i, (GLsizei)nameBuffer.size(), &length, &size, &type, &nameBuffer[0]);
+        std::string name(&nameBuffer[0], length);
+
+        // members of uniform blocks have no location
+        GLint location = glGetUniformLocation(m_program, name.c_str());
+        if (location == -1)
+            continue;
+
+        // arrays of basic types are reported once as "name[0]",
+        // register the bare name and every element so all spellings hit the table
+        const std::string arraySuffix = "[0]";
+        if (name.size() > arraySuffix.size() &&
+            name.compare(name.size() - arraySuffix.size(), arraySuffix.size(), arraySuffix) == 0)
+        {
+            std::string baseName = name.substr(0, name.size() - arraySuffix.size());
+            addUniform(baseName, location);
+            for (GLint j = 0; j < size; j++)
+            {
+                std::string elementName = baseName + "[" + std::to_string(j) + "]";
+                addUniform(elementName, glGetUniformLocation(m_program, elementName.c_str()));
+            }
+        }
+        else
+        {
+            addUniform(name, location);
+        }
+    }
+
+    GLint numBlocks = 0;
+    GLint maxBlockNameLength = 0;
+    glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_BLOCKS, &numBlocks);
+    glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxBlockNameLength);
+
+    nameBuffer.assign(maxBlockNameLength + 1, 0);
+    for (GLint i = 0; i < numBlocks; i++)
+    {
+        GLsizei length = 0;
+        glGetActiveUniformBlockName(m_program, i, (GLsizei)nameBuffer.size(), &length, &nameBuffer[0]);
+        std::string name(&nameBuffer[0], length);
+        m_uniformBlocks.insert(std::make_pair(hashUniformName(name.c_str()), NamedEntry<GLuint>{ name, (GLuint)i }));
+    }
+}
+
+void ShaderProgram::addUniform(const std::string &name, GLint location)
+{
+    // on a collision the first name keeps the entry, lookups of the other go to the driver
+    auto inserted = m_uniforms.insert(std::make_pair(hashUniformName(name.c_str()), NamedEntry<GLint>{ name, location }));
+    if (!inserted.second && inserted.first->second.name != name)
+        qDebug() << "Program uniform name hash collision:" << name.c_str() << inserted.first->second.name.c_str();
+}
+
 void ShaderProgram::bind()
 {
     glUseProgram(this->m_program);
+    RenderStats::instance().countProgramBind();
+    s_boundProgram = m_program;
 }
 
 void ShaderProgram::release()
 {
     glUseProgram(0);
+    s_boundProgram = 0;
+}
+
+void ShaderProgram::appendLabel(const std::string &shaderName)
+{
+    if (!m_label.empty())
+        m_label += " + ";
+    m_label += shaderName;
 }
 
 std::string ShaderProgram::log() const
@@ -143,21 +473,46 @@ GLint ShaderProgram::attrib(const GLchar *attribName) const
     return attrib;
 }
 
-GLint ShaderProgram::uniform(const GLchar *uniformName) const
+Uniform ShaderProgram::uniform(const UniformName &uniformName) const
 {
-    if(!uniformName)
-       throw std::runtime_error("uniformName was NULL");
+    auto it = m_uniforms.find(uniformName.hash());
+    if (it != m_uniforms.end())
+    {
+        if (it->second.name == uniformName.c_str())
+            return Uniform(it->second.value);
 
-    GLint uniform = glGetUniformLocation(m_program, uniformName);
-    if(uniform == -1) {
-        qDebug() << uniformName;
-        throw std::runtime_error(std::string("Program uniform not found: ") + uniformName);
+        // another name with the same hash owns the entry, ask the driver instead
+        return Uniform(glGetUniformLocation(m_program, uniformName.c_str()));
     }
 
-    return uniform;
+    // remember the miss, so the next lookup is as cheap as a hit
+    qDebug() << "Program uniform not found:" << uniformName.c_str();
+    m_uniforms.insert(std::make_pair(uniformName.hash(), NamedEntry<GLint>{ uniformName.c_str(), -1 }));
+    return Uniform();
+}
+
+bool ShaderProgram::hasUniform(const UniformName &uniformName) const
+{
+    auto it = m_uniforms.find(uniformName.hash());
+    if (it == m_uniforms.end())
+        return false;
+    if (it->second.name == uniformName.c_str())
+        return it->second.value != -1;
+    return glGetUniformLocation(m_program, uniformName.c_str()) != -1;
+}
+
+GLuint ShaderProgram::uniformBlock(const UniformName &blockName) const
+{
+    auto it = m_uniformBlocks.find(blockName.hash());
+    if (it == m_uniformBlocks.end())
+        return GL_INVALID_INDEX;
+    if (it->second.name != blockName.c_str())
+        return glGetUniformBlockIndex(m_program, blockName.c_str());
+
+    return it->second.value;
 }
 
-#define ATTRIB_N_UNIFORM_SETTERS(TYPE, TYPE_PREFIX, TYPE_SUFFIX) \
+#define ATTRIB_SETTERS(TYPE, TYPE_PREFIX, TYPE_SUFFIX) \
 \
     void ShaderProgram::setAttrib(const GLchar* name, TYPE v0) \
         { glVertexAttrib ## TYPE_PREFIX ## 1 ## TYPE_SUFFIX (attrib(name), v0); } \
@@ -175,62 +530,142 @@ GLint ShaderProgram::uniform(const GLchar *uniformName) const
     void ShaderProgram::setAttrib3v(const GLchar* name, const TYPE* v) \
         { glVertexAttrib ## TYPE_PREFIX ## 3 ## TYPE_SUFFIX ## v (attrib(name), v); } \
     void ShaderProgram::setAttrib4v(const GLchar* name, const TYPE* v) \
-        { glVertexAttrib ## TYPE_PREFIX ## 4 ## TYPE_SUFFIX ## v (attrib(name), v); } \
+        { glVertexAttrib ## TYPE_PREFIX ## 4 ## TYPE_SUFFIX ## v (attrib(name), v); }
+
+// Every uniform setter goes through here. The program must be bound, checked against our own
+// bookkeeping since asking the driver for GL_CURRENT_PROGRAM would stall it. Invalid handles are
+// skipped instead of passing -1 to the driver, the calls that do reach it are counted for RenderStats.
+inline bool ShaderProgram::uploads(Uniform u) const
+{
+    assert(s_boundProgram == m_program);
+    if (!u.isValid())
+        return false;
+    RenderStats::instance().countUniformCall();
+    return true;
+}
+
+#define UNIFORM_SETTERS(TYPE, TYPE_SUFFIX) \
+\
+    void ShaderProgram::setUniform(Uniform u, TYPE v0) \
+        { if (uploads(u)) glUniform1 ## TYPE_SUFFIX (u.location(), v0); } \
+    void ShaderProgram::setUniform(Uniform u, TYPE v0, TYPE v1) \
+        { if (uploads(u)) glUniform2 ## TYPE_SUFFIX (u.location(), v0, v1); } \
+    void ShaderProgram::setUniform(Uniform u, TYPE v0, TYPE v1, TYPE v2) \
+        { if (uploads(u)) glUniform3 ## TYPE_SUFFIX (u.location(), v0, v1, v2); } \
+    void ShaderProgram::setUniform(Uniform u, TYPE v0, TYPE v1, TYPE v2, TYPE v3) \
+        { if (uploads(u)) glUniform4 ## TYPE_SUFFIX (u.location(), v0, v1, v2, v3); } \
+\
+    void ShaderProgram::setUniform1v(Uniform u, const TYPE* v, GLsizei count) \
+        { if (uploads(u)) glUniform1 ## TYPE_SUFFIX ## v (u.location(), count, v); } \
+    void ShaderProgram::setUniform2v(Uniform u, const TYPE* v, GLsizei count) \
+        { if (uploads(u)) glUniform2 ## TYPE_SUFFIX ## v (u.location(), count, v); } \
+    void ShaderProgram::setUniform3v(Uniform u, const TYPE* v, GLsizei count) \
+        { if (uploads(u)) glUniform3 ## TYPE_SUFFIX ## v (u.location(), count, v); } \
+    void ShaderProgram::setUniform4v(Uniform u, const TYPE* v, GLsizei count) \
+        { if (uploads(u)) glUniform4 ## TYPE_SUFFIX ## v (u.location(), count, v); } \
 \
-    void ShaderProgram::setUniform(const GLchar* name, TYPE v0) \
-        { glUniform1 ## TYPE_SUFFIX (uniform(name), v0); } \
-    void ShaderProgram::setUniform(const GLchar* name, TYPE v0, TYPE v1) \
-        { glUniform2 ## TYPE_SUFFIX (uniform(name), v0, v1); } \
-    void ShaderProgram::setUniform(const GLchar* name, TYPE v0, TYPE v1, TYPE v2) \
-        { glUniform3 ## TYPE_SUFFIX (uniform(name), v0, v1, v2); } \
-    void ShaderProgram::setUniform(const GLchar* name, TYPE v0, TYPE v1, TYPE v2, TYPE v3) \
-        { glUniform4 ## TYPE_SUFFIX (uniform(name), v0, v1, v2, v3); } \
+    void ShaderProgram::setUniform(const UniformName& name, TYPE v0) \
+        { setUniform(uniform(name), v0); } \
+    void ShaderProgram::setUniform(const UniformName& name, TYPE v0, TYPE v1) \
+        { setUniform(uniform(name), v0, v1); } \
+    void ShaderProgram::setUniform(const UniformName& name, TYPE v0, TYPE v1, TYPE v2) \
+        { setUniform(uniform(name), v0, v1, v2); } \
+    void ShaderProgram::setUniform(const UniformName& name, TYPE v0, TYPE v1, TYPE v2, TYPE v3) \
+        { setUniform(uniform(name), v0, v1, v2, v3); } \
 \
-    void ShaderProgram::setUniform1v(const GLchar* name, const TYPE* v, GLsizei count) \
-        { glUniform1 ## TYPE_SUFFIX ## v (uniform(name), count, v); } \
-    void ShaderProgram::setUniform2v(const GLchar* name, const TYPE* v, GLsizei count) \
-        { glUniform2 ## TYPE_SUFFIX ## v (uniform(name), count, v); } \
-    void ShaderProgram::setUniform3v(const GLchar* name, const TYPE* v, GLsizei count) \
-        { glUniform3 ## TYPE_SUFFIX ## v (uniform(name), count, v); } \
-    void ShaderProgram::setUniform4v(const GLchar* name, const TYPE* v, GLsizei count) \
-        { glUniform4 ## TYPE_SUFFIX ## v (uniform(name), count, v); }
+    void ShaderProgram::setUniform1v(const UniformName& name, const TYPE* v, GLsizei count) \
+        { setUniform1v(uniform(name), v, count); } \
+    void ShaderProgram::setUniform2v(const UniformName& name, const TYPE* v, GLsizei count) \
+        { setUniform2v(uniform(name), v, count); } \
+    void ShaderProgram::setUniform3v(const UniformName& name, const TYPE* v, GLsizei count) \
+        { setUniform3v(uniform(name), v, count); } \
+    void ShaderProgram::setUniform4v(const UniformName& name, const TYPE* v, GLsizei count) \
+        { setUniform4v(uniform(name), v, count); }
+
+ATTRIB_SETTERS(GLfloat, , f)
+ATTRIB_SETTERS(GLdouble, , d)
+ATTRIB_SETTERS(GLint, I, i)
+ATTRIB_SETTERS(GLuint, I, ui)
+
+UNIFORM_SETTERS(GLfloat, f)
+UNIFORM_SETTERS(GLdouble, d)
+UNIFORM_SETTERS(GLint, i)
+UNIFORM_SETTERS(GLuint, ui)
+
+void ShaderProgram::setUniformMatrix2(Uniform u, const GLfloat* v, GLsizei count, GLboolean transpose) {
+    if (uploads(u)) glUniformMatrix2fv(u.location(), count, transpose, v);
+}
 
-ATTRIB_N_UNIFORM_SETTERS(GLfloat, , f)
-ATTRIB_N_UNIFORM_SETTERS(GLdouble, , d)
-ATTRIB_N_UNIFORM_SETTERS(GLint, I, i)
-ATTRIB_N_UNIFORM_SETTERS(GLuint, I, ui)
+void ShaderProgram::setUniformMatrix3(Uniform u, const GLfloat* v, GLsizei count, GLboolean transpose) {
+    if (uploads(u)) glUniformMatrix3fv(u.location(), count, transpose, v);
+}
 
-void ShaderProgram::setUniformMatrix2(const GLchar* name, const GLfloat* v, GLsizei count, GLboolean transpose) {
-    glUniformMatrix2fv(uniform(name), count, transpose, v);
+void ShaderProgram::setUniformMatrix4(Uniform u, const GLfloat* v, GLsizei count, GLboolean transpose) {
+    if (uploads(u)) glUniformMatrix4fv(u.location(), count, transpose, v);
 }
 
-void ShaderProgram::setUniformMatrix3(const GLchar* name, const GLfloat* v, GLsizei count, GLboolean transpose) {
-    glUniformMatrix3fv(uniform(name), count, transpose, v);
+void ShaderProgram::setUniform(Uniform u, const glm::mat2& m, GLboolean transpose) {
+    setUniformMatrix2(u, glm::value_ptr(m), 1, transpose);
 }
 
-void ShaderProgram::setUniformMatrix4(const GLchar* name, const GLfloat* v, GLsizei count, GLboolean transpose) {
-    GLint currentProgram = 0;
-    glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
-    assert(currentProgram == (GLint)m_program);
-    glUniformMatrix4fv(uniform(name), count, transpose, v);
+void ShaderProgram::setUniform(Uniform u, const glm::mat3& m, GLboolean transpose) {
+    setUniformMatrix3(u, glm::value_ptr(m), 1, transpose);
 }
 
-void ShaderProgram::setUniform(const GLchar* name, const glm::mat2& m, GLboolean transpose) {
-    glUniformMatrix2fv(uniform(name), 1, transpose, glm::value_ptr(m));
+void ShaderProgram::setUniform(Uniform u, const glm::mat4& m, GLboolean transpose) {
+    if (uploads(u)) glUniformMatrix4fv(u.location(), 1, transpose, glm::value_ptr(m));
 }
 
-void ShaderProgram::setUniform(const GLchar* name, const glm::mat3& m, GLboolean transpose) {
-    glUniformMatrix3fv(uniform(name), 1, transpose, glm::value_ptr(m));
+void ShaderProgram::setUniform(Uniform u, const glm::vec3& v) {
+    setUniform3v(u, glm::value_ptr(v));
 }
 
-void ShaderProgram::setUniform(const GLchar* name, const glm::mat4& m, GLboolean transpose) {
-    glUniformMatrix4fv(uniform(name), 1, transpose, glm::value_ptr(m));
+void ShaderProgram::setUniform(Uniform u, const glm::vec4& v) {
+    setUniform4v(u, glm::value_ptr(v));
 }
 
-void ShaderProgram::setUniform(const GLchar* uniformName, const glm::vec3& v) {
-    setUniform3v(uniformName, glm::value_ptr(v));
+void ShaderProgram::setUniformMatrix2(const UniformName& name, const GLfloat* v, GLsizei count, GLboolean transpose) {
+    setUniformMatrix2(uniform(name), v, count, transpose);
 }
 
-void ShaderProgram::setUniform(const GLchar* uniformName, const glm::vec4& v) {
-    setUniform4v(uniformName, glm::value_ptr(v));
+void ShaderProgram::setUniformMatrix3(const UniformName& name, const GLfloat* v, GLsizei count, GLboolean transpose) {
+    setUniformMatrix3(uniform(name), v, count, transpose);
+}
+
+void ShaderProgram::setUniformMatrix4(const UniformName& name, const GLfloat* v, GLsizei count, GLboolean transpose) {
+    setUniformMatrix4(uniform(name), v, count, transpose);
+}
+
+void ShaderProgram::setUniform(const UniformName& name, const glm::mat2& m, GLboolean transpose) {
+    setUniform(uniform(name), m, transpose);
+}
+
+void ShaderProgram::setUniform(const UniformName& name, const glm::mat3& m, GLboolean transpose) {
+    setUniform(uniform(name), m, transpose);
+}
+
+void ShaderProgram::setUniform(const UniformName& name, const glm::mat4& m, GLboolean transpose) {
+    setUniform(uniform(name), m, transpose);
+}
+
+void ShaderProgram::setUniform(const UniformName& name, const glm::vec3& v) {
+    setUniform(uniform(name), v);
+}
+
+void ShaderProgram::setUniform(const UniformName& name, const glm::vec4& v) {
+    setUniform(uniform(name), v);
+}
+
+std::string ShaderProgram::arrayUniformName(const char *arrayName, size_t index, const char *propertyName)
+{
+    std::ostringstream ss;
+    if (propertyName != nullptr)
+    {
+        ss << arrayName << "[" << index << "]." << propertyName;
+    }
+    else
+    {
+        ss << arrayName << "[" << index << "]";
+    }
+    return ss.str();
 }
@@ -0,0 +1,87 @@
+#include "shaderreloader.h"
+
+#include <QFileInfo>
+#include <QDebug>
+
+using namespace makai;
+
+static const long long QUIET_PERIOD_MS = 100;
+
+ShaderReloader::ShaderReloader(FrameScheduler &scheduler) : m_scheduler(scheduler),
+    m_watcher(), m_entries(), m_sinceChange()
+{
+    QObject::connect(&m_watcher, &QFileSystemWatcher::fileChanged,
+                     [this](const QString &path) { onFileChanged(path); });
+    m_sinceChange.start();
+}
+
+void ShaderReloader::watch(ShaderPermutations *permutations)
+{
+    Entry entry;
+    entry.permutations = permutations;
+    entry.dirty = false;
+    entry.reloading = false;
+    for (const std::string& file : permutations->files())
+    {
+        QString path = QFileInfo(QString::fromStdString(file)).absoluteFilePath();
+        entry.files.push_back(path);
+        m_watcher.addPath(path);
+    }
+    m_entries.push_back(entry);
+}
+
+bool ShaderReloader::poll()
+{
+    bool changed = false;
+    bool quiet = m_sinceChange.elapsed() >= QUIET_PERIOD_MS;
+    for (Entry& entry : m_entries)
+    {
+        if (entry.dirty && quiet)
+        {
+            entry.permutations->reload();
+            setBusy(entry, false, true);
+        }
+        if (entry.reloading)
+        {
+            changed = entry.permutations->pollReload() || changed;
+            if (!entry.permutations->isReloading())
+                setBusy(entry, entry.dirty, false);
+        }
+    }
+    if (changed)
+        m_scheduler.requestRedraw();
+    return changed;
+}
+
+void ShaderReloader::onFileChanged(const QString &path)
+{
+    // editors that save by replacing the file drop it from the watcher
+    if (!m_watcher.files().contains(path) && QFileInfo(path).exists())
+        m_watcher.addPath(path);
+
+    m_sinceChange.restart();
+    for (Entry& entry : m_entries)
+    {
+        for (const QString& file : entry.files)
+        {
+            if (file == path)
+            {
+                qDebug() << "Shader changed:" << path;
+                setBusy(entry, true, entry.reloading);
+                break;
+            }
+        }
+    }
+}
+
+void ShaderReloader::setBusy(Entry &entry, bool dirty, bool reloading)
+{
+    bool wasBusy = entry.dirty || entry.reloading;
+    bool busy = dirty || reloading;
+    entry.dirty = dirty;
+    entry.reloading = reloading;
+    if (busy && !wasBusy)
+        m_scheduler.beginLoad();
+    else if (!busy && wasBusy)
+        m_scheduler.endLoad();
+}
@@ -14,10 +14,27 @@ SubMesh::SubMesh(const std::vector<float> &vertices,
                  const std::vector<unsigned> &indices,
                  const std::vector<unsigned> &texIndices,
                  unsigned step) :
-    VAO(0), VBO(0), EBO(0)
+    VAO(0), VBO(0), EBO(0), depthVAO(0), positionVBO(0)
 {
     this->step = step;
     this->vertices = vertices;
     this->indices = indices;
     this->texIndices = texIndices;
 }
+
+size_t SubMesh::cpuBytes() const
+{
+    return vertices.capacity() * sizeof(float) + indices.capacity() * sizeof(unsigned) +
+           texIndices.capacity() * sizeof(unsigned);
+}
+
+size_t SubMesh::vertexBufferBytes() const
+{
+    size_t positions = step > 0 ? vertices.size() / step * 3 : 0;
+    return (vertices.size() + positions) * sizeof(float);
+}
+
+size_t SubMesh::indexBufferBytes() const
+{
+    return indices.size() * sizeof(unsigned);
+}
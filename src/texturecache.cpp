@@ -0,0 +1,483 @@
+#include "texturecache.h"
+#include "makaidebug.h"
+#include "mipchain.h"
+#include "tracer.h"
+
+#include <SOIL.h>
+#include <QDebug>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+using namespace makai;
+
+std::string TextureCache::s_directory;
+bool TextureCache::s_enabled = true;
+
+// bump when the encoder output changes, so old cache files are encoded again
+static const uint32_t ENCODER_VERSION = 2;
+
+static const unsigned char KTX_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+static const uint32_t KTX_ENDIANNESS = 0x04030201;
+
+// the header fields after the identifier, in file order
+struct KtxHeader
+{
+    uint32_t endianness;
+    uint32_t glType;
+    uint32_t glTypeSize;
+    uint32_t glFormat;
+    uint32_t glInternalFormat;
+    uint32_t glBaseInternalFormat;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t numberOfArrayElements;
+    uint32_t numberOfFaces;
+    uint32_t numberOfMipmapLevels;
+    uint32_t bytesOfKeyValueData;
+};
+
+// 64-bit FNV-1a, for the cache key
+static uint64_t hashBytes(const unsigned char *bytes, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static bool formatOf(GLenum internalFormat, BlockCompression::Format &format, GLenum &baseFormat)
+{
+    switch (internalFormat)
+    {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+            format = BlockCompression::BC1;
+            baseFormat = GL_RGB;
+            return true;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+            format = BlockCompression::BC3;
+            baseFormat = GL_RGBA;
+            return true;
+        case GL_COMPRESSED_RG_RGTC2:
+            format = BlockCompression::BC5;
+            baseFormat = GL_RG;
+            return true;
+    }
+    return false;
+}
+
+size_t TextureData::byteSize() const
+{
+    size_t size = 0;
+    for (const std::vector<unsigned char>& level : levels)
+        size += level.size();
+    return size;
+}
+
+int TextureData::baseLevel() const
+{
+    for (size_t i = 0; i < levels.size(); i++)
+        if (!levels[i].empty())
+            return (int)i;
+    return (int)levels.size();
+}
+
+void TextureCache::setDirectory(const std::string &directory)
+{
+    s_directory = directory;
+}
+
+std::string TextureCache::directory()
+{
+    return s_directory;
+}
+
+void TextureCache::setEnabled(bool enabled)
+{
+    s_enabled = enabled;
+}
+
+bool TextureCache::isEnabled()
+{
+    return s_enabled;
+}
+
+bool TextureCache::isSupported()
+{
+    return GLEW_EXT_texture_compression_s3tc && (GLEW_VERSION_3_0 || GLEW_ARB_texture_compression_rgtc);
+}
+
+bool TextureCache::load(const std::string &fileName, Usage usage, TextureData &texture, int width, int height,
+                        int maxLevelSize)
+{
+    TRACE_SCOPE_DETAIL("TextureCache::load", fileName.c_str());
+    std::ifstream file(fileName, std::ios::binary);
+    if (!file.is_open())
+        return false;
+    std::vector<unsigned char> fileData((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    std::string cacheFile;
+    if (s_enabled && !s_directory.empty())
+    {
+        uint64_t hash = hashBytes(fileData.data(), fileData.size());
+        uint32_t salt[4] = { ENCODER_VERSION, (uint32_t)usage, (uint32_t)width, (uint32_t)height };
+        hash = hashBytes(reinterpret_cast<const unsigned char*>(salt), sizeof(salt), hash);
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.ktx", static_cast<unsigned long long>(hash));
+        cacheFile = s_directory + "/" + name;
+
+        if (readKtx(cacheFile, texture, maxLevelSize))
+        {
+            texture.cacheFile = cacheFile;
+            return true;
+        }
+    }
+
+    texture.cacheFile.clear();
+    if (!encode(fileData, usage, texture, width, height))
+        return false;
+
+    if (!cacheFile.empty())
+    {
+        if (!writeKtx(cacheFile, texture))
+        {
+            qDebug() << "Can't write texture cache file" << cacheFile.c_str();
+            return true;
+        }
+        texture.cacheFile = cacheFile;
+
+        // the same as a cache hit, the large levels are read again when needed
+        int levelWidth = texture.width, levelHeight = texture.height;
+        for (size_t i = 0; maxLevelSize > 0 && i + 1 < texture.levels.size(); i++)
+        {
+            if (std::max(levelWidth, levelHeight) <= maxLevelSize)
+                break;
+            std::vector<unsigned char>().swap(texture.levels[i]);
+            levelWidth = std::max(levelWidth / 2, 1);
+            levelHeight = std::max(levelHeight / 2, 1);
+        }
+    }
+    return true;
+}
+
+bool TextureCache::encode(const std::vector<unsigned char> &fileData, Usage usage, TextureData &texture,
+                          int width, int height)
+{
+    TRACE_SCOPE("TextureCache::encode");
+    int imageWidth, imageHeight, channels;
+    unsigned char* image = SOIL_load_image_from_memory(fileData.data(), (int)fileData.size(),
+                                                       &imageWidth, &imageHeight, &channels, SOIL_LOAD_RGBA);
+    if (image == nullptr)
+        return false;
+    std::vector<unsigned char> level(image, image + imageWidth * imageHeight * 4);
+    SOIL_free_image_data(image);
+
+    if (width <= 0 || height <= 0)
+    {
+        width = imageWidth;
+        height = imageHeight;
+    }
+    else if (width != imageWidth || height != imageHeight)
+    {
+        level = BlockCompression::resize(level.data(), imageWidth, imageHeight, width, height);
+    }
+
+    GLenum internalFormat = GL_RGBA8;
+    BlockCompression::Format format = BlockCompression::BC1;
+    if (s_enabled)
+    {
+        if (usage == NORMAL)
+        {
+            format = BlockCompression::BC5;
+        }
+        else if (channels == 4)
+        {
+            // opaque RGBA images are common, they don't need the alpha block
+            for (size_t i = 3; i < level.size(); i += 4)
+            {
+                if (level[i] != 255)
+                {
+                    format = BlockCompression::BC3;
+                    break;
+                }
+            }
+        }
+        internalFormat = BlockCompression::glInternalFormat(format);
+    }
+
+    texture.internalFormat = internalFormat;
+    texture.width = width;
+    texture.height = height;
+    texture.levels = MipChain::build(usage == NORMAL ? MipChain::NORMAL : MipChain::COLOR, level.data(), width, height);
+    if (s_enabled)
+    {
+        for (std::vector<unsigned char>& chainLevel : texture.levels)
+        {
+            chainLevel = BlockCompression::encode(format, chainLevel.data(), width, height);
+            width = std::max(width / 2, 1);
+            height = std::max(height / 2, 1);
+        }
+    }
+    return true;
+}
+
+// glTexStorage*D allocates the whole chain at once and fixes it, so the driver checks it once
+// instead of at every draw; TextureStreamer respecifies levels, which immutable textures don't allow
+static bool hasTextureStorage()
+{
+    return GLEW_VERSION_4_2 || GLEW_ARB_texture_storage;
+}
+
+GLuint TextureCache::upload(const TextureData &texture, const std::string &label)
+{
+    TRACE_SCOPE_DETAIL("TextureCache::upload", label.c_str());
+    const bool compressed = texture.internalFormat != GL_RGBA8;
+    const bool immutable = hasTextureStorage();
+
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+
+    if (immutable)
+        GL_CHECK( glTexStorage2D(GL_TEXTURE_2D, (GLsizei)texture.levels.size(), texture.internalFormat,
+                                 texture.width, texture.height) );
+    GLsizei width = texture.width, height = texture.height;
+    for (size_t i = 0; i < texture.levels.size(); i++)
+    {
+        const std::vector<unsigned char>& level = texture.levels[i];
+        if (compressed && immutable)
+            GL_CHECK( glCompressedTexSubImage2D(GL_TEXTURE_2D, (GLint)i, 0, 0, width, height, texture.internalFormat,
+                                                (GLsizei)level.size(), level.data()) );
+        else if (compressed)
+            GL_CHECK( glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, texture.internalFormat, width, height, 0,
+                                             (GLsizei)level.size(), level.data()) );
+        else if (immutable)
+            GL_CHECK( glTexSubImage2D(GL_TEXTURE_2D, (GLint)i, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE,
+                                      level.data()) );
+        else
+            GL_CHECK( glTexImage2D(GL_TEXTURE_2D, (GLint)i, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                                   level.data()) );
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)texture.levels.size() - 1);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    GL_CHECK( glBindTexture(GL_TEXTURE_2D, 0) );
+    GLDebug::setObjectLabel(GL_TEXTURE, textureID, label);
+    return textureID;
+}
+
+GLuint TextureCache::uploadArray(const std::vector<const TextureData*> &layers, const std::string &label, bool streamed)
+{
+    TRACE_SCOPE_DETAIL("TextureCache::uploadArray", label.c_str());
+    const TextureData& first = *layers.front();
+    const GLsizei layerCount = (GLsizei)layers.size();
+    const bool compressed = first.internalFormat != GL_RGBA8;
+
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+
+    // a layer whose cache file couldn't be written has all its levels, start where every layer has one
+    int baseLevel = 0;
+    for (const TextureData* layer : layers)
+        baseLevel = std::max(baseLevel, layer->baseLevel());
+    const bool immutable = !streamed && baseLevel == 0 && hasTextureStorage();
+
+    if (immutable)
+        GL_CHECK( glTexStorage3D(GL_TEXTURE_2D_ARRAY, (GLsizei)first.levels.size(), first.internalFormat,
+                                 first.width, first.height, layerCount) );
+    GLsizei width = first.width, height = first.height;
+    for (size_t i = 0; i < first.levels.size(); i++)
+    {
+        if ((int)i < baseLevel)
+        {
+            width = std::max(width / 2, 1);
+            height = std::max(height / 2, 1);
+            continue;
+        }
+
+        // allocate the level for all layers unless the storage is there already, then fill it layer by layer
+        GLsizei layerBytes = (GLsizei)levelSize(first.internalFormat, width, height);
+        if (!immutable && compressed)
+            GL_CHECK( glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, (GLint)i, first.internalFormat, width, height, layerCount,
+                                             0, layerBytes * layerCount, NULL) );
+        else if (!immutable)
+            GL_CHECK( glTexImage3D(GL_TEXTURE_2D_ARRAY, (GLint)i, GL_RGBA8, width, height, layerCount,
+                                   0, GL_RGBA, GL_UNSIGNED_BYTE, NULL) );
+
+        for (GLsizei layer = 0; layer < layerCount; layer++)
+        {
+            const std::vector<unsigned char>& level = layers[layer]->levels[i];
+            if (compressed)
+                GL_CHECK( glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)i, 0, 0, layer, width, height, 1,
+                                                    first.internalFormat, layerBytes, level.data()) );
+            else
+                GL_CHECK( glTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)i, 0, 0, layer, width, height, 1,
+                                          GL_RGBA, GL_UNSIGNED_BYTE, level.data()) );
+        }
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, baseLevel);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (GLint)first.levels.size() - 1);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    GL_CHECK( glBindTexture(GL_TEXTURE_2D_ARRAY, 0) );
+    GLDebug::setObjectLabel(GL_TEXTURE, textureID, label);
+    return textureID;
+}
+
+size_t TextureCache::levelSize(GLenum internalFormat, int width, int height)
+{
+    BlockCompression::Format format;
+    GLenum baseFormat;
+    if (formatOf(internalFormat, format, baseFormat))
+        return BlockCompression::compressedSize(format, width, height);
+    return (size_t)width * height * 4;
+}
+
+bool TextureCache::readKtx(const std::string &fileName, TextureData &texture, int maxLevelSize)
+{
+    TRACE_SCOPE("TextureCache::readKtx");
+    std::ifstream file(fileName, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    unsigned char identifier[12];
+    KtxHeader header;
+    file.read(reinterpret_cast<char*>(identifier), sizeof(identifier));
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || std::memcmp(identifier, KTX_IDENTIFIER, sizeof(identifier)) != 0 ||
+        header.endianness != KTX_ENDIANNESS || header.glType != 0 ||
+        header.numberOfFaces != 1 || header.numberOfArrayElements != 0 || header.numberOfMipmapLevels == 0)
+        return false;
+
+    BlockCompression::Format format;
+    GLenum baseFormat;
+    if (!formatOf(header.glInternalFormat, format, baseFormat))
+        return false;
+    file.seekg(header.bytesOfKeyValueData, std::ios::cur);
+
+    texture.internalFormat = header.glInternalFormat;
+    texture.width = header.pixelWidth;
+    texture.height = header.pixelHeight;
+    texture.levels.resize(header.numberOfMipmapLevels);
+
+    int width = texture.width, height = texture.height;
+    for (std::vector<unsigned char>& level : texture.levels)
+    {
+        uint32_t imageSize = 0;
+        file.read(reinterpret_cast<char*>(&imageSize), sizeof(imageSize));
+        // a truncated or foreign file is encoded again rather than uploaded
+        if (!file || imageSize != BlockCompression::compressedSize(format, width, height))
+            return false;
+        bool skipped = maxLevelSize > 0 && std::max(width, height) > maxLevelSize &&
+                       &level != &texture.levels.back();
+        if (skipped)
+        {
+            level.clear();
+            file.seekg(imageSize, std::ios::cur);
+        }
+        else
+        {
+            level.resize(imageSize);
+            file.read(reinterpret_cast<char*>(level.data()), imageSize);
+        }
+        // block sizes are multiples of 8, so there is never mip padding to skip
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+    return (bool)file;
+}
+
+bool TextureCache::readKtxLevel(const std::string &fileName, int level, std::vector<unsigned char> &data)
+{
+    std::ifstream file(fileName, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    unsigned char identifier[12];
+    KtxHeader header;
+    file.read(reinterpret_cast<char*>(identifier), sizeof(identifier));
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || std::memcmp(identifier, KTX_IDENTIFIER, sizeof(identifier)) != 0 ||
+        header.endianness != KTX_ENDIANNESS || level < 0 || (uint32_t)level >= header.numberOfMipmapLevels)
+        return false;
+    file.seekg(header.bytesOfKeyValueData, std::ios::cur);
+
+    for (int i = 0; i < level; i++)
+    {
+        uint32_t imageSize = 0;
+        file.read(reinterpret_cast<char*>(&imageSize), sizeof(imageSize));
+        file.seekg(imageSize, std::ios::cur);
+    }
+
+    uint32_t imageSize = 0;
+    file.read(reinterpret_cast<char*>(&imageSize), sizeof(imageSize));
+    if (!file)
+        return false;
+    data.resize(imageSize);
+    file.read(reinterpret_cast<char*>(data.data()), imageSize);
+    return (bool)file;
+}
+
+bool TextureCache::writeKtx(const std::string &fileName, const TextureData &texture)
+{
+    BlockCompression::Format format;
+    GLenum baseFormat;
+    if (!formatOf(texture.internalFormat, format, baseFormat))
+        return false;
+
+    KtxHeader header;
+    header.endianness = KTX_ENDIANNESS;
+    header.glType = 0;
+    header.glTypeSize = 1;
+    header.glFormat = 0;
+    header.glInternalFormat = texture.internalFormat;
+    header.glBaseInternalFormat = baseFormat;
+    header.pixelWidth = texture.width;
+    header.pixelHeight = texture.height;
+    header.pixelDepth = 0;
+    header.numberOfArrayElements = 0;
+    header.numberOfFaces = 1;
+    header.numberOfMipmapLevels = (uint32_t)texture.levels.size();
+    header.bytesOfKeyValueData = 0;
+
+    // written next to the final name and renamed, so another instance never reads half a file
+    std::string partialName = fileName + ".part";
+    {
+        std::ofstream file(partialName, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            return false;
+        file.write(reinterpret_cast<const char*>(KTX_IDENTIFIER), sizeof(KTX_IDENTIFIER));
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const std::vector<unsigned char>& level : texture.levels)
+        {
+            uint32_t imageSize = (uint32_t)level.size();
+            file.write(reinterpret_cast<const char*>(&imageSize), sizeof(imageSize));
+            file.write(reinterpret_cast<const char*>(level.data()), level.size());
+        }
+        if (!file)
+            return false;
+    }
+    std::remove(fileName.c_str());
+    return std::rename(partialName.c_str(), fileName.c_str()) == 0;
+}
@@ -0,0 +1,243 @@
+#include "texturestreamer.h"
+#include "texturecache.h"
+#include "threadpool.h"
+#include "makaidebug.h"
+#include "tracer.h"
+#include "memorytracker.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace makai;
+
+// bytes of one level of all layers
+static size_t levelBytes(GLenum internalFormat, int width, int height, int level, size_t layers)
+{
+    return TextureCache::levelSize(internalFormat, std::max(width >> level, 1), std::max(height >> level, 1)) * layers;
+}
+
+TextureStreamer::TextureStreamer(size_t budgetBytes) : m_budget(budgetBytes), m_arrays()
+{
+
+}
+
+size_t TextureStreamer::budget() const
+{
+    return m_budget;
+}
+
+void TextureStreamer::setBudget(size_t bytes)
+{
+    m_budget = bytes;
+}
+
+size_t TextureStreamer::residentBytes() const
+{
+    size_t bytes = 0;
+    for (const StreamedArray& array : m_arrays)
+        bytes += bytesFrom(array, array.baseLevel);
+    return bytes;
+}
+
+size_t TextureStreamer::residentBytes(GLuint texture) const
+{
+    for (const StreamedArray& array : m_arrays)
+        if (array.texture == texture)
+            return bytesFrom(array, array.baseLevel);
+    return 0;
+}
+
+size_t TextureStreamer::arrayCount() const
+{
+    return m_arrays.size();
+}
+
+void TextureStreamer::add(GLuint texture, GLenum internalFormat, int width, int height, int levelCount, int baseLevel,
+                          const std::vector<std::string> &layerFiles)
+{
+    StreamedArray array;
+    array.texture = texture;
+    array.internalFormat = internalFormat;
+    array.width = width;
+    array.height = height;
+    array.levelCount = levelCount;
+    array.baseLevel = baseLevel;
+    array.wantedLevel = levelCount;
+    array.failed = false;
+    array.layerFiles = layerFiles;
+    m_arrays.push_back(std::move(array));
+    MemoryTracker::instance().allocate(MemoryTracker::TEXTURES, bytesFrom(m_arrays.back(), baseLevel));
+}
+
+void TextureStreamer::remove(GLuint texture)
+{
+    for (StreamedArray& array : m_arrays)
+    {
+        if (array.texture != texture)
+            continue;
+        MemoryTracker::instance().release(MemoryTracker::TEXTURES, bytesFrom(array, array.baseLevel));
+        if (array.read)
+            MemoryTracker::instance().release(MemoryTracker::TEXTURE_STAGING, array.read->bytes);
+    }
+    // a read still in flight keeps its buffers alive through the shared pointer and is dropped on completion
+    m_arrays.erase(std::remove_if(m_arrays.begin(), m_arrays.end(),
+                                  [texture](const StreamedArray& array) { return array.texture == texture; }),
+                   m_arrays.end());
+}
+
+void TextureStreamer::request(GLuint texture, float level)
+{
+    StreamedArray* array = find(texture);
+    if (array == nullptr)
+        return;
+    int wanted = std::max((int)std::floor(level), 0);
+    array->wantedLevel = std::min(array->wantedLevel, wanted);
+}
+
+bool TextureStreamer::update()
+{
+    // the level each array gets this frame: what was asked for, or its coarsest if it wasn't drawn
+    std::vector<int> target(m_arrays.size());
+    size_t total = 0;
+    for (size_t i = 0; i < m_arrays.size(); i++)
+    {
+        StreamedArray& array = m_arrays[i];
+        target[i] = std::min(array.wantedLevel, array.levelCount - 1);
+        if (array.failed)
+            target[i] = std::max(target[i], array.baseLevel);
+        total += bytesFrom(array, target[i]);
+        array.wantedLevel = array.levelCount;
+    }
+
+    // over budget, give up the largest level of any array until everything fits
+    while (total > m_budget)
+    {
+        int largest = -1;
+        size_t largestBytes = 0;
+        for (size_t i = 0; i < m_arrays.size(); i++)
+        {
+            const StreamedArray& array = m_arrays[i];
+            if (target[i] >= array.levelCount - 1)
+                continue;
+            size_t bytes = levelBytes(array.internalFormat, array.width, array.height, target[i], array.layerFiles.size());
+            if (bytes > largestBytes)
+            {
+                largest = (int)i;
+                largestBytes = bytes;
+            }
+        }
+        if (largest < 0)
+            break;
+        total -= largestBytes;
+        target[largest]++;
+    }
+
+    bool reading = false;
+    for (size_t i = 0; i < m_arrays.size(); i++)
+    {
+        StreamedArray& array = m_arrays[i];
+        if (array.read && array.readDone.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        {
+            // arrived after the array stopped needing it, e.g. the object moved away meanwhile
+            if (array.read->level == array.baseLevel - 1 && array.read->level >= target[i])
+                uploadRead(array);
+            else if (!array.read->success)
+                array.failed = true;
+            finishRead(array);
+        }
+
+        if (target[i] > array.baseLevel)
+            evictBelow(array, target[i]);
+        else if (target[i] < array.baseLevel && !array.read && !array.failed)
+            startRead(array, array.baseLevel - 1);
+
+        reading = reading || array.read;
+    }
+    return reading;
+}
+
+size_t TextureStreamer::bytesFrom(const StreamedArray &array, int level)
+{
+    size_t bytes = 0;
+    for (int i = level; i < array.levelCount; i++)
+        bytes += levelBytes(array.internalFormat, array.width, array.height, i, array.layerFiles.size());
+    return bytes;
+}
+
+TextureStreamer::StreamedArray *TextureStreamer::find(GLuint texture)
+{
+    for (StreamedArray& array : m_arrays)
+        if (array.texture == texture)
+            return &array;
+    return nullptr;
+}
+
+void TextureStreamer::startRead(StreamedArray &array, int level)
+{
+    std::shared_ptr<LevelRead> read = std::make_shared<LevelRead>();
+    read->level = level;
+    read->success = false;
+    read->layers.resize(array.layerFiles.size());
+
+    std::vector<std::string> files = array.layerFiles;
+    size_t expectedSize = levelBytes(array.internalFormat, array.width, array.height, level, 1);
+    read->bytes = expectedSize * files.size();
+    MemoryTracker::instance().allocate(MemoryTracker::TEXTURE_STAGING, read->bytes);
+    array.read = read;
+    array.readDone = ThreadPool::instance().submit([read, files, expectedSize]() {
+        TRACE_SCOPE("TextureStreamer read");
+        bool success = true;
+        for (size_t i = 0; i < files.size() && success; i++)
+            success = TextureCache::readKtxLevel(files[i], read->level, read->layers[i]) &&
+                      read->layers[i].size() == expectedSize;
+        read->success = success;
+    });
+}
+
+void TextureStreamer::uploadRead(StreamedArray &array)
+{
+    const LevelRead& read = *array.read;
+    if (!read.success)
+    {
+        qDebug("Can't stream level %d of texture array %u, keeping level %d", read.level, array.texture, array.baseLevel);
+        array.failed = true;
+        return;
+    }
+
+    std::vector<unsigned char> data;
+    data.reserve(read.layers.front().size() * read.layers.size());
+    for (const std::vector<unsigned char>& layer : read.layers)
+        data.insert(data.end(), layer.begin(), layer.end());
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+    GL_CHECK( glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, read.level, array.internalFormat,
+                                     std::max(array.width >> read.level, 1), std::max(array.height >> read.level, 1),
+                                     (GLsizei)read.layers.size(), 0, (GLsizei)data.size(), data.data()) );
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, read.level);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    MemoryTracker::instance().resize(MemoryTracker::TEXTURES, bytesFrom(array, array.baseLevel),
+                                     bytesFrom(array, read.level));
+    array.baseLevel = read.level;
+}
+
+void TextureStreamer::evictBelow(StreamedArray &array, int level)
+{
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, level);
+    // a zero-sized image frees the level; levels below the base don't count for completeness,
+    // so it doesn't matter that the format no longer matches
+    for (int i = array.baseLevel; i < level; i++)
+        GL_CHECK( glTexImage3D(GL_TEXTURE_2D_ARRAY, i, GL_RGBA8, 0, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL) );
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    MemoryTracker::instance().resize(MemoryTracker::TEXTURES, bytesFrom(array, array.baseLevel), bytesFrom(array, level));
+    array.baseLevel = level;
+}
+
+void TextureStreamer::finishRead(StreamedArray &array)
+{
+    MemoryTracker::instance().release(MemoryTracker::TEXTURE_STAGING, array.read->bytes);
+    array.read.reset();
+}
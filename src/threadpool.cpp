@@ -0,0 +1,129 @@
+#include "threadpool.h"
+#include "tracer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+using namespace makai;
+
+ThreadPool::ThreadPool(unsigned threadCount) : m_workers(), m_tasks(), m_stopping(false)
+{
+    if (threadCount == 0)
+    {
+        unsigned hardwareThreads = std::thread::hardware_concurrency();
+        threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+
+    // workers trace, so the tracer has to be created first to be destroyed after them
+    Tracer::instance();
+    for (unsigned i = 0; i < threadCount; i++)
+        m_workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+    for (std::thread& worker : m_workers)
+        worker.join();
+}
+
+ThreadPool &ThreadPool::instance()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+unsigned ThreadPool::threadCount() const
+{
+    return (unsigned)m_workers.size();
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task)
+{
+    auto packaged = std::make_shared<std::packaged_task<void()>>(std::move(task));
+    std::future<void> result = packaged->get_future();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back([packaged]() { (*packaged)(); });
+    }
+    m_condition.notify_one();
+    return result;
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end, size_t grain,
+                             const std::function<void(size_t, size_t)> &body)
+{
+    if (end <= begin)
+        return;
+    grain = std::max<size_t>(grain, 1);
+
+    size_t chunkCount = (end - begin + grain - 1) / grain;
+    if (chunkCount == 1)
+    {
+        body(begin, end);
+        return;
+    }
+
+    // chunks are claimed through a shared counter by the caller and by helper tasks.
+    // The caller waits for all chunks to finish, not for the helpers to run,
+    // so a helper that starts late just finds no work left.
+    struct Job {
+        std::atomic<size_t> nextChunk;
+        std::atomic<size_t> doneChunks;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->nextChunk = 0;
+    job->doneChunks = 0;
+
+    auto work = [job, begin, end, grain, chunkCount, &body]() {
+        size_t chunk;
+        while ((chunk = job->nextChunk++) < chunkCount)
+        {
+            size_t first = begin + chunk * grain;
+            body(first, std::min(first + grain, end));
+            if (++job->doneChunks == chunkCount)
+            {
+                std::lock_guard<std::mutex> lock(job->mutex);
+                job->finished.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = std::min<size_t>(m_workers.size(), chunkCount - 1);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < helpers; i++)
+            m_tasks.push_back(work);
+    }
+    m_condition.notify_all();
+
+    work();
+
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->finished.wait(lock, [&job, chunkCount]() { return job->doneChunks == chunkCount; });
+}
+
+void ThreadPool::workerLoop(unsigned index)
+{
+    Tracer::instance().setThreadName("ThreadPool worker " + std::to_string(index));
+    for (;;)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+            if (m_stopping && m_tasks.empty())
+                return;
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+    }
+}
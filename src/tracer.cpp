@@ -0,0 +1,168 @@
+#include "tracer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+using namespace makai;
+
+static std::string quoted(const char *text)
+{
+    std::string out = "\"";
+    for (const char* c = text; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            out += '\\';
+            out += *c;
+        }
+        else if ((unsigned char)*c < 0x20)
+        {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)*c);
+            out += escaped;
+        }
+        else
+        {
+            out += *c;
+        }
+    }
+    return out + "\"";
+}
+
+Tracer::ThreadBuffer::ThreadBuffer(int id) : id(id), name(), count(0)
+{
+    std::fill(chunks, chunks + MAX_CHUNKS, nullptr);
+}
+
+Tracer::ThreadBuffer::~ThreadBuffer()
+{
+    for (Event* chunk : chunks)
+        delete[] chunk;
+}
+
+Tracer::Tracer() : m_enabled(false), m_dropped(0), m_start(Clock::now()), m_buffers()
+{
+}
+
+Tracer &Tracer::instance()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+void Tracer::setEnabled(bool enabled)
+{
+    m_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Tracer::begin(const char *name, const char *detail)
+{
+    record('B', name, detail);
+}
+
+void Tracer::end()
+{
+    record('E', nullptr, nullptr);
+}
+
+void Tracer::setThreadName(const std::string &name)
+{
+    ThreadBuffer& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    buffer.name = name;
+}
+
+size_t Tracer::droppedEvents() const
+{
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+Tracer::ThreadBuffer &Tracer::threadBuffer()
+{
+    // buffers belong to the tracer, so the events of threads that have exited are still written
+    static thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_buffers.emplace_back(new ThreadBuffer((int)m_buffers.size() + 1));
+        buffer = m_buffers.back().get();
+    }
+    return *buffer;
+}
+
+void Tracer::record(char phase, const char *name, const char *detail)
+{
+    ThreadBuffer& buffer = threadBuffer();
+    const size_t index = buffer.count.load(std::memory_order_relaxed);
+    const size_t chunk = index / CHUNK_EVENTS;
+    if (chunk >= MAX_CHUNKS)
+    {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (!buffer.chunks[chunk])
+        buffer.chunks[chunk] = new Event[CHUNK_EVENTS];
+
+    Event& event = buffer.chunks[chunk][index % CHUNK_EVENTS];
+    event.name = name;
+    event.nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_start).count();
+    event.phase = phase;
+    event.detail[0] = '\0';
+    if (detail)
+    {
+        // the end of a path names the file, keep that
+        const size_t length = std::strlen(detail);
+        if (length < DETAIL_SIZE)
+        {
+            std::memcpy(event.detail, detail, length + 1);
+        }
+        else
+        {
+            std::memcpy(event.detail, "...", 3);
+            std::memcpy(event.detail + 3, detail + length - (DETAIL_SIZE - 4), DETAIL_SIZE - 3);
+        }
+    }
+    buffer.count.store(index + 1, std::memory_order_release);
+}
+
+bool Tracer::write(const std::string &fileName)
+{
+    std::ofstream file(fileName);
+    if (!file.is_open())
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    file << "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":" << droppedEvents() << "},\n"
+         << "\"traceEvents\":[\n";
+    bool first = true;
+    char line[64];
+    for (const std::unique_ptr<ThreadBuffer>& buffer : m_buffers)
+    {
+        if (!buffer->name.empty())
+        {
+            file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id
+                 << ",\"args\":{\"name\":" << quoted(buffer->name.c_str()) << "}}";
+            first = false;
+        }
+
+        const size_t count = buffer->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; i++)
+        {
+            const Event& event = buffer->chunks[i / CHUNK_EVENTS][i % CHUNK_EVENTS];
+            std::snprintf(line, sizeof(line), "\"ph\":\"%c\",\"pid\":1,\"tid\":%d,\"ts\":%.3f",
+                          event.phase, buffer->id, event.nanoseconds / 1000.0);
+            file << (first ? "" : ",\n") << "{";
+            if (event.name)
+                file << "\"name\":" << quoted(event.name) << ",";
+            file << line;
+            if (event.detail[0] != '\0')
+                file << ",\"args\":{\"detail\":" << quoted(event.detail) << "}";
+            file << "}";
+            first = false;
+        }
+    }
+    file << "\n]}\n";
+    return file.good();
+}